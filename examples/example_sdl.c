@@ -25,7 +25,8 @@ freely, subject to the following restrictions:
 
 /*
 Compile command for Linux:
-gcc lodepng.c example_sdl.c -ansi -pedantic -Wall -Wextra -lSDL -O3 -o showpng
+g++ -c lodepng.cpp -O3
+gcc example_sdl.c lodepng.o -std=c99 -pedantic -Wall -Wextra -lSDL -lstdc++ -lpthread -O3 -o showpng
 
 */
 
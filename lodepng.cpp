@@ -24,6 +24,8 @@
 #include "lodepng.h"
 
 #include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -37,6 +39,50 @@
 // ability to convert error numerical codes to English text string
 #define LODEPNG_COMPILE_ERROR_TEXT
 
+// SSE2, SSSE3 and AVX2 code paths, chosen at runtime depending on the CPU. x86 only.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LODEPNG_COMPILE_SIMD
+#endif
+
+#ifdef LODEPNG_COMPILE_SIMD
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LODEPNG_TARGET(isa)
+#else
+#include <cpuid.h>
+#define LODEPNG_TARGET(isa) __attribute__((target(isa)))
+#endif
+#include <immintrin.h>
+#endif // LODEPNG_COMPILE_SIMD
+
+// functions that work with POSIX file descriptors
+#if defined(__unix__) || defined(__APPLE__)
+#define LODEPNG_COMPILE_POSIX
+#endif
+
+#ifdef LODEPNG_COMPILE_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // LODEPNG_COMPILE_POSIX
+
+// decoding on several threads, see num_threads of the decoder settings. Needs pthreads, on by default
+// on POSIX systems. Define LODEPNG_NO_COMPILE_THREADS to disable it.
+#if defined(LODEPNG_COMPILE_POSIX) && !defined(LODEPNG_NO_COMPILE_THREADS) && !defined(LODEPNG_COMPILE_THREADS)
+#define LODEPNG_COMPILE_THREADS
+#endif
+
+#ifdef LODEPNG_COMPILE_THREADS
+#include <pthread.h>
+#endif // LODEPNG_COMPILE_THREADS
+
+// The functions of LodePNG have C linkage, so that C programs can use it compiled as C++
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // The PNG color types (also used for raw).
 typedef enum LodePNGColorType
 {
@@ -47,11 +93,58 @@ typedef enum LodePNGColorType
     LCT_RGBA = 6 // RGB with alpha: 8,16 bit
 } LodePNGColorType;
 
+// The format of 16-bit samples in raw pixels. Only for decoding, PNG files always have them big endian.
+typedef enum LodePNGSampleFormat
+{
+    LSF_BIG_ENDIAN = 0, // 2 bytes per sample, the most significant byte first, like PNG
+    LSF_NATIVE = 1, // an unsigned short per sample, in the byte order of this computer
+    LSF_FLOAT = 2 // a 32-bit float per sample, from 0 to 1
+} LodePNGSampleFormat;
+
 #ifdef LODEPNG_COMPILE_ERROR_TEXT
 // Returns an English description of the numerical error code.
 const char* lodepng_error_text(unsigned code);
 #endif // LODEPNG_COMPILE_ERROR_TEXT
 
+// Converts PNG data in memory to raw pixel data of the given color type and bit depth.
+// out: receives the pixels, w * h pixels of the given color type, must be freed with free().
+// For 16-bit per channel colors, uses big endian format like PNG does.
+// w, h: receive the width and height of the image.
+// in, insize: the PNG file in memory.
+// Return value: LodePNG error code (0 means no error).
+unsigned lodepng_decode_memory(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in,
+    size_t insize, LodePNGColorType colortype, unsigned bitdepth);
+
+// Same as lodepng_decode_memory, but always decodes to 32-bit RGBA raw image.
+unsigned lodepng_decode32(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in, size_t insize);
+
+// Same as lodepng_decode_memory, but loads the PNG from the file with the given name.
+unsigned lodepng_decode_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename,
+    LodePNGColorType colortype, unsigned bitdepth);
+
+// Same as lodepng_decode_file, but always decodes to 24-bit RGB raw image.
+unsigned lodepng_decode24_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename);
+
+// Converts raw pixel data of the given color type and bit depth into a PNG image in memory.
+// out: receives the PNG file, of *outsize bytes, must be freed with free().
+// image, w, h: the raw pixels and the width and height of the image.
+// Return value: LodePNG error code (0 means no error).
+unsigned lodepng_encode_memory(unsigned char** out, size_t* outsize, const unsigned char* image,
+    unsigned w, unsigned h, LodePNGColorType colortype, unsigned bitdepth);
+
+// Same as lodepng_encode_memory, but always encodes from 32-bit RGBA raw image.
+unsigned lodepng_encode32(unsigned char** out, size_t* outsize, const unsigned char* image, unsigned w, unsigned h);
+
+// Same as lodepng_encode_memory, but always encodes from 24-bit RGB raw image.
+unsigned lodepng_encode24(unsigned char** out, size_t* outsize, const unsigned char* image, unsigned w, unsigned h);
+
+// Same as lodepng_encode_memory, but saves the PNG to the file with the given name. Overwrites it if it exists.
+unsigned lodepng_encode_file(const char* filename, const unsigned char* image, unsigned w, unsigned h,
+    LodePNGColorType colortype, unsigned bitdepth);
+
+// Same as lodepng_encode_file, but always encodes from 24-bit RGB raw image.
+unsigned lodepng_encode24_file(const char* filename, const unsigned char* image, unsigned w, unsigned h);
+
 // Settings for zlib compression. Tweaking these settings tweaks the balance
 // between speed and compression ratio.
 typedef struct // deflate = compress
@@ -65,6 +158,39 @@ typedef struct // deflate = compress
 
 void lodepng_compress_settings_init(LodePNGCompressSettings* settings);
 
+// Compresses data with deflate, without zlib header. The result is appended to *out of *outsize bytes,
+// which may be 0 and 0, and must be freed with free(). return value is error
+unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
+    const unsigned char* in, size_t insize,
+    const LodePNGCompressSettings* settings);
+
+// Same as lodepng_deflate, but gives a zlib stream, with header and Adler-32 checksum.
+unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
+    size_t insize, const LodePNGCompressSettings* settings);
+
+// Finds length-limited Huffman code lengths, of at most maxbitlen bits, for the given frequencies.
+unsigned lodepng_huffman_code_lengths(unsigned* lengths, const unsigned* frequencies,
+    size_t numcodes, unsigned maxbitlen);
+
+// Settings for zlib decompression
+typedef struct LodePNGDecompressSettings
+{
+    /*verify the adler32 checksum at the end of the zlib data, gives error 58 on a mismatch. It's
+    computed as the data is decompressed. Default: false*/
+    unsigned check_adler32;
+} LodePNGDecompressSettings;
+
+void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings);
+
+// Decompresses deflate data, without zlib header. The result is appended to *out of *outsize bytes,
+// which may be 0 and 0, and must be freed with free(). return value is error
+unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
+    const unsigned char* in, size_t insize);
+
+// Same as lodepng_inflate, but for a zlib stream, with header and Adler-32 checksum.
+unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
+    size_t insize, const LodePNGDecompressSettings* settings);
+
 // Color mode of an image. Contains all information required to decode the pixel
 // bits to RGBA colors. This information is the same as used in the PNG file
 // format, and is used both for PNG and raw image data in LodePNG.
@@ -73,6 +199,7 @@ typedef struct LodePNGColorMode
     // header (IHDR)
     LodePNGColorType colortype; // color type, see PNG standard or documentation further in this header file
     unsigned bitdepth;  // bits per sample, see PNG standard or documentation further in this header file
+    LodePNGSampleFormat sampleformat; // format of the samples if bitdepth is 16, see LodePNGSampleFormat
 
                         // palette (PLTE and tRNS)
                         // 
@@ -103,8 +230,34 @@ typedef struct LodePNGColorMode
     unsigned key_b;       // blue component of color key
 } LodePNGColorMode;
 
+// init, cleanup and copy functions to use with this struct
+void lodepng_color_mode_init(LodePNGColorMode* info);
+void lodepng_color_mode_cleanup(LodePNGColorMode* info);
+// return value is error code (0 means no error)
+unsigned lodepng_color_mode_copy(LodePNGColorMode* dest, const LodePNGColorMode* source);
+
 void lodepng_palette_clear(LodePNGColorMode* info);
 // add 1 color to the palette
+unsigned lodepng_palette_add(LodePNGColorMode* info,
+    unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+
+// get the total amount of bits per pixel, based on colortype and bitdepth in the struct
+unsigned lodepng_get_bpp(const LodePNGColorMode* info);
+// get the amount of color channels used, based on colortype in the struct. A palette counts as 1 channel.
+unsigned lodepng_get_channels(const LodePNGColorMode* info);
+// is it a greyscale type? (only colortype 0 or 4)
+unsigned lodepng_is_greyscale_type(const LodePNGColorMode* info);
+// has it got an alpha channel? (only colortype 4 or 6)
+unsigned lodepng_is_alpha_type(const LodePNGColorMode* info);
+// has it got a palette? (only colortype 3)
+unsigned lodepng_is_palette_type(const LodePNGColorMode* info);
+// only returns true if there is a palette and there is a value in the palette with alpha < 255
+unsigned lodepng_has_palette_alpha(const LodePNGColorMode* info);
+// returns true if the color mode can have non-opaque pixels: with an alpha channel, a palette with
+// alpha or a color key
+unsigned lodepng_can_have_alpha(const LodePNGColorMode* info);
+// returns the byte size of a raw image buffer with given width, height and color mode
+size_t lodepng_get_raw_size(unsigned w, unsigned h, const LodePNGColorMode* color);
 
 // Information about the PNG image, except pixels, width and height.
 typedef struct LodePNGInfo
@@ -114,6 +267,12 @@ typedef struct LodePNGInfo
     LodePNGColorMode color;     // color type and bits, palette and transparency of the PNG file
 } LodePNGInfo;
 
+// init, cleanup and copy functions to use with this struct
+void lodepng_info_init(LodePNGInfo* info);
+void lodepng_info_cleanup(LodePNGInfo* info);
+// return value is error code (0 means no error)
+unsigned lodepng_info_copy(LodePNGInfo* dest, const LodePNGInfo* source);
+
 // Converts raw buffer from one color type to another color type, based on
 // LodePNGColorMode structs to describe the input and output color type.
 // See the reference manual at the end of this header file to see which color conversions are supported.
@@ -121,7 +280,8 @@ typedef struct LodePNGInfo
 // The out buffer must have size (w * h * bpp + 7) / 8, where bpp is the bits per pixel
 // of the output color type (lodepng_get_bpp).
 // For < 8 bpp images, there should not be padding bits at the end of scanlines.
-// For 16-bit per channel colors, uses big endian format like PNG does.
+// For 16-bit per channel colors, uses big endian format like PNG does, unless mode_out has another
+// sampleformat (mode_in can't).
 // Return value is LodePNG error code
 unsigned lodepng_convert(unsigned char* out, const unsigned char* in,
     const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
@@ -153,6 +313,18 @@ typedef struct LodePNGColorProfile
     unsigned bits; // bits per channel (not for palette). 1,2 or 4 for greyscale only. 16 if 16-bit per channel required.
 } LodePNGColorProfile;
 
+void lodepng_color_profile_init(LodePNGColorProfile* profile);
+
+// Get a LodePNGColorProfile of the image.
+unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
+    const unsigned char* image, unsigned w, unsigned h,
+    const LodePNGColorMode* mode_in);
+
+// Chooses the smallest color mode for mode_out that can hold all colors of the image without loss.
+unsigned lodepng_auto_choose_color(LodePNGColorMode* mode_out,
+    const unsigned char* image, unsigned w, unsigned h,
+    const LodePNGColorMode* mode_in);
+
 
 // Settings for the encoder.
 typedef struct LodePNGEncoderSettings
@@ -173,14 +345,39 @@ typedef struct LodePNGEncoderSettings
     /*force creating a PLTE chunk if colortype is 2 or 6 (= a suggested palette).
     If colortype is 3, PLTE is _always_ created.*/
     unsigned force_palette;
+
+    /*If not 0, and the image has no interlacing, compresses it in bands of this many rows that can be
+    decompressed independently of each other, and adds an lpBD chunk that tells where each band starts,
+    so that decoders can decode the bands in parallel. Other decoders read the PNG as usual. Makes the
+    PNG a bit bigger, since the first row of a band can't refer to the row above it. Default: 0*/
+    unsigned band_height;
 } LodePNGEncoderSettings;
 
 void lodepng_encoder_settings_init(LodePNGEncoderSettings* settings);
 
+// Settings for the decoder.
+typedef struct LodePNGDecoderSettings
+{
+    LodePNGDecompressSettings zlibsettings; // settings for the zlib decoder
+    unsigned check_crc; // verify the CRC of every chunk, gives error 57 on a mismatch. Default: false
+    /*decode the bands of a PNG with an lpBD chunk, see band_height of the encoder, on this many threads at
+    once. Only with LODEPNG_COMPILE_THREADS, other PNGs are decoded on a single thread. Default: 1*/
+    unsigned num_threads;
+    /*if not 0 and num_threads is more than 1, also decodes other PNGs on num_threads threads: images without
+    interlacing in a pipeline, in which one thread inflates the scanlines, another unfilters them, and the
+    others convert them to info_raw as they're unfiltered. Of interlaced images only putting the rows
+    together from the reduced images and converting them is split over the threads. Gives the same pixels
+    and errors as on a single thread. Default: 0*/
+    unsigned pipeline;
+} LodePNGDecoderSettings;
+
+void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings);
+
 
 // The settings, state and information for extended encoding and decoding.
 typedef struct LodePNGState
 {
+    LodePNGDecoderSettings decoder; // the decoding settings
     LodePNGEncoderSettings encoder; // the encoding settings
     LodePNGColorMode info_raw; // specifies the format in which you would like to get the raw pixel buffer
     LodePNGInfo info_png; // info of the PNG image obtained after decoding
@@ -196,6 +393,179 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
     LodePNGState* state,
     const unsigned char* in, size_t insize);
 
+// Reads the header of the PNG, but not the image data: the width and height, and the color type and
+// interlace method in state->info_png. return value is error
+unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
+    const unsigned char* in, size_t insize);
+
+// Same as lodepng_encode_memory, but uses a LodePNGState to allow custom settings.
+unsigned lodepng_encode(unsigned char** out, size_t* outsize,
+    const unsigned char* image, unsigned w, unsigned h,
+    LodePNGState* state);
+
+// Same as lodepng_decode, but only decodes the region of rw * rh pixels at x, y of the image, which must
+// be inside it. out receives the pixels of the region, as an image of rw * rh pixels, w and h the size of
+// the whole image. The scanlines after the region aren't decompressed, so errors in the image data after
+// it, and the Adler-32 checksum, aren't checked.
+unsigned lodepng_decode_region(unsigned char** out, unsigned* w, unsigned* h,
+    LodePNGState* state,
+    const unsigned char* in, size_t insize,
+    unsigned x, unsigned y, unsigned rw, unsigned rh);
+
+// Builds an index of the image data of the PNG, with which lodepng_decode_region_indexed can start
+// decompressing close to the region instead of at the start of the image. It has a checkpoint about every
+// spacing bytes of decompressed data, each with the 32K window of the decompressor and the previous
+// scanline: a smaller spacing makes decoding faster but the index bigger. *index is a buffer of
+// *indexsize bytes that can be stored to reuse it, and must be freed with free(). Images with Adam7
+// interlacing get no checkpoints, since every region of them needs data from the start of each pass.
+unsigned lodepng_index_build(unsigned char** index, size_t* indexsize,
+    LodePNGState* state,
+    const unsigned char* in, size_t insize, size_t spacing);
+
+// Same as lodepng_decode_region, but starts at the last checkpoint of index before the region. index must
+// be built by lodepng_index_build for this PNG, otherwise gives error 99, as it does if the CRC32 that the
+// index has of itself doesn't match. Since the data before the checkpoint isn't read, the Adler-32 checksum
+// isn't checked either.
+unsigned lodepng_decode_region_indexed(unsigned char** out, unsigned* w, unsigned* h,
+    LodePNGState* state,
+    const unsigned char* in, size_t insize,
+    const unsigned char* index, size_t indexsize,
+    unsigned x, unsigned y, unsigned rw, unsigned rh);
+
+// Same as lodepng_decode, but decodes into the buffer out that the caller allocated, of outsize bytes,
+// instead of allocating the output. The pixels are in the color mode state->info_raw, and row y of the
+// image starts at out + y * stride. stride must be at least the bytes of one row, (w * bpp + 7) / 8.
+// The bytes after each row up to the stride are left untouched, the unused bits at the end of the last
+// byte of a row of less than 8 bits per pixel are undefined. stride 0 packs the rows without padding
+// bits in between, like lodepng_decode does.
+unsigned lodepng_decode_into(unsigned char* out, size_t outsize, size_t stride, unsigned* w, unsigned* h,
+    LodePNGState* state,
+    const unsigned char* in, size_t insize);
+
+// Gives the size of the buffer that lodepng_decode_into needs for the PNG with the given stride, and the
+// width and height of the image. Only reads the header.
+unsigned lodepng_decode_into_size(size_t* size, unsigned* w, unsigned* h, size_t stride,
+    LodePNGState* state,
+    const unsigned char* in, size_t insize);
+
+// Same as lodepng_decode, but for a PNG with a palette gives the palette index of each pixel instead of its
+// color: one byte per pixel, or if packed isn't 0, at the bit depth of the PNG with 8 / bitdepth pixels per
+// byte. The palette, with the alpha values of the tRNS chunk, is in state->info_png.color, state->info_raw
+// gets the color mode of out, palette without colors. Gives error 100 if the PNG has no palette.
+unsigned lodepng_decode_indexed(unsigned char** out, unsigned* w, unsigned* h, LodePNGState* state,
+    const unsigned char* in, size_t insize, unsigned packed);
+
+// A row of decoded pixels, as given to a LodePNGRowCallback.
+typedef struct LodePNGRow
+{
+    const unsigned char* data; // the pixels in the color mode state->info_raw, starting at a byte
+    unsigned width; // amount of pixels in data
+    unsigned y; // row of the image that the pixels are on
+    unsigned x0, dx; // pixel i of data is at x = x0 + i * dx
+    unsigned pass; // Adam7 pass of the row, 0-6, always 0 for images without interlacing
+} LodePNGRow;
+
+// Receives the rows of an image as they're decoded. Images with Adam7 interlacing give the rows of the
+// 7 reduced images, pass after pass, each with every dx-th pixel of row y. user is passed on as given.
+// Returning nonzero stops decoding, with error 97.
+typedef unsigned (*LodePNGRowCallback)(void* user, const LodePNGRow* row);
+
+// Same as lodepng_decode, but instead of storing the image it gives each row to callback as soon as it's
+// decoded, so that only a few rows are in memory at any time. The rows are in the color mode state->info_raw.
+unsigned lodepng_decode_rows(unsigned* w, unsigned* h, LodePNGState* state,
+    const unsigned char* in, size_t insize,
+    LodePNGRowCallback callback, void* user);
+
+// Type of the elements of the planes of lodepng_decode_planar.
+typedef enum LodePNGPlanarType
+{
+    LPT_UINT8 = 0, // unsigned char
+    LPT_FLOAT32 = 1 // float, in the native endianness
+} LodePNGPlanarType;
+
+// The planes that lodepng_decode_planar gives, for example a CHW tensor as input of a neural network.
+typedef struct LodePNGPlanarSettings
+{
+    unsigned numchannels; // amount of planes, 1 to 4
+    unsigned channels[4]; // channel of the RGBA color in each plane: 0 red, 1 green, 2 blue, 3 alpha
+    LodePNGPlanarType type;
+    // Per plane, value = sample * scale + offset, with the sample from 0 to 1. Floats get the value, bytes
+    // the value times 255, rounded and clamped to 0-255.
+    float scale[4];
+    float offset[4];
+} LodePNGPlanarSettings;
+
+// Initializes to the red, green and blue planes as bytes, with scale 1 and offset 0.
+void lodepng_planar_settings_init(LodePNGPlanarSettings* settings);
+
+// Same as lodepng_decode, but gives the channels of the image in separate planes instead of interleaved:
+// out has settings->numchannels planes of w * h elements one after the other. Each row is converted to RGBA,
+// of 16 bits for floats from a PNG of 16 bits and else of 8, and written to the planes as soon as it's
+// decoded, so there's no interleaved image in between. state->info_raw is set to that RGBA mode. Greyscale
+// images have their grey in the red, green and blue channels. out must be freed with free().
+// Gives error 102 for invalid settings.
+unsigned lodepng_decode_planar(unsigned char** out, unsigned* w, unsigned* h, LodePNGState* state,
+    const unsigned char* in, size_t insize, const LodePNGPlanarSettings* settings);
+
+// Decoder for a PNG that arrives in pieces, for example from the network. It decodes each piece as it's
+// pushed and gives the rows to a callback, keeping only the unread end of the input, the 32K window of
+// the decompressor and two rows instead of the whole file and image.
+typedef struct LodePNGStreamDecoder LodePNGStreamDecoder;
+
+// Creates a stream decoder that uses the settings in state and gives rows in the color mode state->info_raw
+// to callback. state receives the information of the PNG and the error, and must outlive the decoder.
+// Returns 0 if out of memory.
+LodePNGStreamDecoder* lodepng_stream_new(LodePNGState* state, LodePNGRowCallback callback, void* user);
+
+// Decodes the next size bytes of the PNG. The PNG may be split into pieces of any size. After an error,
+// further input is ignored. return value is error
+unsigned lodepng_stream_push(LodePNGStreamDecoder* stream, const unsigned char* data, size_t size);
+
+// Tells the decoder that the PNG ends here, checks that the image was complete. return value is error
+unsigned lodepng_stream_finish(LodePNGStreamDecoder* stream);
+
+// Gives the width and height of the image once its header has been pushed. Returns 0 if not yet known.
+unsigned lodepng_stream_size(const LodePNGStreamDecoder* stream, unsigned* w, unsigned* h);
+
+void lodepng_stream_delete(LodePNGStreamDecoder* stream);
+
+// Same as lodepng_inspect, but for a PNG file, of which it only reads the first 33 bytes.
+// If idatsize isn't 0, it also walks over the headers of the chunks after IHDR up to IEND, seeking
+// past their data. It reads the palette and transparency of the PLTE and tRNS chunks into
+// state->info_png.color, and gives the total size of the data of all IDAT chunks in *idatsize,
+// without reading that data. With state->decoder.check_crc, the CRC of the chunks it reads is checked.
+unsigned lodepng_inspect_file(unsigned* w, unsigned* h, size_t* idatsize, LodePNGState* state,
+    const char* filename);
+
+#ifdef LODEPNG_COMPILE_POSIX
+// Same as lodepng_inspect_file, for a file descriptor, read with pread at offsets from the start of
+// the file. The file offset of fd isn't changed.
+unsigned lodepng_inspect_fd(unsigned* w, unsigned* h, size_t* idatsize, LodePNGState* state, int fd);
+#endif // LODEPNG_COMPILE_POSIX
+
+// Functions to read the chunks of a PNG, starting at the 4-byte length of the chunk.
+// length of the data of the chunk
+unsigned lodepng_chunk_length(const unsigned char* chunk);
+// check if the type is the given 4-letter type, e.g. "IDAT"
+unsigned char lodepng_chunk_type_equals(const unsigned char* chunk, const char* type);
+// the data of the chunk
+const unsigned char* lodepng_chunk_data_const(const unsigned char* chunk);
+// returns 1 if the CRC of the chunk is wrong, 0 if it's correct
+unsigned lodepng_chunk_check_crc(const unsigned char* chunk);
+// computes the CRC of the chunk and stores it in its last 4 bytes
+void lodepng_chunk_generate_crc(unsigned char* chunk);
+// the chunk after this one
+const unsigned char* lodepng_chunk_next_const(const unsigned char* chunk);
+// appends a new chunk with the given type and data to the buffer out of *outlength bytes
+unsigned lodepng_chunk_create(unsigned char** out, size_t* outlength, unsigned length,
+    const char* type, const unsigned char* data);
+// reads a 32-bit big endian integer, as in the chunks of a PNG
+unsigned lodepng_read32bitInt(const unsigned char* buffer);
+
+// Load a file from disk into buffer. The function allocates the out buffer, which must be freed
+// with free(). return value: error code (0 means ok)
+unsigned lodepng_load_file(unsigned char** out, size_t* outsize, const char* filename);
+
 // Save a file from buffer to disk. Warning, if it exists, this function overwrites
 // the file without warning!
 // buffer: the buffer to write
@@ -204,6 +574,10 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
 // return value: error code (0 means ok)
 unsigned lodepng_save_file(const unsigned char* buffer, size_t buffersize, const char* filename);
 
+#ifdef __cplusplus
+}
+#endif
+
 
 ////////////////////////////////////////////////////////////////////////////
 
@@ -388,6 +762,76 @@ static unsigned ucvector_push_back(ucvector* p, unsigned char c)
   return 1;
 }
 
+///////////////////////////////////////////////////////////////////////////// 
+
+// a range of bytes inside a buffer owned by someone else, e.g. the data of one chunk
+typedef struct ByteSpan
+{
+  const unsigned char* data;
+  size_t size;
+} ByteSpan;
+
+// dynamic vector of byte spans
+typedef struct spanvector
+{
+  ByteSpan* data;
+  size_t size; // used size, in spans
+  size_t allocsize; // allocated size, in spans
+} spanvector;
+
+static void spanvector_init(spanvector* p)
+{
+  p->data = NULL;
+  p->size = p->allocsize = 0;
+}
+
+static void spanvector_cleanup(spanvector* p)
+{
+  free(p->data);
+  spanvector_init(p);
+}
+
+// returns 1 if success, 0 if failure ==> nothing done
+static unsigned spanvector_push_back(spanvector* p, const unsigned char* data, size_t size)
+{
+  if(p->size == p->allocsize)
+  {
+    size_t newsize = p->allocsize ? p->allocsize * 2 : 8;
+    void* newdata = realloc(p->data, newsize * sizeof(ByteSpan));
+    if(!newdata) return 0;
+    p->data = (ByteSpan*)newdata;
+    p->allocsize = newsize;
+  }
+  p->data[p->size].data = data;
+  p->data[p->size].size = size;
+  ++p->size;
+  return 1;
+}
+
+// total size of the bytes of all spans
+static size_t spanvector_bytes(const spanvector* p)
+{
+  size_t result = 0;
+  for(size_t i = 0; i != p->size; ++i) result += p->data[i].size;
+  return result;
+}
+
+#ifdef LODEPNG_COMPILE_THREADS
+// Adds to p the spans of bytes begin up to end of all bytes of in. returns 1 if success, 0 if failure
+static unsigned spanvector_slice(spanvector* p, const spanvector* in, size_t begin, size_t end)
+{
+  size_t pos = 0; // of the current span in all bytes
+  for(size_t i = 0; i != in->size; ++i)
+  {
+    size_t from = begin > pos ? begin : pos;
+    size_t to = end < pos + in->data[i].size ? end : pos + in->data[i].size;
+    if(from < to && !spanvector_push_back(p, in->data[i].data + (from - pos), to - from)) return 0;
+    pos += in->data[i].size;
+  }
+  return 1;
+}
+#endif // LODEPNG_COMPILE_THREADS
+
 
 //////////////////////////////////////////////////////////////////////////// 
 
@@ -405,31 +849,113 @@ static void lodepng_set32bitInt(unsigned char* buffer, unsigned value)
   buffer[3] = (unsigned char)((value      ) & 0xff);
 }
 
+static uint64_t lodepng_read64bitInt(const unsigned char* buffer)
+{
+  return ((uint64_t)lodepng_read32bitInt(buffer) << 32) | lodepng_read32bitInt(buffer + 4);
+}
+
+static void lodepng_set64bitInt(unsigned char* buffer, uint64_t value)
+{
+  lodepng_set32bitInt(buffer, (unsigned)(value >> 32));
+  lodepng_set32bitInt(buffer + 4, (unsigned)value);
+}
+
 static void lodepng_add32bitInt(ucvector* buffer, unsigned value)
 {
   ucvector_resize(buffer, buffer->size + 4); // todo: give error if resize failed
   lodepng_set32bitInt(&buffer->data[buffer->size - 4], value);
 }
 
+#ifdef LODEPNG_COMPILE_SIMD
 //////////////////////////////////////////////////////////////////////////// 
-/// File IO                                                                / 
+/// CPU features                                                           / 
 //////////////////////////////////////////////////////////////////////////// 
 
-//  returns negative value on error. This should be pure C compatible, so no fstat. 
-static long lodepng_filesize(const char* filename)
+enum
 {
-  FILE *file = fopen(filename, "rb");
-  if(!file) return -1;
+  LODEPNG_CPU_SSE2 = 1,
+  LODEPNG_CPU_SSSE3 = 2,
+  LODEPNG_CPU_SSE41 = 4,
+  LODEPNG_CPU_PCLMUL = 8,
+  LODEPNG_CPU_AVX2 = 16
+};
 
-  if(fseek(file, 0, SEEK_END) != 0)
+// regs receives eax, ebx, ecx, edx
+static void lodepng_cpuid(unsigned regs[4], unsigned leaf)
+{
+#ifdef _MSC_VER
+  int r[4];
+  __cpuidex(r, (int)leaf, 0);
+  for(unsigned i = 0; i != 4; ++i) regs[i] = (unsigned)r[i];
+#else
+  __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// the OS must save the YMM registers too before AVX can be used
+static unsigned lodepng_osSavesYmm(void)
+{
+#ifdef _MSC_VER
+  return (_xgetbv(0) & 6) == 6;
+#else
+  unsigned eax, edx;
+  __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (eax & 6) == 6;
+#endif
+}
+
+static unsigned detectCpuFeatures(void)
+{
+  unsigned features = 0;
+  unsigned regs[4];
+  lodepng_cpuid(regs, 0);
+  unsigned maxleaf = regs[0];
+  if(maxleaf < 1) return 0;
+
+  lodepng_cpuid(regs, 1);
+  if(regs[3] & (1u << 26)) features |= LODEPNG_CPU_SSE2;
+  if(regs[2] & (1u << 9)) features |= LODEPNG_CPU_SSSE3;
+  if(regs[2] & (1u << 19)) features |= LODEPNG_CPU_SSE41;
+  if(regs[2] & (1u << 1)) features |= LODEPNG_CPU_PCLMUL;
+  unsigned avx = (regs[2] & (1u << 27)) && (regs[2] & (1u << 28)) && lodepng_osSavesYmm();
+  if(avx && maxleaf >= 7)
   {
-    fclose(file);
-    return -1;
+    lodepng_cpuid(regs, 7);
+    if(regs[1] & (1u << 5)) features |= LODEPNG_CPU_AVX2;
   }
+  return features;
+}
+
+// detected once, the first time it's needed
+static unsigned getCpuFeatures(void)
+{
+  static const unsigned features = detectCpuFeatures();
+  return features;
+}
+#endif // LODEPNG_COMPILE_SIMD
+
+//////////////////////////////////////////////////////////////////////////// 
+/// File IO                                                                / 
+//////////////////////////////////////////////////////////////////////////// 
+
+//  returns negative value on error. This should be pure C compatible, so no fstat. 
+static long lodepng_filesize_open(FILE* file)
+{
+  if(fseek(file, 0, SEEK_END) != 0) return -1;
 
   long size = ftell(file);
   //  It may give LONG_MAX as directory size, this is invalid for us. 
   if(size == LONG_MAX) size = -1;
+  return size;
+}
+
+//  returns negative value on error.
+static long lodepng_filesize(const char* filename)
+{
+  FILE *file = fopen(filename, "rb");
+  if(!file) return -1;
+
+  long size = lodepng_filesize_open(file);
 
   fclose(file);
   return size;
@@ -466,6 +992,115 @@ unsigned lodepng_load_file(unsigned char** out, size_t* outsize, const char* fil
   return lodepng_buffer_file(*out, (size_t)size, filename);
 }
 
+// The contents of a file, either memory mapped or loaded into an allocated buffer.
+typedef struct FileBuffer
+{
+  unsigned char* data;
+  size_t size;
+  unsigned mapped; // data is a read-only mapping of the file rather than an allocated buffer
+} FileBuffer;
+
+#ifdef LODEPNG_COMPILE_POSIX
+// Reads from fd until the end of the stream, for files whose size isn't known up front such as pipes.
+static unsigned readStream(ucvector* out, int fd)
+{
+  for(;;)
+  {
+    if(!ucvector_reserve(out, out->size + 65536)) return 83; // alloc fail
+    ssize_t result = read(fd, out->data + out->size, out->allocsize - out->size);
+    if(result < 0 && errno == EINTR) continue;
+    if(result < 0) return 78;
+    if(result == 0) return 0;
+    out->size += (size_t)result;
+  }
+}
+#endif // LODEPNG_COMPILE_POSIX
+
+// Loads the file with the given name. Regular files are memory mapped where available, so the page
+// cache is used directly without copying the file, pipes and other special files are read until their
+// end. Without POSIX, or if mapping fails, this uses lodepng_load_file. The file must not be truncated
+// while it's mapped.
+static unsigned FileBuffer_load(FileBuffer* buffer, const char* filename)
+{
+  buffer->data = 0;
+  buffer->size = 0;
+  buffer->mapped = 0;
+#ifdef LODEPNG_COMPILE_POSIX
+  int fd = open(filename, O_RDONLY);
+  if(fd < 0) return 78;
+  struct stat st;
+  unsigned error = 0;
+  if(fstat(fd, &st) != 0) error = 78;
+  else if(S_ISDIR(st.st_mode)) error = 78;
+  else if(!S_ISREG(st.st_mode))
+  {
+    ucvector stream;
+    ucvector_init(&stream);
+    error = readStream(&stream, fd);
+    buffer->data = stream.data;
+    buffer->size = stream.size;
+  }
+  else if(st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX)
+  {
+    void* data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data != MAP_FAILED)
+    {
+      // the decoder reads the file from front to back, once
+      madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+      buffer->data = (unsigned char*)data;
+      buffer->size = (size_t)st.st_size;
+      buffer->mapped = 1;
+    }
+  }
+  close(fd);
+  if(error || buffer->mapped || !S_ISREG(st.st_mode)) return error;
+#endif // LODEPNG_COMPILE_POSIX
+  return lodepng_load_file(&buffer->data, &buffer->size, filename);
+}
+
+static void FileBuffer_cleanup(FileBuffer* buffer)
+{
+#ifdef LODEPNG_COMPILE_POSIX
+  if(buffer->mapped)
+  {
+    munmap(buffer->data, buffer->size);
+    buffer->data = 0;
+    return;
+  }
+#endif // LODEPNG_COMPILE_POSIX
+  free(buffer->data);
+  buffer->data = 0;
+}
+
+// A file to read parts of at given offsets, given as a FILE or, if file is 0, as a file descriptor.
+typedef struct FileSource
+{
+  FILE* file;
+  int fd;
+  size_t size; // size of the file
+} FileSource;
+
+// Reads size bytes at offset into out. Returns the amount of bytes read, less at the end of the file or on error.
+static size_t FileSource_read(const FileSource* source, size_t offset, unsigned char* out, size_t size)
+{
+#ifdef LODEPNG_COMPILE_POSIX
+  if(!source->file)
+  {
+    size_t total = 0;
+    while(total < size)
+    {
+      ssize_t result = pread(source->fd, out + total, size - total, (off_t)(offset + total));
+      if(result < 0 && errno == EINTR) continue;
+      if(result <= 0) break;
+      total += (size_t)result;
+    }
+    return total;
+  }
+#endif // LODEPNG_COMPILE_POSIX
+  if(offset > LONG_MAX || fseek(source->file, (long)offset, SEEK_SET) != 0) return 0;
+  return fread(out, 1, size, source->file);
+}
+
 // write given buffer to the file, overwriting the file, it doesn't append to it.
 unsigned lodepng_save_file(const unsigned char* buffer, size_t buffersize, const char* filename)
 {
@@ -506,26 +1141,180 @@ static void addBitsToStreamReversed(size_t* bitpointer, ucvector* bitstream, uns
   for(size_t i = 0; i != nbits; ++i) addBitToStream(bitpointer, bitstream, (unsigned char)((value >> (nbits - 1 - i)) & 1));
 }
 
-#define READBIT(bitpointer, bitstream) ((bitstream[bitpointer >> 3] >> (bitpointer & 0x7)) & (unsigned char)1)
+// Reader for the deflate bit stream, which stores values starting at the lsb of each byte.
+// The stream can be split over several spans, e.g. the IDAT chunks of a PNG, which are read
+// in place. Up to 64 bits of input are kept in buffer, so reading a value is a shift and a
+// mask, and the input is loaded 8 bytes at a time. Bits past the end of the input read as 0,
+// BitReader_overrun tells whether any of those have been consumed.
+typedef struct BitReader
+{
+  const unsigned char* next; // next input byte to load into buffer
+  const unsigned char* end; // end of the current span
+  const ByteSpan* span; // the span after the current one
+  const ByteSpan* spanend;
+  size_t later; // total size of the spans after the current one
+  uint64_t buffer; // the next bit of the stream is the lsb
+  unsigned bitcount; // number of valid bits in buffer
+  size_t padbits; // number of zero bits loaded past the end of the input
+} BitReader;
 
-static unsigned char readBitFromStream(size_t* bitpointer, const unsigned char* bitstream)
+/*Continues the stream with the given spans, after the input that was already loaded into buffer. Used
+when the input arrives in pieces, the spans of earlier pieces are not read anymore.*/
+static void BitReader_setInput(BitReader* reader, const ByteSpan* spans, size_t numspans)
 {
-  unsigned char result = (unsigned char)(READBIT(*bitpointer, bitstream));
-  ++(*bitpointer);
-  return result;
+  reader->next = reader->end = 0;
+  reader->span = spans;
+  reader->spanend = spans + numspans;
+  reader->later = 0;
+  for(size_t i = 0; i != numspans; ++i) reader->later += spans[i].size;
+}
+
+static void BitReader_init(BitReader* reader, const ByteSpan* spans, size_t numspans)
+{
+  BitReader_setInput(reader, spans, numspans);
+  reader->buffer = 0;
+  reader->bitcount = 0;
+  reader->padbits = 0;
+}
+
+// Moves on to the next span that isn't empty. Returns 0 if there is none.
+static unsigned BitReader_nextSpan(BitReader* reader)
+{
+  while(reader->span != reader->spanend)
+  {
+    reader->next = reader->span->data;
+    reader->end = reader->next + reader->span->size;
+    reader->later -= reader->span->size;
+    ++reader->span;
+    if(reader->next != reader->end) return 1;
+  }
+  return 0;
+}
+
+// Amount of input bytes that haven't been loaded into buffer yet.
+static size_t BitReader_available(const BitReader* reader)
+{
+  return (size_t)(reader->end - reader->next) + reader->later;
+}
+
+// Position in bits of the next bit of the stream, counted from the start of the input of insize bytes.
+static size_t BitReader_position(const BitReader* reader, size_t insize)
+{
+  return (insize - BitReader_available(reader)) * 8 + reader->padbits - reader->bitcount;
+}
+
+static unsigned readLE32(const unsigned char* p)
+{
+  return (unsigned)p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+static uint64_t readLE64(const unsigned char* p)
+{
+  return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24)
+       | ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
 }
 
-static unsigned readBitsFromStream(size_t* bitpointer, const unsigned char* bitstream, size_t nbits)
+// Loads input until buffer holds at least 56 bits.
+static void BitReader_refill(BitReader* reader)
 {
-  unsigned result = 0, i;
-  for(i = 0; i != nbits; ++i)
+  if(reader->end - reader->next >= 8)
+  {
+    // The bits above bitcount may already hold input from an earlier refill. They are
+    // the same bits at the same position, so or-ing them in again changes nothing.
+    reader->buffer |= readLE64(reader->next) << reader->bitcount;
+    reader->next += (63 - reader->bitcount) >> 3;
+    reader->bitcount |= 56;
+  }
+  else
   {
-    result += ((unsigned)READBIT(*bitpointer, bitstream)) << i;
-    ++(*bitpointer);
+    while(reader->bitcount < 56)
+    {
+      if(reader->next != reader->end || BitReader_nextSpan(reader))
+      {
+        reader->buffer |= (uint64_t)(*reader->next++) << reader->bitcount;
+      }
+      else reader->padbits += 8;
+      reader->bitcount += 8;
+    }
   }
+}
+
+// Returns the next nbits bits without consuming them. buffer must hold at least nbits bits.
+static unsigned BitReader_peek(const BitReader* reader, unsigned nbits)
+{
+  return (unsigned)(reader->buffer & (((uint64_t)1 << nbits) - 1u));
+}
+
+static void BitReader_consume(BitReader* reader, unsigned nbits)
+{
+  reader->buffer >>= nbits;
+  reader->bitcount -= nbits;
+}
+
+// Reads nbits bits, nbits can be at most 32.
+static unsigned BitReader_readBits(BitReader* reader, unsigned nbits)
+{
+  if(reader->bitcount < nbits) BitReader_refill(reader);
+  unsigned result = BitReader_peek(reader, nbits);
+  BitReader_consume(reader, nbits);
   return result;
 }
 
+// Whether bits past the end of the input have been read.
+static unsigned BitReader_overrun(const BitReader* reader)
+{
+  return reader->padbits > reader->bitcount;
+}
+
+// Skips the remaining bits of the current byte. All input loaded into buffer is whole bytes,
+// so the stream is at a byte boundary when bitcount is a multiple of 8.
+static void BitReader_alignToByte(BitReader* reader)
+{
+  BitReader_consume(reader, reader->bitcount & 7u);
+}
+
+// Skips the first bits bits of the input, which must not be longer than the input. Only right after init.
+static void BitReader_skip(BitReader* reader, size_t bits)
+{
+  size_t bytes = bits >> 3;
+  while(bytes >= (size_t)(reader->end - reader->next))
+  {
+    bytes -= (size_t)(reader->end - reader->next);
+    reader->next = reader->end;
+    if(bytes == 0 || !BitReader_nextSpan(reader)) break;
+  }
+  reader->next += bytes;
+  BitReader_readBits(reader, (unsigned)(bits & 7u));
+}
+
+// Copies size bytes from a byte aligned position. Returns 0 if the input is too short.
+static unsigned BitReader_readBytes(BitReader* reader, unsigned char* out, size_t size)
+{
+  // first the bytes that are already in buffer
+  while(size != 0 && reader->bitcount != 0)
+  {
+    *out++ = (unsigned char)reader->buffer;
+    BitReader_consume(reader, 8);
+    --size;
+  }
+  if(BitReader_overrun(reader)) return 0;
+  if(size == 0) return 1;
+
+  // buffer is empty now, but may hold stale bits of the input that is skipped below
+  reader->buffer = 0;
+  while(size != 0)
+  {
+    if(reader->next == reader->end && !BitReader_nextSpan(reader)) return 0;
+    size_t amount = (size_t)(reader->end - reader->next);
+    if(amount > size) amount = size;
+    memcpy(out, reader->next, amount);
+    reader->next += amount;
+    out += amount;
+    size -= amount;
+  }
+  return 1;
+}
+
 //////////////////////////////////////////////////////////////////////////// 
 /// Deflate - Huffman                                                      / 
 //////////////////////////////////////////////////////////////////////////// 
@@ -569,13 +1358,21 @@ static const unsigned CLCL_ORDER[NUM_CODE_LENGTH_CODES]
 // Huffman tree struct, containing multiple representations of the tree
 typedef struct HuffmanTree
 {
-  unsigned* tree2d;
   unsigned* tree1d;
   unsigned* lengths; // the lengths of the codes of the 1d-tree
   unsigned maxbitlen; // maximum number of bits a single code can get
   unsigned numcodes; // number of symbols in the alphabet = number of codes
+  // lookup tables used by the decoder, see HuffmanTree_makeTable
+  unsigned char* table_len; // code length of the symbol, or size of the secondary table
+  unsigned short* table_value; // the symbol, or start index of the secondary table
 } HuffmanTree;
 
+// number of bits resolved by the first level of the decoding table. Codes up to this
+// length are decoded with a single table lookup, longer codes with a second one.
+#define FIRSTBITS 9u
+// symbol value given to table entries that no valid code leads to
+#define INVALIDSYMBOL 65535u
+
 // function used for debug purposes to draw the tree in ascii art with C++
 /*
 static void HuffmanTree_draw(HuffmanTree* tree)
@@ -591,72 +1388,133 @@ static void HuffmanTree_draw(HuffmanTree* tree)
 
 static void HuffmanTree_init(HuffmanTree* tree)
 {
-  tree->tree2d = 0;
   tree->tree1d = 0;
   tree->lengths = 0;
+  tree->table_len = 0;
+  tree->table_value = 0;
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree)
 {
-  free(tree->tree2d);
   free(tree->tree1d);
   free(tree->lengths);
+  free(tree->table_len);
+  free(tree->table_value);
+}
+
+static unsigned reverseBits(unsigned bits, unsigned num)
+{
+  unsigned result = 0;
+  for(unsigned i = 0; i != num; ++i) result |= ((bits >> (num - i - 1)) & 1u) << i;
+  return result;
 }
 
-// the tree representation used by the decoder. return value is error
-static unsigned HuffmanTree_make2DTree(HuffmanTree* tree)
+// Makes the lookup tables used by the decoder. tree1d and lengths must already be filled in.
+// The deflate bit stream is read lsb first while Huffman codes are stored msb first, so the
+// tables are indexed with the bit-reversed codes: the next FIRSTBITS bits of the stream
+// directly give the index in the first table. An entry there either holds a symbol with its
+// code length, or, for codes longer than FIRSTBITS, the start of a secondary table indexed
+// with the remaining bits, together with the longest code length in that secondary table.
+// return value is error
+static unsigned HuffmanTree_makeTable(HuffmanTree* tree)
 {
-  unsigned nodefilled = 0; // up to which node it is filled
-  unsigned treepos = 0; // position in the tree (1 of the numcodes columns)
-  unsigned n, i;
+  const unsigned headsize = 1u << FIRSTBITS;
+  const unsigned mask = headsize - 1u;
+  unsigned maxlens[1u << FIRSTBITS]; // longest code length sharing each first table index
+  size_t size, pointer, numpresent = 0;
+  unsigned i;
+
+  for(i = 0; i != headsize; ++i) maxlens[i] = 0;
+  for(i = 0; i != tree->numcodes; ++i)
+  {
+    unsigned l = tree->lengths[i];
+    if(l <= FIRSTBITS) continue;
+    // the first FIRSTBITS bits of the code select the entry in the first table
+    unsigned index = reverseBits(tree->tree1d[i] >> (l - FIRSTBITS), FIRSTBITS);
+    if(l > maxlens[index]) maxlens[index] = l;
+  }
 
-  tree->tree2d = (unsigned*)malloc(tree->numcodes * 2 * sizeof(unsigned));
-  if(!tree->tree2d) return 83; // alloc fail
+  size = headsize;
+  for(i = 0; i != headsize; ++i)
+  {
+    if(maxlens[i] > FIRSTBITS) size += (size_t)1u << (maxlens[i] - FIRSTBITS);
+  }
+
+  tree->table_len = (unsigned char*)malloc(size * sizeof(unsigned char));
+  tree->table_value = (unsigned short*)malloc(size * sizeof(unsigned short));
+  if(!tree->table_len || !tree->table_value) return 83; // alloc fail
+
+  // 16 is larger than any code length, it marks entries that are not filled in yet
+  for(i = 0; i != size; ++i) tree->table_len[i] = 16;
 
-  // convert tree1d[] to tree2d[][]. In the 2D array, a value of 32767 means
-  // uninited, a value >= numcodes is an address to another bit, a value < numcodes
-  // is a code. The 2 rows are the 2 possible bit values (0 or 1), there are as
-  // many columns as codes - 1.
-  // A good huffman tree has N * 2 - 1 nodes, of which N - 1 are internal nodes.
-  // Here, the internal nodes are stored (what their 0 and 1 option point to).
-  // There is only memory for such good tree currently, if there are more nodes
-  // (due to too long length codes), error 55 will happen
-  for(n = 0; n < tree->numcodes * 2; ++n)
+  // entries in the first table that point to a secondary table
+  pointer = headsize;
+  for(i = 0; i != headsize; ++i)
   {
-    tree->tree2d[n] = 32767; // 32767 here means the tree2d isn't filled there yet
+    if(maxlens[i] <= FIRSTBITS) continue;
+    tree->table_len[i] = (unsigned char)maxlens[i];
+    tree->table_value[i] = (unsigned short)pointer;
+    pointer += (size_t)1u << (maxlens[i] - FIRSTBITS);
   }
 
-  for(n = 0; n < tree->numcodes; ++n) // the codes
+  for(i = 0; i != tree->numcodes; ++i)
   {
-    for(i = 0; i != tree->lengths[n]; ++i) // the bits for this code
+    unsigned l = tree->lengths[i];
+    if(l == 0) continue;
+    unsigned reverse = reverseBits(tree->tree1d[i], l);
+    ++numpresent;
+
+    if(l <= FIRSTBITS)
     {
-      unsigned char bit = (unsigned char)((tree->tree1d[n] >> (tree->lengths[n] - i - 1)) & 1);
-      // oversubscribed, see comment in lodepng_error_text
-      if(treepos > 2147483647 || treepos + 2 > tree->numcodes) return 55;
-      if(tree->tree2d[2 * treepos + bit] == 32767) // not yet filled in
+      // short code: fill in every first table entry that starts with these l bits
+      unsigned num = 1u << (FIRSTBITS - l);
+      for(unsigned j = 0; j != num; ++j)
       {
-        if(i + 1 == tree->lengths[n]) // last bit
-        {
-          tree->tree2d[2 * treepos + bit] = n; // put the current code in it
-          treepos = 0;
-        }
-        else
-        {
-          // put address of the next step in here, first that address has to be found of course
-          // (it's just nodefilled + 1)...
-          ++nodefilled;
-          // addresses encoded with numcodes added to it
-          tree->tree2d[2 * treepos + bit] = nodefilled + tree->numcodes;
-          treepos = nodefilled;
-        }
+        unsigned index = reverse | (j << l);
+        if(tree->table_len[index] != 16) return 55; // oversubscribed, see comment in lodepng_error_text
+        tree->table_len[index] = (unsigned char)l;
+        tree->table_value[index] = (unsigned short)i;
+      }
+    }
+    else
+    {
+      // long code: fill in the secondary table of its first FIRSTBITS bits
+      unsigned index = reverse & mask;
+      unsigned maxlen = tree->table_len[index];
+      if(maxlen < l) return 55; // a short code already uses this prefix
+      unsigned start = tree->table_value[index];
+      unsigned num = 1u << (maxlen - l);
+      unsigned reverse2 = reverse >> FIRSTBITS;
+      for(unsigned j = 0; j != num; ++j)
+      {
+        size_t index2 = start + (reverse2 | (j << (l - FIRSTBITS)));
+        if(tree->table_len[index2] != 16) return 55; // oversubscribed
+        tree->table_len[index2] = (unsigned char)l;
+        tree->table_value[index2] = (unsigned short)i;
       }
-      else treepos = tree->tree2d[2 * treepos + bit] - tree->numcodes;
     }
   }
 
-  for(n = 0; n < tree->numcodes * 2; ++n)
+  if(numpresent < 2)
+  {
+    // A tree with a single code of 1 bit, or without codes at all (e.g. a distance tree
+    // of a block without matches), is allowed. The other bit combinations decode to
+    // INVALIDSYMBOL, which makes the decoder give an error if such a code is encountered.
+    for(i = 0; i != size; ++i)
+    {
+      if(tree->table_len[i] != 16) continue;
+      // the length must stay valid for the table walk: <= FIRSTBITS in the first table
+      tree->table_len[i] = (unsigned char)(i < headsize ? 1 : FIRSTBITS + 1);
+      tree->table_value[i] = INVALIDSYMBOL;
+    }
+  }
+  else
   {
-    if(tree->tree2d[n] == 32767) tree->tree2d[n] = 0; // remove possible remaining 32767's
+    // a complete tree fills every entry, if any are left the code lengths are invalid
+    for(i = 0; i != size; ++i)
+    {
+      if(tree->table_len[i] == 16) return 55;
+    }
   }
 
   return 0;
@@ -700,12 +1558,12 @@ static unsigned HuffmanTree_makeFromLengths2(HuffmanTree* tree)
   uivector_cleanup(&blcount);
   uivector_cleanup(&nextcode);
 
-  if(!error) return HuffmanTree_make2DTree(tree);
-  else return error;
+  return error;
 }
 
 // given the code lengths (as stored in the PNG file), generate the tree as defined
-// by Deflate. maxbitlen is the maximum bits that a code in the tree can have.
+// by Deflate, including the decoding tables. maxbitlen is the maximum bits that a
+// code in the tree can have.
 // return value is error.
 static unsigned HuffmanTree_makeFromLengths(HuffmanTree* tree, const unsigned* bitlen,
                                             size_t numcodes, unsigned maxbitlen)
@@ -715,7 +1573,8 @@ static unsigned HuffmanTree_makeFromLengths(HuffmanTree* tree, const unsigned* b
   for(unsigned i = 0; i != numcodes; ++i) tree->lengths[i] = bitlen[i];
   tree->numcodes = (unsigned)numcodes; // number of symbols
   tree->maxbitlen = maxbitlen;
-  return HuffmanTree_makeFromLengths2(tree);
+  CERROR_TRY_RETURN(HuffmanTree_makeFromLengths2(tree));
+  return HuffmanTree_makeTable(tree);
 }
 
 // BPM: Boundary Package Merge, see "A Fast and Space-Economical Algorithm for Length-Limited Coding",
@@ -990,49 +1849,206 @@ static unsigned generateFixedDistanceTree(HuffmanTree* tree)
   return error;
 }
 
-// returns the code, or (unsigned)(-1) if error happened
-// inbitlength is the length of the complete buffer, in bits (so its byte length times 8)
-static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
-                                    const HuffmanTree* codetree, size_t inbitlength)
+// Decodes a symbol from the bits in the buffer of the reader, which must hold at least 15 bits.
+static unsigned huffmanDecodeSymbolBuffered(BitReader* reader, const HuffmanTree* codetree)
 {
-  unsigned treepos = 0, ct;
-  for(;;)
+  unsigned code = (unsigned)reader->buffer;
+  unsigned index = code & ((1u << FIRSTBITS) - 1u);
+  unsigned l = codetree->table_len[index];
+  unsigned value = codetree->table_value[index];
+  if(l > FIRSTBITS)
   {
-    if(*bp >= inbitlength) return (unsigned)(-1); // error: end of input memory reached without endcode
-    /*
-    decode the symbol from the tree. The "readBitFromStream" code is inlined in
-    the expression below because this is the biggest bottleneck while decoding
-    */
-    ct = codetree->tree2d[(treepos << 1) + READBIT(*bp, in)];
-    ++(*bp);
-    if(ct < codetree->numcodes) return ct; // the symbol is decoded, return it
-    else treepos = ct - codetree->numcodes; // symbol not yet decoded, instead move tree position
+    // the code is longer than FIRSTBITS, look up the remaining bits in the secondary table
+    index = value + ((code >> FIRSTBITS) & ((1u << (l - FIRSTBITS)) - 1u));
+    l = codetree->table_len[index];
+    value = codetree->table_value[index];
+  }
+  BitReader_consume(reader, l);
+  return value;
+}
+
+// returns the code, or (unsigned)(-1) if the end of the input was reached
+static unsigned huffmanDecodeSymbol(BitReader* reader, const HuffmanTree* codetree)
+{
+  if(reader->bitcount < 15) BitReader_refill(reader); // 15 bits is the longest code
+  unsigned value = huffmanDecodeSymbolBuffered(reader, codetree);
+  if(BitReader_overrun(reader)) return (unsigned)(-1); // error: end of input memory reached without endcode
+  return value;
+}
+
+
+//////////////////////////////////////////////////////////////////////////// 
+/// Adler32                                                                  
+//////////////////////////////////////////////////////////////////////////// 
+
+#define ADLER32_BASE 65521u
+// at most this many bytes can be summed before s2 can overflow, saving a lot of modulo divisions
+#define ADLER32_NMAX 5552u
+
+static unsigned adler32Update_scalar(unsigned adler, const unsigned char* data, size_t len)
+{
+  unsigned s1 = adler & 0xffff;
+  unsigned s2 = (adler >> 16) & 0xffff;
+
+  while(len > 0)
+  {
+    size_t amount = len > ADLER32_NMAX ? ADLER32_NMAX : len;
+    len -= amount;
+    while(amount > 0)
+    {
+      s1 += (*data++);
+      s2 += s1;
+      --amount;
+    }
+    s1 %= ADLER32_BASE;
+    s2 %= ADLER32_BASE;
+  }
+
+  return (s2 << 16) | s1;
+}
+
+#ifdef LODEPNG_COMPILE_SIMD
+/*Blocks of 32 bytes: s1 gets the sum of the bytes (psadbw), s2 gets 32 times s1 from before the block
+plus the bytes weighted 32 down to 1 (pmaddubsw). Up to ADLER32_NMAX bytes are done before the
+modulo, the rest is left to the scalar code. The vector sums of s2 are spread over lanes, their
+total is the s2 of the scalar code, so no lane can overflow either.*/
+static LODEPNG_TARGET("ssse3") unsigned adler32Update_ssse3(unsigned adler, const unsigned char* data, size_t len)
+{
+  unsigned s1 = adler & 0xffff;
+  unsigned s2 = (adler >> 16) & 0xffff;
+  const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+  const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+
+  size_t blocks = len / 32;
+  len -= blocks * 32;
+  while(blocks)
+  {
+    size_t n = blocks > ADLER32_NMAX / 32 ? ADLER32_NMAX / 32 : blocks;
+    blocks -= n;
+
+    __m128i v_ps = _mm_cvtsi32_si128((int)(s1 * n)); // sum of s1 before each block
+    __m128i v_s1 = zero;
+    __m128i v_s2 = _mm_cvtsi32_si128((int)s2);
+    for(; n != 0; --n, data += 32)
+    {
+      __m128i bytes1 = _mm_loadu_si128((const __m128i*)data);
+      __m128i bytes2 = _mm_loadu_si128((const __m128i*)(data + 16));
+      v_ps = _mm_add_epi32(v_ps, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+    }
+    v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+    v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+    s1 = (s1 + (unsigned)_mm_cvtsi128_si32(v_s1)) % ADLER32_BASE;
+    s2 = (unsigned)_mm_cvtsi128_si32(v_s2) % ADLER32_BASE;
+  }
+  return adler32Update_scalar((s2 << 16) | s1, data, len);
+}
 
-    if(treepos >= codetree->numcodes) return (unsigned)(-1); // error: it appeared outside the codetree
+// the same as adler32Update_ssse3, with each block of 32 bytes in a single register
+static LODEPNG_TARGET("avx2") unsigned adler32Update_avx2(unsigned adler, const unsigned char* data, size_t len)
+{
+  unsigned s1 = adler & 0xffff;
+  unsigned s2 = (adler >> 16) & 0xffff;
+  const __m256i tap = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                       16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ones = _mm256_set1_epi16(1);
+
+  size_t blocks = len / 32;
+  len -= blocks * 32;
+  while(blocks)
+  {
+    size_t n = blocks > ADLER32_NMAX / 32 ? ADLER32_NMAX / 32 : blocks;
+    blocks -= n;
+
+    __m256i v_ps = _mm256_setr_epi32((int)(s1 * n), 0, 0, 0, 0, 0, 0, 0);
+    __m256i v_s1 = zero;
+    __m256i v_s2 = _mm256_setr_epi32((int)s2, 0, 0, 0, 0, 0, 0, 0);
+    for(; n != 0; --n, data += 32)
+    {
+      __m256i bytes = _mm256_loadu_si256((const __m256i*)data);
+      v_ps = _mm256_add_epi32(v_ps, v_s1);
+      v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes, zero));
+      v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, tap), ones));
+    }
+    v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 5));
+
+    __m128i h_s1 = _mm_add_epi32(_mm256_castsi256_si128(v_s1), _mm256_extracti128_si256(v_s1, 1));
+    __m128i h_s2 = _mm_add_epi32(_mm256_castsi256_si128(v_s2), _mm256_extracti128_si256(v_s2, 1));
+    h_s1 = _mm_add_epi32(h_s1, _mm_shuffle_epi32(h_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+    h_s2 = _mm_add_epi32(h_s2, _mm_shuffle_epi32(h_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+    h_s2 = _mm_add_epi32(h_s2, _mm_shuffle_epi32(h_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+    s1 = (s1 + (unsigned)_mm_cvtsi128_si32(h_s1)) % ADLER32_BASE;
+    s2 = (unsigned)_mm_cvtsi128_si32(h_s2) % ADLER32_BASE;
+  }
+  return adler32Update_scalar((s2 << 16) | s1, data, len);
+}
+#endif // LODEPNG_COMPILE_SIMD
+
+// Updates adler, the adler32 of the bytes before data, with the bytes data[0..len-1]
+static unsigned adler32Update(unsigned adler, const unsigned char* data, size_t len)
+{
+#ifdef LODEPNG_COMPILE_SIMD
+  if(len >= 64)
+  {
+    unsigned features = getCpuFeatures();
+    if(features & LODEPNG_CPU_AVX2) return adler32Update_avx2(adler, data, len);
+    if(features & LODEPNG_CPU_SSSE3) return adler32Update_ssse3(adler, data, len);
   }
+#endif // LODEPNG_COMPILE_SIMD
+  return adler32Update_scalar(adler, data, len);
+}
+
+// Return the adler32 of the bytes data[0..len-1]
+static unsigned adler32(const unsigned char* data, size_t len)
+{
+  return adler32Update(1, data, len);
 }
 
+#ifdef LODEPNG_COMPILE_THREADS
+// Gives the adler32 of two pieces of data one after the other, from the adler32 of each, len2 the size of the second.
+static unsigned adler32Combine(unsigned adler1, unsigned adler2, size_t len2)
+{
+  const unsigned base = 65521u;
+  unsigned rem = (unsigned)(len2 % base);
+  unsigned s1 = adler1 & 0xffff;
+  unsigned s2 = (rem * s1) % base;
+  // each of s2 of the second part gets s1 of the first part added to it for each of its bytes
+  s1 += (adler2 & 0xffff) + base - 1;
+  s2 += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+  if(s1 >= base) s1 -= base;
+  if(s1 >= base) s1 -= base;
+  if(s2 >= 2 * base) s2 -= 2 * base;
+  if(s2 >= base) s2 -= base;
+  return s1 | (s2 << 16);
+}
+#endif // LODEPNG_COMPILE_THREADS
 
 //////////////////////////////////////////////////////////////////////////// 
 /// Inflator (Decompressor)                                                / 
 //////////////////////////////////////////////////////////////////////////// 
 
 // get the tree of a deflated block with fixed tree, as specified in the deflate specification
-static void getTreeInflateFixed(HuffmanTree* tree_ll, HuffmanTree* tree_d)
+static unsigned getTreeInflateFixed(HuffmanTree* tree_ll, HuffmanTree* tree_d)
 {
-  // TODO: check for out of memory errors
-  generateFixedLitLenTree(tree_ll);
-  generateFixedDistanceTree(tree_d);
+  CERROR_TRY_RETURN(generateFixedLitLenTree(tree_ll));
+  return generateFixedDistanceTree(tree_d);
 }
 
 // get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree
-static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
-                                      const unsigned char* in, size_t* bp, size_t inlength)
+static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d, BitReader* reader)
 {
   // make sure that length values that aren't filled in will be 0, or a wrong tree will be generated
   unsigned error = 0;
   unsigned n, HLIT, HDIST, HCLEN, i;
-  size_t inbitlength = inlength * 8;
 
   // see comments in deflateDynamic for explanation of the context and these variables, it is analogous
   unsigned* bitlen_ll = 0; // lit,len code lengths
@@ -1041,16 +2057,15 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
   unsigned* bitlen_cl = 0;
   HuffmanTree tree_cl; // the code tree for code length codes (the huffman tree for compressed huffman trees)
 
-  if((*bp) + 14 > (inlength << 3)) return 49; // error: the bit pointer is or will go past the memory
-
+  BitReader_refill(reader);
   // number of literal/length codes + 257. Unlike the spec, the value 257 is added to it here already
-  HLIT =  readBitsFromStream(bp, in, 5) + 257;
+  HLIT =  BitReader_readBits(reader, 5) + 257;
   // number of distance codes. Unlike the spec, the value 1 is added to it here already
-  HDIST = readBitsFromStream(bp, in, 5) + 1;
+  HDIST = BitReader_readBits(reader, 5) + 1;
   // number of code length codes. Unlike the spec, the value 4 is added to it here already
-  HCLEN = readBitsFromStream(bp, in, 4) + 4;
+  HCLEN = BitReader_readBits(reader, 4) + 4;
 
-  if((*bp) + HCLEN * 3 > (inlength << 3)) return 50; // error: the bit pointer is or will go past the memory
+  if(BitReader_overrun(reader)) return 49; // error: the bit pointer is or will go past the memory
 
   HuffmanTree_init(&tree_cl);
 
@@ -1063,9 +2078,10 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 
     for(i = 0; i != NUM_CODE_LENGTH_CODES; ++i)
     {
-      if(i < HCLEN) bitlen_cl[CLCL_ORDER[i]] = readBitsFromStream(bp, in, 3);
+      if(i < HCLEN) bitlen_cl[CLCL_ORDER[i]] = BitReader_readBits(reader, 3);
       else bitlen_cl[CLCL_ORDER[i]] = 0; // if not, it must stay 0
     }
+    if(BitReader_overrun(reader)) ERROR_BREAK(50); // error: the bit pointer is or will go past the memory
 
     error = HuffmanTree_makeFromLengths(&tree_cl, bitlen_cl, NUM_CODE_LENGTH_CODES, 7);
     if(error) break;
@@ -1081,7 +2097,7 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
     i = 0;
     while(i < HLIT + HDIST)
     {
-      unsigned code = huffmanDecodeSymbol(in, bp, &tree_cl, inbitlength);
+      unsigned code = huffmanDecodeSymbol(reader, &tree_cl);
       if(code <= 15) // a length code
       {
         if(i < HLIT) bitlen_ll[i] = code;
@@ -1095,8 +2111,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 
         if(i == 0) ERROR_BREAK(54); // can't repeat previous if i is 0
 
-        if((*bp + 2) > inbitlength) ERROR_BREAK(50); // error, bit pointer jumps past memory
-        replength += readBitsFromStream(bp, in, 2);
+        replength += BitReader_readBits(reader, 2);
+        if(BitReader_overrun(reader)) ERROR_BREAK(50); // error, bit pointer jumps past memory
 
         if(i < HLIT + 1) value = bitlen_ll[i - 1];
         else value = bitlen_d[i - HLIT - 1];
@@ -1112,8 +2128,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
       else if(code == 17) // repeat "0" 3-10 times
       {
         unsigned replength = 3; // read in the bits that indicate repeat length
-        if((*bp + 3) > inbitlength) ERROR_BREAK(50); // error, bit pointer jumps past memory
-        replength += readBitsFromStream(bp, in, 3);
+        replength += BitReader_readBits(reader, 3);
+        if(BitReader_overrun(reader)) ERROR_BREAK(50); // error, bit pointer jumps past memory
 
         // repeat this value in the next lengths
         for(n = 0; n < replength; ++n)
@@ -1128,8 +2144,8 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
       else if(code == 18) // repeat "0" 11-138 times
       {
         unsigned replength = 11; // read in the bits that indicate repeat length
-        if((*bp + 7) > inbitlength) ERROR_BREAK(50); // error, bit pointer jumps past memory
-        replength += readBitsFromStream(bp, in, 7);
+        replength += BitReader_readBits(reader, 7);
+        if(BitReader_overrun(reader)) ERROR_BREAK(50); // error, bit pointer jumps past memory
 
         // repeat this value in the next lengths
         for(n = 0; n < replength; ++n)
@@ -1143,12 +2159,7 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
       }
       else // if(code == (unsigned)(-1))*/ /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error
       {
-        if(code == (unsigned)(-1))
-        {
-          /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
-          (10=no endcode, 11=wrong jump outside of tree)*/
-          error = (*bp) > inbitlength ? 10 : 11;
-        }
+        if(code == (unsigned)(-1)) error = 10; // end of input memory reached without endcode
         else error = 16; // unexisting code, this can never happen
         break;
       }
@@ -1173,31 +2184,240 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
   return error;
 }
 
-// inflate a block with dynamic of fixed Huffman tree
-static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size_t* bp,
-                                    size_t* pos, size_t inlength, unsigned btype)
+/*State of the inflater, which allows decompressing a deflate stream piece by piece: Inflator_run
+stops once a given amount of output is available, and continues where it left off on the next call.
+The output goes to a ucvector. Unless fixedsize, it grows as needed. If fixedsize, the space reserved
+in it can't grow: either it is the exact size of the decompressed data, known in advance, and more
+output than that gives error 91, or the caller keeps enough room free for the output it asks for.
+That is faster since the output never has to grow.
+The input can also arrive piece by piece. Then keepinput is set while more input may follow: the
+inflater stops before less than that much input is left, and continues once the reader has been
+given more with BitReader_setInput. keepinput must be at least INFLATE_STREAM_MARGIN.*/
+typedef struct Inflator
+{
+  BitReader reader;
+  ucvector* out; // matches refer back into it, it must keep at least the last 32768 bytes of output
+  size_t pos; // amount of output in out
+  unsigned fixedsize;
+  unsigned inblock; // in the middle of a block of type btype
+  unsigned btype;
+  unsigned final; // the current or last block has BFINAL set
+  unsigned done; // the end of the final block was reached
+  size_t storedleft; // bytes left to copy of a block without compression
+  HuffmanTree tree_ll; // the huffman tree for literal and length codes of the current block
+  HuffmanTree tree_d; // the huffman tree for distance codes of the current block
+  unsigned check_adler32; // keep adler up to date with the output
+  unsigned adler; // adler32 of the output before adlerpos
+  size_t adlerpos;
+  size_t keepinput; // amount of input to leave unread, because the end of the input isn't known yet
+  unsigned stopatblock; // Inflator_run also returns at the end of each block
+} Inflator;
+
+/*Input that is enough for any single step of the inflater: a block header with the largest possible
+Huffman trees (at most 316 code lengths of 14 bits), or one symbol with its extra bits.*/
+#define INFLATE_STREAM_MARGIN 1024
+
+static void Inflator_init(Inflator* inflator, const ByteSpan* spans, size_t numspans,
+                          ucvector* out, unsigned fixedsize)
+{
+  BitReader_init(&inflator->reader, spans, numspans);
+  inflator->out = out;
+  inflator->pos = 0;
+  inflator->fixedsize = fixedsize;
+  inflator->inblock = inflator->btype = inflator->final = inflator->done = 0;
+  inflator->storedleft = 0;
+  inflator->check_adler32 = 0;
+  inflator->adler = 1;
+  inflator->adlerpos = 0;
+  inflator->keepinput = 0;
+  inflator->stopatblock = 0;
+  HuffmanTree_init(&inflator->tree_ll);
+  HuffmanTree_init(&inflator->tree_d);
+}
+
+static void Inflator_cleanup(Inflator* inflator)
+{
+  HuffmanTree_cleanup(&inflator->tree_ll);
+  HuffmanTree_cleanup(&inflator->tree_d);
+}
+
+// Makes sure out can hold size bytes. If fixedsize, the space reserved in out can't grow.
+static unsigned inflateReserve(ucvector* out, size_t size, unsigned fixedsize)
+{
+  if(size <= out->allocsize) return 0;
+  if(fixedsize) return 91; // decompressed size doesn't match prediction
+  return ucvector_reserve(out, size) ? 0 : 83; // alloc fail
+}
+
+// Room the fast loop of inflateHuffmanData needs in the output: the longest match, plus
+// the up to 15 bytes that inflateCopyMatch may write past its end.
+#define INFLATE_FAST_MARGIN (258 + 16)
+
+// Copies a match of length bytes from distance bytes back, in 16 or 8 byte steps. Writes up to
+// 15 bytes past dst + length, whatever is written there gets overwritten by later output.
+static void inflateCopyMatch(unsigned char* dst, size_t distance, size_t length)
+{
+  const unsigned char* src = dst - distance;
+  unsigned char* end = dst + length;
+  if(distance >= 16)
+  {
+    do { memcpy(dst, src, 16); dst += 16; src += 16; } while(dst < end);
+  }
+  else if(distance >= 8)
+  {
+    do { memcpy(dst, src, 8); dst += 8; src += 8; } while(dst < end);
+  }
+  else
+  {
+    /*The match repeats a pattern of distance bytes, so it can equally be copied from any
+    multiple of distance back. Copy single bytes until the multiple of distance that is
+    at least 8 is available, then continue in 8 byte steps from there.*/
+    size_t period = distance;
+    while(period < 8) period += distance;
+    for(size_t i = 0; i != period - distance && dst < end; ++i) *dst++ = *src++;
+    src = dst - period;
+    while(dst < end) { memcpy(dst, src, 8); dst += 8; src += 8; }
+  }
+}
+
+// Reads the header of the next block, and its trees if it uses Huffman codes.
+static unsigned Inflator_startBlock(Inflator* inflator)
 {
-  unsigned error = 0;
-  HuffmanTree tree_ll; // the huffman tree for literal and length codes
-  HuffmanTree tree_d; // the huffman tree for distance codes
-  size_t inbitlength = inlength * 8;
+  BitReader* reader = &inflator->reader;
+  inflator->final = BitReader_readBits(reader, 1);
+  inflator->btype = BitReader_readBits(reader, 2);
+  if(BitReader_overrun(reader)) return 52; // error, bit pointer will jump past memory
+  if(inflator->btype == 3) return 20; // error: invalid BTYPE
 
-  HuffmanTree_init(&tree_ll);
-  HuffmanTree_init(&tree_d);
+  if(inflator->btype == 0) // no compression
+  {
+    // go to first boundary of byte
+    BitReader_alignToByte(reader);
+
+    // read LEN (2 bytes) and NLEN (2 bytes)
+    unsigned LEN = BitReader_readBits(reader, 16);
+    unsigned NLEN = BitReader_readBits(reader, 16);
+    if(BitReader_overrun(reader)) return 52; // error, bit pointer will jump past memory
+
+    // check if 16-bit NLEN is really the one's complement of LEN
+    if(LEN + NLEN != 65535) return 21; // error: NLEN is not one's complement of LEN
+    inflator->storedleft = LEN;
+  }
+  else // compression, BTYPE 01 or 10
+  {
+    HuffmanTree_cleanup(&inflator->tree_ll);
+    HuffmanTree_cleanup(&inflator->tree_d);
+    HuffmanTree_init(&inflator->tree_ll);
+    HuffmanTree_init(&inflator->tree_d);
+    unsigned error;
+    if(inflator->btype == 1) error = getTreeInflateFixed(&inflator->tree_ll, &inflator->tree_d);
+    else error = getTreeInflateDynamic(&inflator->tree_ll, &inflator->tree_d, reader);
+    if(error) return error;
+  }
 
-  if(btype == 1) getTreeInflateFixed(&tree_ll, &tree_d);
-  else if(btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, in, bp, inlength);
+  inflator->inblock = 1;
+  return 0;
+}
+
+// copies the data of a block without compression, until there are target bytes of output
+static unsigned inflateStoredData(Inflator* inflator, size_t target)
+{
+  size_t amount = inflator->storedleft;
+  if(amount > target - inflator->pos) amount = target - inflator->pos;
+  if(inflator->keepinput)
+  {
+    // copy what has arrived so far, the rest of the block follows later
+    size_t available = BitReader_available(&inflator->reader) + inflator->reader.bitcount / 8;
+    if(amount > available) amount = available;
+  }
+  CERROR_TRY_RETURN(inflateReserve(inflator->out, inflator->pos + amount, inflator->fixedsize));
+
+  // read the literal data: the bytes are now stored in the out buffer
+  if(!BitReader_readBytes(&inflator->reader, inflator->out->data + inflator->pos, amount))
+  {
+    return 23; // error: reading outside of in buffer
+  }
+  inflator->pos += amount;
+  inflator->storedleft -= amount;
+  if(inflator->storedleft == 0) inflator->inblock = 0;
+  return 0;
+}
 
-  while(!error) // decode all symbols until end reached, breaks at end code
+// decodes the symbols of a block with dynamic of fixed Huffman tree, until there are target bytes of output
+static unsigned inflateHuffmanData(Inflator* inflator, size_t target)
+{
+  unsigned error = 0;
+  BitReader* reader = &inflator->reader;
+  ucvector* out = inflator->out;
+  const HuffmanTree* tree_ll = &inflator->tree_ll;
+  const HuffmanTree* tree_d = &inflator->tree_d;
+  unsigned fixedsize = inflator->fixedsize;
+  size_t keepinput = inflator->keepinput;
+  size_t pos = inflator->pos;
+
+  while(pos < target) // decode symbols until the end code, or until there is enough output
   {
+    /*Fast loop, without bounds checks, as long as the output has room for the longest match
+    and at least 8 bytes of input are left. The refill then loads at least 56 bits of actual
+    input, enough for a length code, a distance code and their extra bits.*/
+    unsigned char* data = out->data;
+    size_t fastend = out->allocsize > INFLATE_FAST_MARGIN ? out->allocsize - INFLATE_FAST_MARGIN : 0;
+    if(fastend > target) fastend = target;
+    // with keepinput, also stop where only keepinput bytes are left in this span and the later ones
+    ptrdiff_t fastinput = 8;
+    if(keepinput > reader->later && (ptrdiff_t)(keepinput - reader->later) > fastinput)
+    {
+      fastinput = (ptrdiff_t)(keepinput - reader->later);
+    }
+    while(pos < fastend && reader->end - reader->next >= fastinput)
+    {
+      BitReader_refill(reader);
+      unsigned code_ll = huffmanDecodeSymbolBuffered(reader, tree_ll);
+      if(code_ll <= 255) // literal symbol
+      {
+        data[pos++] = (unsigned char)code_ll;
+        continue;
+      }
+      if(code_ll < FIRST_LENGTH_CODE_INDEX || code_ll > LAST_LENGTH_CODE_INDEX)
+      {
+        if(code_ll == 256) inflator->inblock = 0; // end code
+        else error = 11; // code that does not exist in the tree
+        break;
+      }
+      size_t length = LENGTHBASE[code_ll - FIRST_LENGTH_CODE_INDEX];
+      unsigned numextrabits_l = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
+      length += BitReader_peek(reader, numextrabits_l);
+      BitReader_consume(reader, numextrabits_l);
+
+      unsigned code_d = huffmanDecodeSymbolBuffered(reader, tree_d);
+      if(code_d > 29) ERROR_BREAK(18); // error: invalid distance code (30-31 are never used)
+      size_t distance = DISTANCEBASE[code_d];
+      unsigned numextrabits_d = DISTANCEEXTRA[code_d];
+      distance += BitReader_peek(reader, numextrabits_d);
+      BitReader_consume(reader, numextrabits_d);
+
+      if(distance > pos) ERROR_BREAK(52); // too long backward distance
+      inflateCopyMatch(data + pos, distance, length);
+      pos += length;
+    }
+    if(error || !inflator->inblock || pos >= target) break;
+    if(keepinput && BitReader_available(reader) < keepinput) break; // wait for more input
+
+    // near the end of the input or output: decode a single symbol with all checks
+    if(!fixedsize && !ucvector_reserve(out, pos + INFLATE_FAST_MARGIN)) ERROR_BREAK(83 /*alloc fail*/);
+
+    // a length code, its extra bits, a distance code and its extra bits are at most 48 bits,
+    // so after this no more refills are needed for the symbol
+    if(reader->bitcount < 48) BitReader_refill(reader);
+
     // code_ll is literal, length or end code
-    unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
+    unsigned code_ll = huffmanDecodeSymbol(reader, tree_ll);
     if(code_ll <= 255) // literal symbol
     {
-      // ucvector_push_back would do the same, but for some reason the two lines below run 10% faster
-      if(!ucvector_resize(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
-      out->data[*pos] = (unsigned char)code_ll;
-      ++(*pos);
+      error = inflateReserve(out, pos + 1, fixedsize);
+      if(error) break;
+      out->data[pos] = (unsigned char)code_ll;
+      ++pos;
     }
     else if(code_ll >= FIRST_LENGTH_CODE_INDEX && code_ll <= LAST_LENGTH_CODE_INDEX) // length code
     {
@@ -1210,19 +2430,14 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 
       // part 2: get extra bits and add the value of that to length
       numextrabits_l = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
-      if((*bp + numextrabits_l) > inbitlength) ERROR_BREAK(51); // error, bit pointer will jump past memory
-      length += readBitsFromStream(bp, in, numextrabits_l);
+      length += BitReader_peek(reader, numextrabits_l);
+      BitReader_consume(reader, numextrabits_l);
 
       // part 3: get distance code
-      code_d = huffmanDecodeSymbol(in, bp, &tree_d, inbitlength);
+      code_d = huffmanDecodeSymbol(reader, tree_d);
       if(code_d > 29)
       {
-        if(code_d == (unsigned)(-1)) // huffmanDecodeSymbol returns (unsigned)(-1) in case of error
-        {
-          /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
-          (10=no endcode, 11=wrong jump outside of tree)*/
-          error = (*bp) > inlength * 8 ? 10 : 11;
-        }
+        if(code_d == (unsigned)(-1)) error = 10; // end of input memory reached without endcode
         else error = 18; // error: invalid distance code (30-31 are never used)
         break;
       }
@@ -1230,110 +2445,98 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 
       // part 4: get extra bits from distance
       numextrabits_d = DISTANCEEXTRA[code_d];
-      if((*bp + numextrabits_d) > inbitlength) ERROR_BREAK(51); // error, bit pointer will jump past memory
-      distance += readBitsFromStream(bp, in, numextrabits_d);
+      distance += BitReader_peek(reader, numextrabits_d);
+      BitReader_consume(reader, numextrabits_d);
+      if(BitReader_overrun(reader)) ERROR_BREAK(51); // error, bit pointer will jump past memory
 
       // part 5: fill in all the out[n] values based on the length and dist
-      start = (*pos);
+      start = pos;
       if(distance > start) ERROR_BREAK(52); // too long backward distance
       backward = start - distance;
 
-      if(!ucvector_resize(out, (*pos) + length)) ERROR_BREAK(83 /*alloc fail*/);
+      error = inflateReserve(out, pos + length, fixedsize);
+      if(error) break;
       if (distance < length) {
         for(forward = 0; forward < length; ++forward)
         {
-          out->data[(*pos)++] = out->data[backward++];
+          out->data[pos++] = out->data[backward++];
         }
       } else {
-        memcpy(out->data + *pos, out->data + backward, length);
-        *pos += length;
+        memcpy(out->data + pos, out->data + backward, length);
+        pos += length;
       }
     }
     else if(code_ll == 256)
     {
+      inflator->inblock = 0;
       break; // end code, break the loop
     }
     else // if(code == (unsigned)(-1))*/ /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error
     {
       /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
-      (10=no endcode, 11=wrong jump outside of tree)*/
-      error = ((*bp) > inlength * 8) ? 10 : 11;
+      (10=no endcode, 11=code that does not exist in the tree)*/
+      error = code_ll == (unsigned)(-1) ? 10 : 11;
       break;
     }
   }
 
-  HuffmanTree_cleanup(&tree_ll);
-  HuffmanTree_cleanup(&tree_d);
-
-  return error;
-}
-
-static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos, size_t inlength)
-{
-  unsigned LEN, NLEN, n, error = 0;
-
-  // go to first boundary of byte
-  while(((*bp) & 0x7) != 0) ++(*bp);
-  size_t p = (*bp) / 8; // byte position
-
-  // read LEN (2 bytes) and NLEN (2 bytes)
-  if(p + 4 >= inlength) return 52; // error, bit pointer will jump past memory
-  LEN = in[p] + 256u * in[p + 1]; p += 2;
-  NLEN = in[p] + 256u * in[p + 1]; p += 2;
-
-  // check if 16-bit NLEN is really the one's complement of LEN
-  if(LEN + NLEN != 65535) return 21; // error: NLEN is not one's complement of LEN
-
-  if(!ucvector_resize(out, (*pos) + LEN)) return 83; // alloc fail
-
-  // read the literal data: LEN bytes are now stored in the out buffer
-  if(p + LEN > inlength) return 23; // error: reading outside of in buffer
-  for(n = 0; n < LEN; ++n) out->data[(*pos)++] = in[p++];
-
-  (*bp) = p * 8;
-
+  inflator->pos = pos;
   return error;
 }
 
-static unsigned lodepng_inflatev(ucvector* out,
-                                 const unsigned char* in, size_t insize)
+/*Inflates until there are at least target bytes of output, or until the end of the stream. With
+keepinput, it may also stop earlier, when it needs more input, and with stopatblock at the end of
+a block.*/
+static unsigned Inflator_run(Inflator* inflator, size_t target)
 {
-  // bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte)
-  size_t bp = 0;
-  unsigned BFINAL = 0;
-  size_t pos = 0; // byte position in the out buffer
   unsigned error = 0;
-
-  while(!BFINAL)
+  while(!error && !inflator->done && inflator->pos < target)
   {
-    if(bp + 2 >= insize * 8) return 52; // error, bit pointer will jump past memory
-    BFINAL = readBitFromStream(&bp, in);
-    unsigned BTYPE = 1u * readBitFromStream(&bp, in);
-    BTYPE += 2u * readBitFromStream(&bp, in);
-
-    if(BTYPE == 3) return 20; // error: invalid BTYPE
-    else if(BTYPE == 0) error = inflateNoCompression(out, in, &bp, &pos, insize); // no compression
-    else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE); // compression, BTYPE 01 or 10
-
-    if(error) return error;
+    if(inflator->keepinput && BitReader_available(&inflator->reader) < inflator->keepinput) break;
+    if(!inflator->inblock) error = Inflator_startBlock(inflator);
+    else if(inflator->btype == 0) error = inflateStoredData(inflator, target);
+    else error = inflateHuffmanData(inflator, target);
+    if(!error && !inflator->inblock && inflator->final) inflator->done = 1;
+    if(inflator->stopatblock && !inflator->inblock) break;
+  }
+  inflator->out->size = inflator->pos;
+  if(inflator->check_adler32)
+  {
+    // the new output is still in the cache
+    inflator->adler = adler32Update(inflator->adler, inflator->out->data + inflator->adlerpos,
+                                    inflator->pos - inflator->adlerpos);
+    inflator->adlerpos = inflator->pos;
   }
-
   return error;
 }
 
+/*Drops the first amount bytes of output, to make room in a fixed size buffer. The last 32768 bytes
+must be kept, since matches can refer back that far.*/
+static void Inflator_discard(Inflator* inflator, size_t amount)
+{
+  ucvector* out = inflator->out;
+  memmove(out->data, out->data + amount, inflator->pos - amount);
+  inflator->pos -= amount;
+  inflator->adlerpos -= amount;
+  out->size = inflator->pos;
+}
+
 // Inflate a buffer. Inflate is the decompression step of deflate. Out buffer must be freed after use.
 unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize)
 {
   ucvector v;
+  ByteSpan span = {in, insize};
+  Inflator inflator;
   ucvector_init_buffer(&v, *out, *outsize);
-  unsigned error = lodepng_inflatev(&v, in, insize);
+  Inflator_init(&inflator, &span, 1, &v, 0);
+  unsigned error = Inflator_run(&inflator, (size_t)(-1));
+  Inflator_cleanup(&inflator);
   *out = v.data;
   *outsize = v.size;
   return error;
 }
 
-
 //////////////////////////////////////////////////////////////////////////// 
 /// Deflator (Compressor)                                                  / 
 //////////////////////////////////////////////////////////////////////////// 
@@ -1940,8 +3143,12 @@ static unsigned deflateDynamic(ucvector* out, size_t* bp, Hash* hash,
   return error;
 }
 
-static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-                                 const LodePNGCompressSettings* settings)
+/*Compresses in and appends the deflate blocks to out, the last one with BFINAL if final. Otherwise ends
+with an empty block without compression, so that the data after it starts at a byte, like a full flush
+of zlib. Matches don't refer back to data before in, so with a window of zeros as its start, the blocks
+can be decompressed independently of the data before them.*/
+static unsigned deflateBlocks(ucvector* out, const unsigned char* in, size_t insize,
+                              const LodePNGCompressSettings* settings, unsigned final)
 {
   unsigned error = 0;
   size_t i, blocksize, numdeflateblocks;
@@ -1961,19 +3168,34 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
 
   for(i = 0; i != numdeflateblocks && !error; ++i)
   {
-    unsigned final = (i == numdeflateblocks - 1);
     size_t start = i * blocksize;
     size_t end = start + blocksize;
     if(end > insize) end = insize;
 
-    error = deflateDynamic(out, &bp, &hash, in, start, end, settings, final);
+    error = deflateDynamic(out, &bp, &hash, in, start, end, settings, final && i == numdeflateblocks - 1);
   }
 
   hash_cleanup(&hash);
 
+  if(!error && !final)
+  {
+    // empty block without compression: BFINAL 0, BTYPE 00, padding bits to the next byte, LEN 0 and NLEN
+    addBitsToStream(&bp, out, 0, 3);
+    ucvector_push_back(out, 0);
+    ucvector_push_back(out, 0);
+    ucvector_push_back(out, 255);
+    ucvector_push_back(out, 255);
+  }
+
   return error;
 }
 
+static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
+                                 const LodePNGCompressSettings* settings)
+{
+  return deflateBlocks(out, in, insize, settings, 1);
+}
+
 // Compress a buffer with deflate. See RFC 1951. Out buffer must be freed after use.
 unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
@@ -1988,61 +3210,28 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
 }
 
 
-//////////////////////////////////////////////////////////////////////////// 
-/// Adler32                                                                  
-//////////////////////////////////////////////////////////////////////////// 
-
-// Return the adler32 of the bytes data[0..len-1]
-static unsigned adler32(const unsigned char* data, unsigned len)
-{
-    unsigned adler = 1;
-    unsigned s1 = adler & 0xffff;
-    unsigned s2 = (adler >> 16) & 0xffff;
-
-    while (len > 0)
-    {
-        // at least 5550 sums can be done before the sums overflow, saving a lot of module divisions
-        unsigned amount = len > 5552 ? 5552 : len;
-        len -= amount;
-        while (amount > 0)
-        {
-            s1 += (*data++);
-            s2 += s1;
-            --amount;
-        }
-        s1 %= 65521;
-        s2 %= 65521;
-    }
-
-    return (s2 << 16) | s1;
-}
-
 //////////////////////////////////////////////////////////////////////////// 
 /// Zlib                                                                   / 
 //////////////////////////////////////////////////////////////////////////// 
 
-// Decompresses Zlib data. Reallocates the out buffer and appends the data. The
-// data must be according to the zlib specification.
-// Either, *out must be NULL and *outsize must be 0, or, *out must be a valid
-// buffer and *outsize its size in bytes. out must be freed by user after usage.
-unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-                                 size_t insize)
+// reads the 2 byte zlib header that precedes the deflate data. return value is error
+static unsigned readZlibHeader(BitReader* reader)
 {
-  unsigned error = 0;
-
-  if(insize < 2) return 53; // error, size of zlib data too small
   // read information from zlib header
-  if((in[0] * 256 + in[1]) % 31 != 0)
+  unsigned CMF = BitReader_readBits(reader, 8);
+  unsigned FLG = BitReader_readBits(reader, 8);
+  if(BitReader_overrun(reader)) return 53; // error, size of zlib data too small
+  if((CMF * 256 + FLG) % 31 != 0)
   {
     // error: 256 * in[0] + in[1] must be a multiple of 31, the FCHECK value is supposed to be made that way
     return 24;
   }
 
-  unsigned CM = in[0] & 15;
-  unsigned CINFO = (in[0] >> 4) & 15;
-  // FCHECK = in[1] & 31;*/ /*FCHECK is already tested above
-  unsigned FDICT = (in[1] >> 5) & 1;
-  // FLEVEL = (in[1] >> 6) & 3;*/ /*FLEVEL is not used here
+  unsigned CM = CMF & 15;
+  unsigned CINFO = (CMF >> 4) & 15;
+  // FCHECK = FLG & 31;*/ /*FCHECK is already tested above
+  unsigned FDICT = (FLG >> 5) & 1;
+  // FLEVEL = (FLG >> 6) & 3;*/ /*FLEVEL is not used here
 
   if(CM != 8 || CINFO > 7)
   {
@@ -2055,24 +3244,58 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const uns
       "The additional flags shall not specify a preset dictionary."*/
     return 26;
   }
+  return 0;
+}
 
-  error = lodepng_inflate(out, outsize, in + 2, insize - 2);
-  if(error) return error;
+/*Reads the adler32 checksum that follows the deflate data, and compares it with the one the
+inflator computed of its output. Only when the inflator is done. return value is error*/
+static unsigned checkZlibAdler32(Inflator* inflator)
+{
+  unsigned char ADLER32[4];
+  BitReader_alignToByte(&inflator->reader);
+  if(!BitReader_readBytes(&inflator->reader, ADLER32, 4)) return 53; // error, size of zlib data too small
+  if(lodepng_read32bitInt(ADLER32) != inflator->adler) return 58; // error, adler checksum not correct
+  return 0;
+}
 
-  return 0; // no error
+/*Decompresses Zlib data split over the given spans into out, without copying the spans
+together first. See Inflator for fixedsize.*/
+static unsigned lodepng_zlib_decompressv(ucvector* out, const ByteSpan* spans, size_t numspans,
+                                         unsigned fixedsize, const LodePNGDecompressSettings* settings)
+{
+  Inflator inflator;
+  Inflator_init(&inflator, spans, numspans, out, fixedsize);
+  inflator.check_adler32 = settings->check_adler32;
+  unsigned error = readZlibHeader(&inflator.reader);
+  if(!error) error = Inflator_run(&inflator, (size_t)(-1));
+  if(!error && settings->check_adler32) error = checkZlibAdler32(&inflator);
+  Inflator_cleanup(&inflator);
+  return error;
 }
 
-// Compresses data with Zlib. Reallocates the out buffer and appends the data.
-// Zlib adds a small header and trailer around the deflate data.
-// The data is output in the format of the zlib specification.
+// Decompresses Zlib data. Reallocates the out buffer and appends the data. The
+// data must be according to the zlib specification.
 // Either, *out must be NULL and *outsize must be 0, or, *out must be a valid
 // buffer and *outsize its size in bytes. out must be freed by user after usage.
-unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
-                               size_t insize, const LodePNGCompressSettings* settings)
+unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                 size_t insize, const LodePNGDecompressSettings* settings)
+{
+  ucvector v;
+  ucvector_init_buffer(&v, *out, *outsize);
+  ByteSpan span = {in, insize};
+  unsigned error = lodepng_zlib_decompressv(&v, &span, 1, 0, settings);
+  *out = v.data;
+  *outsize = v.size;
+  return error;
+}
+
+/*Compresses data with Zlib and appends it to outv, with ADLER32 the already known adler32 of the
+data as the checksum in the trailer. If bandsize isn't 0, compresses in in bands of that many bytes,
+each of which can be decompressed on its own, see deflateBlocks, and adds the position in the zlib
+data of each band after the first to bands, as 32-bit high and low half.*/
+static unsigned zlibCompress(ucvector* outv, const unsigned char* in, size_t insize, unsigned ADLER32,
+                             size_t bandsize, ucvector* bands, const LodePNGCompressSettings* settings)
 {
-  /*initially, *out must be NULL and outsize 0, if you just give some random *out
-  that's pointing to a non allocated buffer, this'll crash*/
-  ucvector outv;
   size_t i;
   unsigned error;
   unsigned char* deflatedata = 0;
@@ -2086,22 +3309,56 @@ unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsig
   unsigned FCHECK = 31 - CMFFLG % 31;
   CMFFLG += FCHECK;
 
-  // ucvector-controlled version of the output buffer, for dynamic array
-  ucvector_init_buffer(&outv, *out, *outsize);
+  size_t zlibstart = outv->size;
+  ucvector_push_back(outv, (unsigned char)(CMFFLG >> 8));
+  ucvector_push_back(outv, (unsigned char)(CMFFLG & 255));
 
-  ucvector_push_back(&outv, (unsigned char)(CMFFLG >> 8));
-  ucvector_push_back(&outv, (unsigned char)(CMFFLG & 255));
+  if(bandsize != 0)
+  {
+    error = 0;
+    for(size_t start = 0; start < insize && !error; start += bandsize)
+    {
+      size_t size = insize - start < bandsize ? insize - start : bandsize;
+      if(start != 0)
+      {
+        size_t offset = outv->size - zlibstart;
+        lodepng_add32bitInt(bands, (unsigned)((uint64_t)offset >> 32));
+        lodepng_add32bitInt(bands, (unsigned)offset);
+      }
+      error = deflateBlocks(outv, in + start, size, settings, start + size == insize);
+    }
+    if(!error) lodepng_add32bitInt(outv, ADLER32);
+    return error;
+  }
 
   error = lodepng_deflate(&deflatedata, &deflatesize, in, insize, settings);
 
   if(!error)
   {
-    unsigned ADLER32 = adler32(in, (unsigned)insize);
-    for(i = 0; i != deflatesize; ++i) ucvector_push_back(&outv, deflatedata[i]);
+    for(i = 0; i != deflatesize; ++i) ucvector_push_back(outv, deflatedata[i]);
     free(deflatedata);
-    lodepng_add32bitInt(&outv, ADLER32);
+    lodepng_add32bitInt(outv, ADLER32);
   }
 
+  return error;
+}
+
+// Compresses data with Zlib. Reallocates the out buffer and appends the data.
+// Zlib adds a small header and trailer around the deflate data.
+// The data is output in the format of the zlib specification.
+// Either, *out must be NULL and *outsize must be 0, or, *out must be a valid
+// buffer and *outsize its size in bytes. out must be freed by user after usage.
+unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
+                               size_t insize, const LodePNGCompressSettings* settings)
+{
+  /*initially, *out must be NULL and outsize 0, if you just give some random *out
+  that's pointing to a non allocated buffer, this'll crash*/
+  ucvector outv;
+
+  // ucvector-controlled version of the output buffer, for dynamic array
+  ucvector_init_buffer(&outv, *out, *outsize);
+  unsigned error = zlibCompress(&outv, in, insize, adler32(in, insize), 0, 0, settings);
+
   *out = outv.data;
   *outsize = outv.size;
 
@@ -2123,6 +3380,11 @@ void lodepng_compress_settings_init(LodePNGCompressSettings* settings)
   settings->lazymatching = 1;
 }
 
+void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings)
+{
+  settings->check_adler32 = 0;
+}
+
 
 //////////////////////////////////////////////////////////////////////////// 
 //////////////////////////////////////////////////////////////////////////// 
@@ -2131,27 +3393,638 @@ void lodepng_compress_settings_init(LodePNGCompressSettings* settings)
 //////////////////////////////////////////////////////////////////////////// 
 
 
-// compute CRC32 without lookup tables. Polynomial: 0xedb88320
-// From http://create.stephan-brumme.com/crc32/#tableless
-static inline unsigned lodepng_crc32(const void* data, size_t length)
+//////////////////////////////////////////////////////////////////////////// 
+/// CRC32                                                                  / 
+//////////////////////////////////////////////////////////////////////////// 
+
+/*Slice-by-16 tables for CRC32 with polynomial 0xedb88320. CRC32_TABLE[0] is the usual byte-at-a-time
+table, CRC32_TABLE[k] gives the CRC of a byte followed by k zero bytes.*/
+static const unsigned CRC32_TABLE[16][256] = {
+  {0x00000000u, 0x77073096u, 0xee0e612cu, 0x990951bau, 0x076dc419u, 0x706af48fu, 0xe963a535u, 0x9e6495a3u,
+   0x0edb8832u, 0x79dcb8a4u, 0xe0d5e91eu, 0x97d2d988u, 0x09b64c2bu, 0x7eb17cbdu, 0xe7b82d07u, 0x90bf1d91u,
+   0x1db71064u, 0x6ab020f2u, 0xf3b97148u, 0x84be41deu, 0x1adad47du, 0x6ddde4ebu, 0xf4d4b551u, 0x83d385c7u,
+   0x136c9856u, 0x646ba8c0u, 0xfd62f97au, 0x8a65c9ecu, 0x14015c4fu, 0x63066cd9u, 0xfa0f3d63u, 0x8d080df5u,
+   0x3b6e20c8u, 0x4c69105eu, 0xd56041e4u, 0xa2677172u, 0x3c03e4d1u, 0x4b04d447u, 0xd20d85fdu, 0xa50ab56bu,
+   0x35b5a8fau, 0x42b2986cu, 0xdbbbc9d6u, 0xacbcf940u, 0x32d86ce3u, 0x45df5c75u, 0xdcd60dcfu, 0xabd13d59u,
+   0x26d930acu, 0x51de003au, 0xc8d75180u, 0xbfd06116u, 0x21b4f4b5u, 0x56b3c423u, 0xcfba9599u, 0xb8bda50fu,
+   0x2802b89eu, 0x5f058808u, 0xc60cd9b2u, 0xb10be924u, 0x2f6f7c87u, 0x58684c11u, 0xc1611dabu, 0xb6662d3du,
+   0x76dc4190u, 0x01db7106u, 0x98d220bcu, 0xefd5102au, 0x71b18589u, 0x06b6b51fu, 0x9fbfe4a5u, 0xe8b8d433u,
+   0x7807c9a2u, 0x0f00f934u, 0x9609a88eu, 0xe10e9818u, 0x7f6a0dbbu, 0x086d3d2du, 0x91646c97u, 0xe6635c01u,
+   0x6b6b51f4u, 0x1c6c6162u, 0x856530d8u, 0xf262004eu, 0x6c0695edu, 0x1b01a57bu, 0x8208f4c1u, 0xf50fc457u,
+   0x65b0d9c6u, 0x12b7e950u, 0x8bbeb8eau, 0xfcb9887cu, 0x62dd1ddfu, 0x15da2d49u, 0x8cd37cf3u, 0xfbd44c65u,
+   0x4db26158u, 0x3ab551ceu, 0xa3bc0074u, 0xd4bb30e2u, 0x4adfa541u, 0x3dd895d7u, 0xa4d1c46du, 0xd3d6f4fbu,
+   0x4369e96au, 0x346ed9fcu, 0xad678846u, 0xda60b8d0u, 0x44042d73u, 0x33031de5u, 0xaa0a4c5fu, 0xdd0d7cc9u,
+   0x5005713cu, 0x270241aau, 0xbe0b1010u, 0xc90c2086u, 0x5768b525u, 0x206f85b3u, 0xb966d409u, 0xce61e49fu,
+   0x5edef90eu, 0x29d9c998u, 0xb0d09822u, 0xc7d7a8b4u, 0x59b33d17u, 0x2eb40d81u, 0xb7bd5c3bu, 0xc0ba6cadu,
+   0xedb88320u, 0x9abfb3b6u, 0x03b6e20cu, 0x74b1d29au, 0xead54739u, 0x9dd277afu, 0x04db2615u, 0x73dc1683u,
+   0xe3630b12u, 0x94643b84u, 0x0d6d6a3eu, 0x7a6a5aa8u, 0xe40ecf0bu, 0x9309ff9du, 0x0a00ae27u, 0x7d079eb1u,
+   0xf00f9344u, 0x8708a3d2u, 0x1e01f268u, 0x6906c2feu, 0xf762575du, 0x806567cbu, 0x196c3671u, 0x6e6b06e7u,
+   0xfed41b76u, 0x89d32be0u, 0x10da7a5au, 0x67dd4accu, 0xf9b9df6fu, 0x8ebeeff9u, 0x17b7be43u, 0x60b08ed5u,
+   0xd6d6a3e8u, 0xa1d1937eu, 0x38d8c2c4u, 0x4fdff252u, 0xd1bb67f1u, 0xa6bc5767u, 0x3fb506ddu, 0x48b2364bu,
+   0xd80d2bdau, 0xaf0a1b4cu, 0x36034af6u, 0x41047a60u, 0xdf60efc3u, 0xa867df55u, 0x316e8eefu, 0x4669be79u,
+   0xcb61b38cu, 0xbc66831au, 0x256fd2a0u, 0x5268e236u, 0xcc0c7795u, 0xbb0b4703u, 0x220216b9u, 0x5505262fu,
+   0xc5ba3bbeu, 0xb2bd0b28u, 0x2bb45a92u, 0x5cb36a04u, 0xc2d7ffa7u, 0xb5d0cf31u, 0x2cd99e8bu, 0x5bdeae1du,
+   0x9b64c2b0u, 0xec63f226u, 0x756aa39cu, 0x026d930au, 0x9c0906a9u, 0xeb0e363fu, 0x72076785u, 0x05005713u,
+   0x95bf4a82u, 0xe2b87a14u, 0x7bb12baeu, 0x0cb61b38u, 0x92d28e9bu, 0xe5d5be0du, 0x7cdcefb7u, 0x0bdbdf21u,
+   0x86d3d2d4u, 0xf1d4e242u, 0x68ddb3f8u, 0x1fda836eu, 0x81be16cdu, 0xf6b9265bu, 0x6fb077e1u, 0x18b74777u,
+   0x88085ae6u, 0xff0f6a70u, 0x66063bcau, 0x11010b5cu, 0x8f659effu, 0xf862ae69u, 0x616bffd3u, 0x166ccf45u,
+   0xa00ae278u, 0xd70dd2eeu, 0x4e048354u, 0x3903b3c2u, 0xa7672661u, 0xd06016f7u, 0x4969474du, 0x3e6e77dbu,
+   0xaed16a4au, 0xd9d65adcu, 0x40df0b66u, 0x37d83bf0u, 0xa9bcae53u, 0xdebb9ec5u, 0x47b2cf7fu, 0x30b5ffe9u,
+   0xbdbdf21cu, 0xcabac28au, 0x53b39330u, 0x24b4a3a6u, 0xbad03605u, 0xcdd70693u, 0x54de5729u, 0x23d967bfu,
+   0xb3667a2eu, 0xc4614ab8u, 0x5d681b02u, 0x2a6f2b94u, 0xb40bbe37u, 0xc30c8ea1u, 0x5a05df1bu, 0x2d02ef8du},
+  {0x00000000u, 0x191b3141u, 0x32366282u, 0x2b2d53c3u, 0x646cc504u, 0x7d77f445u, 0x565aa786u, 0x4f4196c7u,
+   0xc8d98a08u, 0xd1c2bb49u, 0xfaefe88au, 0xe3f4d9cbu, 0xacb54f0cu, 0xb5ae7e4du, 0x9e832d8eu, 0x87981ccfu,
+   0x4ac21251u, 0x53d92310u, 0x78f470d3u, 0x61ef4192u, 0x2eaed755u, 0x37b5e614u, 0x1c98b5d7u, 0x05838496u,
+   0x821b9859u, 0x9b00a918u, 0xb02dfadbu, 0xa936cb9au, 0xe6775d5du, 0xff6c6c1cu, 0xd4413fdfu, 0xcd5a0e9eu,
+   0x958424a2u, 0x8c9f15e3u, 0xa7b24620u, 0xbea97761u, 0xf1e8e1a6u, 0xe8f3d0e7u, 0xc3de8324u, 0xdac5b265u,
+   0x5d5daeaau, 0x44469febu, 0x6f6bcc28u, 0x7670fd69u, 0x39316baeu, 0x202a5aefu, 0x0b07092cu, 0x121c386du,
+   0xdf4636f3u, 0xc65d07b2u, 0xed705471u, 0xf46b6530u, 0xbb2af3f7u, 0xa231c2b6u, 0x891c9175u, 0x9007a034u,
+   0x179fbcfbu, 0x0e848dbau, 0x25a9de79u, 0x3cb2ef38u, 0x73f379ffu, 0x6ae848beu, 0x41c51b7du, 0x58de2a3cu,
+   0xf0794f05u, 0xe9627e44u, 0xc24f2d87u, 0xdb541cc6u, 0x94158a01u, 0x8d0ebb40u, 0xa623e883u, 0xbf38d9c2u,
+   0x38a0c50du, 0x21bbf44cu, 0x0a96a78fu, 0x138d96ceu, 0x5ccc0009u, 0x45d73148u, 0x6efa628bu, 0x77e153cau,
+   0xbabb5d54u, 0xa3a06c15u, 0x888d3fd6u, 0x91960e97u, 0xded79850u, 0xc7cca911u, 0xece1fad2u, 0xf5facb93u,
+   0x7262d75cu, 0x6b79e61du, 0x4054b5deu, 0x594f849fu, 0x160e1258u, 0x0f152319u, 0x243870dau, 0x3d23419bu,
+   0x65fd6ba7u, 0x7ce65ae6u, 0x57cb0925u, 0x4ed03864u, 0x0191aea3u, 0x188a9fe2u, 0x33a7cc21u, 0x2abcfd60u,
+   0xad24e1afu, 0xb43fd0eeu, 0x9f12832du, 0x8609b26cu, 0xc94824abu, 0xd05315eau, 0xfb7e4629u, 0xe2657768u,
+   0x2f3f79f6u, 0x362448b7u, 0x1d091b74u, 0x04122a35u, 0x4b53bcf2u, 0x52488db3u, 0x7965de70u, 0x607eef31u,
+   0xe7e6f3feu, 0xfefdc2bfu, 0xd5d0917cu, 0xcccba03du, 0x838a36fau, 0x9a9107bbu, 0xb1bc5478u, 0xa8a76539u,
+   0x3b83984bu, 0x2298a90au, 0x09b5fac9u, 0x10aecb88u, 0x5fef5d4fu, 0x46f46c0eu, 0x6dd93fcdu, 0x74c20e8cu,
+   0xf35a1243u, 0xea412302u, 0xc16c70c1u, 0xd8774180u, 0x9736d747u, 0x8e2de606u, 0xa500b5c5u, 0xbc1b8484u,
+   0x71418a1au, 0x685abb5bu, 0x4377e898u, 0x5a6cd9d9u, 0x152d4f1eu, 0x0c367e5fu, 0x271b2d9cu, 0x3e001cddu,
+   0xb9980012u, 0xa0833153u, 0x8bae6290u, 0x92b553d1u, 0xddf4c516u, 0xc4eff457u, 0xefc2a794u, 0xf6d996d5u,
+   0xae07bce9u, 0xb71c8da8u, 0x9c31de6bu, 0x852aef2au, 0xca6b79edu, 0xd37048acu, 0xf85d1b6fu, 0xe1462a2eu,
+   0x66de36e1u, 0x7fc507a0u, 0x54e85463u, 0x4df36522u, 0x02b2f3e5u, 0x1ba9c2a4u, 0x30849167u, 0x299fa026u,
+   0xe4c5aeb8u, 0xfdde9ff9u, 0xd6f3cc3au, 0xcfe8fd7bu, 0x80a96bbcu, 0x99b25afdu, 0xb29f093eu, 0xab84387fu,
+   0x2c1c24b0u, 0x350715f1u, 0x1e2a4632u, 0x07317773u, 0x4870e1b4u, 0x516bd0f5u, 0x7a468336u, 0x635db277u,
+   0xcbfad74eu, 0xd2e1e60fu, 0xf9ccb5ccu, 0xe0d7848du, 0xaf96124au, 0xb68d230bu, 0x9da070c8u, 0x84bb4189u,
+   0x03235d46u, 0x1a386c07u, 0x31153fc4u, 0x280e0e85u, 0x674f9842u, 0x7e54a903u, 0x5579fac0u, 0x4c62cb81u,
+   0x8138c51fu, 0x9823f45eu, 0xb30ea79du, 0xaa1596dcu, 0xe554001bu, 0xfc4f315au, 0xd7626299u, 0xce7953d8u,
+   0x49e14f17u, 0x50fa7e56u, 0x7bd72d95u, 0x62cc1cd4u, 0x2d8d8a13u, 0x3496bb52u, 0x1fbbe891u, 0x06a0d9d0u,
+   0x5e7ef3ecu, 0x4765c2adu, 0x6c48916eu, 0x7553a02fu, 0x3a1236e8u, 0x230907a9u, 0x0824546au, 0x113f652bu,
+   0x96a779e4u, 0x8fbc48a5u, 0xa4911b66u, 0xbd8a2a27u, 0xf2cbbce0u, 0xebd08da1u, 0xc0fdde62u, 0xd9e6ef23u,
+   0x14bce1bdu, 0x0da7d0fcu, 0x268a833fu, 0x3f91b27eu, 0x70d024b9u, 0x69cb15f8u, 0x42e6463bu, 0x5bfd777au,
+   0xdc656bb5u, 0xc57e5af4u, 0xee530937u, 0xf7483876u, 0xb809aeb1u, 0xa1129ff0u, 0x8a3fcc33u, 0x9324fd72u},
+  {0x00000000u, 0x01c26a37u, 0x0384d46eu, 0x0246be59u, 0x0709a8dcu, 0x06cbc2ebu, 0x048d7cb2u, 0x054f1685u,
+   0x0e1351b8u, 0x0fd13b8fu, 0x0d9785d6u, 0x0c55efe1u, 0x091af964u, 0x08d89353u, 0x0a9e2d0au, 0x0b5c473du,
+   0x1c26a370u, 0x1de4c947u, 0x1fa2771eu, 0x1e601d29u, 0x1b2f0bacu, 0x1aed619bu, 0x18abdfc2u, 0x1969b5f5u,
+   0x1235f2c8u, 0x13f798ffu, 0x11b126a6u, 0x10734c91u, 0x153c5a14u, 0x14fe3023u, 0x16b88e7au, 0x177ae44du,
+   0x384d46e0u, 0x398f2cd7u, 0x3bc9928eu, 0x3a0bf8b9u, 0x3f44ee3cu, 0x3e86840bu, 0x3cc03a52u, 0x3d025065u,
+   0x365e1758u, 0x379c7d6fu, 0x35dac336u, 0x3418a901u, 0x3157bf84u, 0x3095d5b3u, 0x32d36beau, 0x331101ddu,
+   0x246be590u, 0x25a98fa7u, 0x27ef31feu, 0x262d5bc9u, 0x23624d4cu, 0x22a0277bu, 0x20e69922u, 0x2124f315u,
+   0x2a78b428u, 0x2bbade1fu, 0x29fc6046u, 0x283e0a71u, 0x2d711cf4u, 0x2cb376c3u, 0x2ef5c89au, 0x2f37a2adu,
+   0x709a8dc0u, 0x7158e7f7u, 0x731e59aeu, 0x72dc3399u, 0x7793251cu, 0x76514f2bu, 0x7417f172u, 0x75d59b45u,
+   0x7e89dc78u, 0x7f4bb64fu, 0x7d0d0816u, 0x7ccf6221u, 0x798074a4u, 0x78421e93u, 0x7a04a0cau, 0x7bc6cafdu,
+   0x6cbc2eb0u, 0x6d7e4487u, 0x6f38fadeu, 0x6efa90e9u, 0x6bb5866cu, 0x6a77ec5bu, 0x68315202u, 0x69f33835u,
+   0x62af7f08u, 0x636d153fu, 0x612bab66u, 0x60e9c151u, 0x65a6d7d4u, 0x6464bde3u, 0x662203bau, 0x67e0698du,
+   0x48d7cb20u, 0x4915a117u, 0x4b531f4eu, 0x4a917579u, 0x4fde63fcu, 0x4e1c09cbu, 0x4c5ab792u, 0x4d98dda5u,
+   0x46c49a98u, 0x4706f0afu, 0x45404ef6u, 0x448224c1u, 0x41cd3244u, 0x400f5873u, 0x4249e62au, 0x438b8c1du,
+   0x54f16850u, 0x55330267u, 0x5775bc3eu, 0x56b7d609u, 0x53f8c08cu, 0x523aaabbu, 0x507c14e2u, 0x51be7ed5u,
+   0x5ae239e8u, 0x5b2053dfu, 0x5966ed86u, 0x58a487b1u, 0x5deb9134u, 0x5c29fb03u, 0x5e6f455au, 0x5fad2f6du,
+   0xe1351b80u, 0xe0f771b7u, 0xe2b1cfeeu, 0xe373a5d9u, 0xe63cb35cu, 0xe7fed96bu, 0xe5b86732u, 0xe47a0d05u,
+   0xef264a38u, 0xeee4200fu, 0xeca29e56u, 0xed60f461u, 0xe82fe2e4u, 0xe9ed88d3u, 0xebab368au, 0xea695cbdu,
+   0xfd13b8f0u, 0xfcd1d2c7u, 0xfe976c9eu, 0xff5506a9u, 0xfa1a102cu, 0xfbd87a1bu, 0xf99ec442u, 0xf85cae75u,
+   0xf300e948u, 0xf2c2837fu, 0xf0843d26u, 0xf1465711u, 0xf4094194u, 0xf5cb2ba3u, 0xf78d95fau, 0xf64fffcdu,
+   0xd9785d60u, 0xd8ba3757u, 0xdafc890eu, 0xdb3ee339u, 0xde71f5bcu, 0xdfb39f8bu, 0xddf521d2u, 0xdc374be5u,
+   0xd76b0cd8u, 0xd6a966efu, 0xd4efd8b6u, 0xd52db281u, 0xd062a404u, 0xd1a0ce33u, 0xd3e6706au, 0xd2241a5du,
+   0xc55efe10u, 0xc49c9427u, 0xc6da2a7eu, 0xc7184049u, 0xc25756ccu, 0xc3953cfbu, 0xc1d382a2u, 0xc011e895u,
+   0xcb4dafa8u, 0xca8fc59fu, 0xc8c97bc6u, 0xc90b11f1u, 0xcc440774u, 0xcd866d43u, 0xcfc0d31au, 0xce02b92du,
+   0x91af9640u, 0x906dfc77u, 0x922b422eu, 0x93e92819u, 0x96a63e9cu, 0x976454abu, 0x9522eaf2u, 0x94e080c5u,
+   0x9fbcc7f8u, 0x9e7eadcfu, 0x9c381396u, 0x9dfa79a1u, 0x98b56f24u, 0x99770513u, 0x9b31bb4au, 0x9af3d17du,
+   0x8d893530u, 0x8c4b5f07u, 0x8e0de15eu, 0x8fcf8b69u, 0x8a809decu, 0x8b42f7dbu, 0x89044982u, 0x88c623b5u,
+   0x839a6488u, 0x82580ebfu, 0x801eb0e6u, 0x81dcdad1u, 0x8493cc54u, 0x8551a663u, 0x8717183au, 0x86d5720du,
+   0xa9e2d0a0u, 0xa820ba97u, 0xaa6604ceu, 0xaba46ef9u, 0xaeeb787cu, 0xaf29124bu, 0xad6fac12u, 0xacadc625u,
+   0xa7f18118u, 0xa633eb2fu, 0xa4755576u, 0xa5b73f41u, 0xa0f829c4u, 0xa13a43f3u, 0xa37cfdaau, 0xa2be979du,
+   0xb5c473d0u, 0xb40619e7u, 0xb640a7beu, 0xb782cd89u, 0xb2cddb0cu, 0xb30fb13bu, 0xb1490f62u, 0xb08b6555u,
+   0xbbd72268u, 0xba15485fu, 0xb853f606u, 0xb9919c31u, 0xbcde8ab4u, 0xbd1ce083u, 0xbf5a5edau, 0xbe9834edu},
+  {0x00000000u, 0xb8bc6765u, 0xaa09c88bu, 0x12b5afeeu, 0x8f629757u, 0x37def032u, 0x256b5fdcu, 0x9dd738b9u,
+   0xc5b428efu, 0x7d084f8au, 0x6fbde064u, 0xd7018701u, 0x4ad6bfb8u, 0xf26ad8ddu, 0xe0df7733u, 0x58631056u,
+   0x5019579fu, 0xe8a530fau, 0xfa109f14u, 0x42acf871u, 0xdf7bc0c8u, 0x67c7a7adu, 0x75720843u, 0xcdce6f26u,
+   0x95ad7f70u, 0x2d111815u, 0x3fa4b7fbu, 0x8718d09eu, 0x1acfe827u, 0xa2738f42u, 0xb0c620acu, 0x087a47c9u,
+   0xa032af3eu, 0x188ec85bu, 0x0a3b67b5u, 0xb28700d0u, 0x2f503869u, 0x97ec5f0cu, 0x8559f0e2u, 0x3de59787u,
+   0x658687d1u, 0xdd3ae0b4u, 0xcf8f4f5au, 0x7733283fu, 0xeae41086u, 0x525877e3u, 0x40edd80du, 0xf851bf68u,
+   0xf02bf8a1u, 0x48979fc4u, 0x5a22302au, 0xe29e574fu, 0x7f496ff6u, 0xc7f50893u, 0xd540a77du, 0x6dfcc018u,
+   0x359fd04eu, 0x8d23b72bu, 0x9f9618c5u, 0x272a7fa0u, 0xbafd4719u, 0x0241207cu, 0x10f48f92u, 0xa848e8f7u,
+   0x9b14583du, 0x23a83f58u, 0x311d90b6u, 0x89a1f7d3u, 0x1476cf6au, 0xaccaa80fu, 0xbe7f07e1u, 0x06c36084u,
+   0x5ea070d2u, 0xe61c17b7u, 0xf4a9b859u, 0x4c15df3cu, 0xd1c2e785u, 0x697e80e0u, 0x7bcb2f0eu, 0xc377486bu,
+   0xcb0d0fa2u, 0x73b168c7u, 0x6104c729u, 0xd9b8a04cu, 0x446f98f5u, 0xfcd3ff90u, 0xee66507eu, 0x56da371bu,
+   0x0eb9274du, 0xb6054028u, 0xa4b0efc6u, 0x1c0c88a3u, 0x81dbb01au, 0x3967d77fu, 0x2bd27891u, 0x936e1ff4u,
+   0x3b26f703u, 0x839a9066u, 0x912f3f88u, 0x299358edu, 0xb4446054u, 0x0cf80731u, 0x1e4da8dfu, 0xa6f1cfbau,
+   0xfe92dfecu, 0x462eb889u, 0x549b1767u, 0xec277002u, 0x71f048bbu, 0xc94c2fdeu, 0xdbf98030u, 0x6345e755u,
+   0x6b3fa09cu, 0xd383c7f9u, 0xc1366817u, 0x798a0f72u, 0xe45d37cbu, 0x5ce150aeu, 0x4e54ff40u, 0xf6e89825u,
+   0xae8b8873u, 0x1637ef16u, 0x048240f8u, 0xbc3e279du, 0x21e91f24u, 0x99557841u, 0x8be0d7afu, 0x335cb0cau,
+   0xed59b63bu, 0x55e5d15eu, 0x47507eb0u, 0xffec19d5u, 0x623b216cu, 0xda874609u, 0xc832e9e7u, 0x708e8e82u,
+   0x28ed9ed4u, 0x9051f9b1u, 0x82e4565fu, 0x3a58313au, 0xa78f0983u, 0x1f336ee6u, 0x0d86c108u, 0xb53aa66du,
+   0xbd40e1a4u, 0x05fc86c1u, 0x1749292fu, 0xaff54e4au, 0x322276f3u, 0x8a9e1196u, 0x982bbe78u, 0x2097d91du,
+   0x78f4c94bu, 0xc048ae2eu, 0xd2fd01c0u, 0x6a4166a5u, 0xf7965e1cu, 0x4f2a3979u, 0x5d9f9697u, 0xe523f1f2u,
+   0x4d6b1905u, 0xf5d77e60u, 0xe762d18eu, 0x5fdeb6ebu, 0xc2098e52u, 0x7ab5e937u, 0x680046d9u, 0xd0bc21bcu,
+   0x88df31eau, 0x3063568fu, 0x22d6f961u, 0x9a6a9e04u, 0x07bda6bdu, 0xbf01c1d8u, 0xadb46e36u, 0x15080953u,
+   0x1d724e9au, 0xa5ce29ffu, 0xb77b8611u, 0x0fc7e174u, 0x9210d9cdu, 0x2aacbea8u, 0x38191146u, 0x80a57623u,
+   0xd8c66675u, 0x607a0110u, 0x72cfaefeu, 0xca73c99bu, 0x57a4f122u, 0xef189647u, 0xfdad39a9u, 0x45115eccu,
+   0x764dee06u, 0xcef18963u, 0xdc44268du, 0x64f841e8u, 0xf92f7951u, 0x41931e34u, 0x5326b1dau, 0xeb9ad6bfu,
+   0xb3f9c6e9u, 0x0b45a18cu, 0x19f00e62u, 0xa14c6907u, 0x3c9b51beu, 0x842736dbu, 0x96929935u, 0x2e2efe50u,
+   0x2654b999u, 0x9ee8defcu, 0x8c5d7112u, 0x34e11677u, 0xa9362eceu, 0x118a49abu, 0x033fe645u, 0xbb838120u,
+   0xe3e09176u, 0x5b5cf613u, 0x49e959fdu, 0xf1553e98u, 0x6c820621u, 0xd43e6144u, 0xc68bceaau, 0x7e37a9cfu,
+   0xd67f4138u, 0x6ec3265du, 0x7c7689b3u, 0xc4caeed6u, 0x591dd66fu, 0xe1a1b10au, 0xf3141ee4u, 0x4ba87981u,
+   0x13cb69d7u, 0xab770eb2u, 0xb9c2a15cu, 0x017ec639u, 0x9ca9fe80u, 0x241599e5u, 0x36a0360bu, 0x8e1c516eu,
+   0x866616a7u, 0x3eda71c2u, 0x2c6fde2cu, 0x94d3b949u, 0x090481f0u, 0xb1b8e695u, 0xa30d497bu, 0x1bb12e1eu,
+   0x43d23e48u, 0xfb6e592du, 0xe9dbf6c3u, 0x516791a6u, 0xccb0a91fu, 0x740cce7au, 0x66b96194u, 0xde0506f1u},
+  {0x00000000u, 0x3d6029b0u, 0x7ac05360u, 0x47a07ad0u, 0xf580a6c0u, 0xc8e08f70u, 0x8f40f5a0u, 0xb220dc10u,
+   0x30704bc1u, 0x0d106271u, 0x4ab018a1u, 0x77d03111u, 0xc5f0ed01u, 0xf890c4b1u, 0xbf30be61u, 0x825097d1u,
+   0x60e09782u, 0x5d80be32u, 0x1a20c4e2u, 0x2740ed52u, 0x95603142u, 0xa80018f2u, 0xefa06222u, 0xd2c04b92u,
+   0x5090dc43u, 0x6df0f5f3u, 0x2a508f23u, 0x1730a693u, 0xa5107a83u, 0x98705333u, 0xdfd029e3u, 0xe2b00053u,
+   0xc1c12f04u, 0xfca106b4u, 0xbb017c64u, 0x866155d4u, 0x344189c4u, 0x0921a074u, 0x4e81daa4u, 0x73e1f314u,
+   0xf1b164c5u, 0xccd14d75u, 0x8b7137a5u, 0xb6111e15u, 0x0431c205u, 0x3951ebb5u, 0x7ef19165u, 0x4391b8d5u,
+   0xa121b886u, 0x9c419136u, 0xdbe1ebe6u, 0xe681c256u, 0x54a11e46u, 0x69c137f6u, 0x2e614d26u, 0x13016496u,
+   0x9151f347u, 0xac31daf7u, 0xeb91a027u, 0xd6f18997u, 0x64d15587u, 0x59b17c37u, 0x1e1106e7u, 0x23712f57u,
+   0x58f35849u, 0x659371f9u, 0x22330b29u, 0x1f532299u, 0xad73fe89u, 0x9013d739u, 0xd7b3ade9u, 0xead38459u,
+   0x68831388u, 0x55e33a38u, 0x124340e8u, 0x2f236958u, 0x9d03b548u, 0xa0639cf8u, 0xe7c3e628u, 0xdaa3cf98u,
+   0x3813cfcbu, 0x0573e67bu, 0x42d39cabu, 0x7fb3b51bu, 0xcd93690bu, 0xf0f340bbu, 0xb7533a6bu, 0x8a3313dbu,
+   0x0863840au, 0x3503adbau, 0x72a3d76au, 0x4fc3fedau, 0xfde322cau, 0xc0830b7au, 0x872371aau, 0xba43581au,
+   0x9932774du, 0xa4525efdu, 0xe3f2242du, 0xde920d9du, 0x6cb2d18du, 0x51d2f83du, 0x167282edu, 0x2b12ab5du,
+   0xa9423c8cu, 0x9422153cu, 0xd3826fecu, 0xeee2465cu, 0x5cc29a4cu, 0x61a2b3fcu, 0x2602c92cu, 0x1b62e09cu,
+   0xf9d2e0cfu, 0xc4b2c97fu, 0x8312b3afu, 0xbe729a1fu, 0x0c52460fu, 0x31326fbfu, 0x7692156fu, 0x4bf23cdfu,
+   0xc9a2ab0eu, 0xf4c282beu, 0xb362f86eu, 0x8e02d1deu, 0x3c220dceu, 0x0142247eu, 0x46e25eaeu, 0x7b82771eu,
+   0xb1e6b092u, 0x8c869922u, 0xcb26e3f2u, 0xf646ca42u, 0x44661652u, 0x79063fe2u, 0x3ea64532u, 0x03c66c82u,
+   0x8196fb53u, 0xbcf6d2e3u, 0xfb56a833u, 0xc6368183u, 0x74165d93u, 0x49767423u, 0x0ed60ef3u, 0x33b62743u,
+   0xd1062710u, 0xec660ea0u, 0xabc67470u, 0x96a65dc0u, 0x248681d0u, 0x19e6a860u, 0x5e46d2b0u, 0x6326fb00u,
+   0xe1766cd1u, 0xdc164561u, 0x9bb63fb1u, 0xa6d61601u, 0x14f6ca11u, 0x2996e3a1u, 0x6e369971u, 0x5356b0c1u,
+   0x70279f96u, 0x4d47b626u, 0x0ae7ccf6u, 0x3787e546u, 0x85a73956u, 0xb8c710e6u, 0xff676a36u, 0xc2074386u,
+   0x4057d457u, 0x7d37fde7u, 0x3a978737u, 0x07f7ae87u, 0xb5d77297u, 0x88b75b27u, 0xcf1721f7u, 0xf2770847u,
+   0x10c70814u, 0x2da721a4u, 0x6a075b74u, 0x576772c4u, 0xe547aed4u, 0xd8278764u, 0x9f87fdb4u, 0xa2e7d404u,
+   0x20b743d5u, 0x1dd76a65u, 0x5a7710b5u, 0x67173905u, 0xd537e515u, 0xe857cca5u, 0xaff7b675u, 0x92979fc5u,
+   0xe915e8dbu, 0xd475c16bu, 0x93d5bbbbu, 0xaeb5920bu, 0x1c954e1bu, 0x21f567abu, 0x66551d7bu, 0x5b3534cbu,
+   0xd965a31au, 0xe4058aaau, 0xa3a5f07au, 0x9ec5d9cau, 0x2ce505dau, 0x11852c6au, 0x562556bau, 0x6b457f0au,
+   0x89f57f59u, 0xb49556e9u, 0xf3352c39u, 0xce550589u, 0x7c75d999u, 0x4115f029u, 0x06b58af9u, 0x3bd5a349u,
+   0xb9853498u, 0x84e51d28u, 0xc34567f8u, 0xfe254e48u, 0x4c059258u, 0x7165bbe8u, 0x36c5c138u, 0x0ba5e888u,
+   0x28d4c7dfu, 0x15b4ee6fu, 0x521494bfu, 0x6f74bd0fu, 0xdd54611fu, 0xe03448afu, 0xa794327fu, 0x9af41bcfu,
+   0x18a48c1eu, 0x25c4a5aeu, 0x6264df7eu, 0x5f04f6ceu, 0xed242adeu, 0xd044036eu, 0x97e479beu, 0xaa84500eu,
+   0x4834505du, 0x755479edu, 0x32f4033du, 0x0f942a8du, 0xbdb4f69du, 0x80d4df2du, 0xc774a5fdu, 0xfa148c4du,
+   0x78441b9cu, 0x4524322cu, 0x028448fcu, 0x3fe4614cu, 0x8dc4bd5cu, 0xb0a494ecu, 0xf704ee3cu, 0xca64c78cu},
+  {0x00000000u, 0xcb5cd3a5u, 0x4dc8a10bu, 0x869472aeu, 0x9b914216u, 0x50cd91b3u, 0xd659e31du, 0x1d0530b8u,
+   0xec53826du, 0x270f51c8u, 0xa19b2366u, 0x6ac7f0c3u, 0x77c2c07bu, 0xbc9e13deu, 0x3a0a6170u, 0xf156b2d5u,
+   0x03d6029bu, 0xc88ad13eu, 0x4e1ea390u, 0x85427035u, 0x9847408du, 0x531b9328u, 0xd58fe186u, 0x1ed33223u,
+   0xef8580f6u, 0x24d95353u, 0xa24d21fdu, 0x6911f258u, 0x7414c2e0u, 0xbf481145u, 0x39dc63ebu, 0xf280b04eu,
+   0x07ac0536u, 0xccf0d693u, 0x4a64a43du, 0x81387798u, 0x9c3d4720u, 0x57619485u, 0xd1f5e62bu, 0x1aa9358eu,
+   0xebff875bu, 0x20a354feu, 0xa6372650u, 0x6d6bf5f5u, 0x706ec54du, 0xbb3216e8u, 0x3da66446u, 0xf6fab7e3u,
+   0x047a07adu, 0xcf26d408u, 0x49b2a6a6u, 0x82ee7503u, 0x9feb45bbu, 0x54b7961eu, 0xd223e4b0u, 0x197f3715u,
+   0xe82985c0u, 0x23755665u, 0xa5e124cbu, 0x6ebdf76eu, 0x73b8c7d6u, 0xb8e41473u, 0x3e7066ddu, 0xf52cb578u,
+   0x0f580a6cu, 0xc404d9c9u, 0x4290ab67u, 0x89cc78c2u, 0x94c9487au, 0x5f959bdfu, 0xd901e971u, 0x125d3ad4u,
+   0xe30b8801u, 0x28575ba4u, 0xaec3290au, 0x659ffaafu, 0x789aca17u, 0xb3c619b2u, 0x35526b1cu, 0xfe0eb8b9u,
+   0x0c8e08f7u, 0xc7d2db52u, 0x4146a9fcu, 0x8a1a7a59u, 0x971f4ae1u, 0x5c439944u, 0xdad7ebeau, 0x118b384fu,
+   0xe0dd8a9au, 0x2b81593fu, 0xad152b91u, 0x6649f834u, 0x7b4cc88cu, 0xb0101b29u, 0x36846987u, 0xfdd8ba22u,
+   0x08f40f5au, 0xc3a8dcffu, 0x453cae51u, 0x8e607df4u, 0x93654d4cu, 0x58399ee9u, 0xdeadec47u, 0x15f13fe2u,
+   0xe4a78d37u, 0x2ffb5e92u, 0xa96f2c3cu, 0x6233ff99u, 0x7f36cf21u, 0xb46a1c84u, 0x32fe6e2au, 0xf9a2bd8fu,
+   0x0b220dc1u, 0xc07ede64u, 0x46eaaccau, 0x8db67f6fu, 0x90b34fd7u, 0x5bef9c72u, 0xdd7beedcu, 0x16273d79u,
+   0xe7718facu, 0x2c2d5c09u, 0xaab92ea7u, 0x61e5fd02u, 0x7ce0cdbau, 0xb7bc1e1fu, 0x31286cb1u, 0xfa74bf14u,
+   0x1eb014d8u, 0xd5ecc77du, 0x5378b5d3u, 0x98246676u, 0x852156ceu, 0x4e7d856bu, 0xc8e9f7c5u, 0x03b52460u,
+   0xf2e396b5u, 0x39bf4510u, 0xbf2b37beu, 0x7477e41bu, 0x6972d4a3u, 0xa22e0706u, 0x24ba75a8u, 0xefe6a60du,
+   0x1d661643u, 0xd63ac5e6u, 0x50aeb748u, 0x9bf264edu, 0x86f75455u, 0x4dab87f0u, 0xcb3ff55eu, 0x006326fbu,
+   0xf135942eu, 0x3a69478bu, 0xbcfd3525u, 0x77a1e680u, 0x6aa4d638u, 0xa1f8059du, 0x276c7733u, 0xec30a496u,
+   0x191c11eeu, 0xd240c24bu, 0x54d4b0e5u, 0x9f886340u, 0x828d53f8u, 0x49d1805du, 0xcf45f2f3u, 0x04192156u,
+   0xf54f9383u, 0x3e134026u, 0xb8873288u, 0x73dbe12du, 0x6eded195u, 0xa5820230u, 0x2316709eu, 0xe84aa33bu,
+   0x1aca1375u, 0xd196c0d0u, 0x5702b27eu, 0x9c5e61dbu, 0x815b5163u, 0x4a0782c6u, 0xcc93f068u, 0x07cf23cdu,
+   0xf6999118u, 0x3dc542bdu, 0xbb513013u, 0x700de3b6u, 0x6d08d30eu, 0xa65400abu, 0x20c07205u, 0xeb9ca1a0u,
+   0x11e81eb4u, 0xdab4cd11u, 0x5c20bfbfu, 0x977c6c1au, 0x8a795ca2u, 0x41258f07u, 0xc7b1fda9u, 0x0ced2e0cu,
+   0xfdbb9cd9u, 0x36e74f7cu, 0xb0733dd2u, 0x7b2fee77u, 0x662adecfu, 0xad760d6au, 0x2be27fc4u, 0xe0beac61u,
+   0x123e1c2fu, 0xd962cf8au, 0x5ff6bd24u, 0x94aa6e81u, 0x89af5e39u, 0x42f38d9cu, 0xc467ff32u, 0x0f3b2c97u,
+   0xfe6d9e42u, 0x35314de7u, 0xb3a53f49u, 0x78f9ececu, 0x65fcdc54u, 0xaea00ff1u, 0x28347d5fu, 0xe368aefau,
+   0x16441b82u, 0xdd18c827u, 0x5b8cba89u, 0x90d0692cu, 0x8dd55994u, 0x46898a31u, 0xc01df89fu, 0x0b412b3au,
+   0xfa1799efu, 0x314b4a4au, 0xb7df38e4u, 0x7c83eb41u, 0x6186dbf9u, 0xaada085cu, 0x2c4e7af2u, 0xe712a957u,
+   0x15921919u, 0xdececabcu, 0x585ab812u, 0x93066bb7u, 0x8e035b0fu, 0x455f88aau, 0xc3cbfa04u, 0x089729a1u,
+   0xf9c19b74u, 0x329d48d1u, 0xb4093a7fu, 0x7f55e9dau, 0x6250d962u, 0xa90c0ac7u, 0x2f987869u, 0xe4c4abccu},
+  {0x00000000u, 0xa6770bb4u, 0x979f1129u, 0x31e81a9du, 0xf44f2413u, 0x52382fa7u, 0x63d0353au, 0xc5a73e8eu,
+   0x33ef4e67u, 0x959845d3u, 0xa4705f4eu, 0x020754fau, 0xc7a06a74u, 0x61d761c0u, 0x503f7b5du, 0xf64870e9u,
+   0x67de9cceu, 0xc1a9977au, 0xf0418de7u, 0x56368653u, 0x9391b8ddu, 0x35e6b369u, 0x040ea9f4u, 0xa279a240u,
+   0x5431d2a9u, 0xf246d91du, 0xc3aec380u, 0x65d9c834u, 0xa07ef6bau, 0x0609fd0eu, 0x37e1e793u, 0x9196ec27u,
+   0xcfbd399cu, 0x69ca3228u, 0x582228b5u, 0xfe552301u, 0x3bf21d8fu, 0x9d85163bu, 0xac6d0ca6u, 0x0a1a0712u,
+   0xfc5277fbu, 0x5a257c4fu, 0x6bcd66d2u, 0xcdba6d66u, 0x081d53e8u, 0xae6a585cu, 0x9f8242c1u, 0x39f54975u,
+   0xa863a552u, 0x0e14aee6u, 0x3ffcb47bu, 0x998bbfcfu, 0x5c2c8141u, 0xfa5b8af5u, 0xcbb39068u, 0x6dc49bdcu,
+   0x9b8ceb35u, 0x3dfbe081u, 0x0c13fa1cu, 0xaa64f1a8u, 0x6fc3cf26u, 0xc9b4c492u, 0xf85cde0fu, 0x5e2bd5bbu,
+   0x440b7579u, 0xe27c7ecdu, 0xd3946450u, 0x75e36fe4u, 0xb044516au, 0x16335adeu, 0x27db4043u, 0x81ac4bf7u,
+   0x77e43b1eu, 0xd19330aau, 0xe07b2a37u, 0x460c2183u, 0x83ab1f0du, 0x25dc14b9u, 0x14340e24u, 0xb2430590u,
+   0x23d5e9b7u, 0x85a2e203u, 0xb44af89eu, 0x123df32au, 0xd79acda4u, 0x71edc610u, 0x4005dc8du, 0xe672d739u,
+   0x103aa7d0u, 0xb64dac64u, 0x87a5b6f9u, 0x21d2bd4du, 0xe47583c3u, 0x42028877u, 0x73ea92eau, 0xd59d995eu,
+   0x8bb64ce5u, 0x2dc14751u, 0x1c295dccu, 0xba5e5678u, 0x7ff968f6u, 0xd98e6342u, 0xe86679dfu, 0x4e11726bu,
+   0xb8590282u, 0x1e2e0936u, 0x2fc613abu, 0x89b1181fu, 0x4c162691u, 0xea612d25u, 0xdb8937b8u, 0x7dfe3c0cu,
+   0xec68d02bu, 0x4a1fdb9fu, 0x7bf7c102u, 0xdd80cab6u, 0x1827f438u, 0xbe50ff8cu, 0x8fb8e511u, 0x29cfeea5u,
+   0xdf879e4cu, 0x79f095f8u, 0x48188f65u, 0xee6f84d1u, 0x2bc8ba5fu, 0x8dbfb1ebu, 0xbc57ab76u, 0x1a20a0c2u,
+   0x8816eaf2u, 0x2e61e146u, 0x1f89fbdbu, 0xb9fef06fu, 0x7c59cee1u, 0xda2ec555u, 0xebc6dfc8u, 0x4db1d47cu,
+   0xbbf9a495u, 0x1d8eaf21u, 0x2c66b5bcu, 0x8a11be08u, 0x4fb68086u, 0xe9c18b32u, 0xd82991afu, 0x7e5e9a1bu,
+   0xefc8763cu, 0x49bf7d88u, 0x78576715u, 0xde206ca1u, 0x1b87522fu, 0xbdf0599bu, 0x8c184306u, 0x2a6f48b2u,
+   0xdc27385bu, 0x7a5033efu, 0x4bb82972u, 0xedcf22c6u, 0x28681c48u, 0x8e1f17fcu, 0xbff70d61u, 0x198006d5u,
+   0x47abd36eu, 0xe1dcd8dau, 0xd034c247u, 0x7643c9f3u, 0xb3e4f77du, 0x1593fcc9u, 0x247be654u, 0x820cede0u,
+   0x74449d09u, 0xd23396bdu, 0xe3db8c20u, 0x45ac8794u, 0x800bb91au, 0x267cb2aeu, 0x1794a833u, 0xb1e3a387u,
+   0x20754fa0u, 0x86024414u, 0xb7ea5e89u, 0x119d553du, 0xd43a6bb3u, 0x724d6007u, 0x43a57a9au, 0xe5d2712eu,
+   0x139a01c7u, 0xb5ed0a73u, 0x840510eeu, 0x22721b5au, 0xe7d525d4u, 0x41a22e60u, 0x704a34fdu, 0xd63d3f49u,
+   0xcc1d9f8bu, 0x6a6a943fu, 0x5b828ea2u, 0xfdf58516u, 0x3852bb98u, 0x9e25b02cu, 0xafcdaab1u, 0x09baa105u,
+   0xfff2d1ecu, 0x5985da58u, 0x686dc0c5u, 0xce1acb71u, 0x0bbdf5ffu, 0xadcafe4bu, 0x9c22e4d6u, 0x3a55ef62u,
+   0xabc30345u, 0x0db408f1u, 0x3c5c126cu, 0x9a2b19d8u, 0x5f8c2756u, 0xf9fb2ce2u, 0xc813367fu, 0x6e643dcbu,
+   0x982c4d22u, 0x3e5b4696u, 0x0fb35c0bu, 0xa9c457bfu, 0x6c636931u, 0xca146285u, 0xfbfc7818u, 0x5d8b73acu,
+   0x03a0a617u, 0xa5d7ada3u, 0x943fb73eu, 0x3248bc8au, 0xf7ef8204u, 0x519889b0u, 0x6070932du, 0xc6079899u,
+   0x304fe870u, 0x9638e3c4u, 0xa7d0f959u, 0x01a7f2edu, 0xc400cc63u, 0x6277c7d7u, 0x539fdd4au, 0xf5e8d6feu,
+   0x647e3ad9u, 0xc209316du, 0xf3e12bf0u, 0x55962044u, 0x90311ecau, 0x3646157eu, 0x07ae0fe3u, 0xa1d90457u,
+   0x579174beu, 0xf1e67f0au, 0xc00e6597u, 0x66796e23u, 0xa3de50adu, 0x05a95b19u, 0x34414184u, 0x92364a30u},
+  {0x00000000u, 0xccaa009eu, 0x4225077du, 0x8e8f07e3u, 0x844a0efau, 0x48e00e64u, 0xc66f0987u, 0x0ac50919u,
+   0xd3e51bb5u, 0x1f4f1b2bu, 0x91c01cc8u, 0x5d6a1c56u, 0x57af154fu, 0x9b0515d1u, 0x158a1232u, 0xd92012acu,
+   0x7cbb312bu, 0xb01131b5u, 0x3e9e3656u, 0xf23436c8u, 0xf8f13fd1u, 0x345b3f4fu, 0xbad438acu, 0x767e3832u,
+   0xaf5e2a9eu, 0x63f42a00u, 0xed7b2de3u, 0x21d12d7du, 0x2b142464u, 0xe7be24fau, 0x69312319u, 0xa59b2387u,
+   0xf9766256u, 0x35dc62c8u, 0xbb53652bu, 0x77f965b5u, 0x7d3c6cacu, 0xb1966c32u, 0x3f196bd1u, 0xf3b36b4fu,
+   0x2a9379e3u, 0xe639797du, 0x68b67e9eu, 0xa41c7e00u, 0xaed97719u, 0x62737787u, 0xecfc7064u, 0x205670fau,
+   0x85cd537du, 0x496753e3u, 0xc7e85400u, 0x0b42549eu, 0x01875d87u, 0xcd2d5d19u, 0x43a25afau, 0x8f085a64u,
+   0x562848c8u, 0x9a824856u, 0x140d4fb5u, 0xd8a74f2bu, 0xd2624632u, 0x1ec846acu, 0x9047414fu, 0x5ced41d1u,
+   0x299dc2edu, 0xe537c273u, 0x6bb8c590u, 0xa712c50eu, 0xadd7cc17u, 0x617dcc89u, 0xeff2cb6au, 0x2358cbf4u,
+   0xfa78d958u, 0x36d2d9c6u, 0xb85dde25u, 0x74f7debbu, 0x7e32d7a2u, 0xb298d73cu, 0x3c17d0dfu, 0xf0bdd041u,
+   0x5526f3c6u, 0x998cf358u, 0x1703f4bbu, 0xdba9f425u, 0xd16cfd3cu, 0x1dc6fda2u, 0x9349fa41u, 0x5fe3fadfu,
+   0x86c3e873u, 0x4a69e8edu, 0xc4e6ef0eu, 0x084cef90u, 0x0289e689u, 0xce23e617u, 0x40ace1f4u, 0x8c06e16au,
+   0xd0eba0bbu, 0x1c41a025u, 0x92cea7c6u, 0x5e64a758u, 0x54a1ae41u, 0x980baedfu, 0x1684a93cu, 0xda2ea9a2u,
+   0x030ebb0eu, 0xcfa4bb90u, 0x412bbc73u, 0x8d81bcedu, 0x8744b5f4u, 0x4beeb56au, 0xc561b289u, 0x09cbb217u,
+   0xac509190u, 0x60fa910eu, 0xee7596edu, 0x22df9673u, 0x281a9f6au, 0xe4b09ff4u, 0x6a3f9817u, 0xa6959889u,
+   0x7fb58a25u, 0xb31f8abbu, 0x3d908d58u, 0xf13a8dc6u, 0xfbff84dfu, 0x37558441u, 0xb9da83a2u, 0x7570833cu,
+   0x533b85dau, 0x9f918544u, 0x111e82a7u, 0xddb48239u, 0xd7718b20u, 0x1bdb8bbeu, 0x95548c5du, 0x59fe8cc3u,
+   0x80de9e6fu, 0x4c749ef1u, 0xc2fb9912u, 0x0e51998cu, 0x04949095u, 0xc83e900bu, 0x46b197e8u, 0x8a1b9776u,
+   0x2f80b4f1u, 0xe32ab46fu, 0x6da5b38cu, 0xa10fb312u, 0xabcaba0bu, 0x6760ba95u, 0xe9efbd76u, 0x2545bde8u,
+   0xfc65af44u, 0x30cfafdau, 0xbe40a839u, 0x72eaa8a7u, 0x782fa1beu, 0xb485a120u, 0x3a0aa6c3u, 0xf6a0a65du,
+   0xaa4de78cu, 0x66e7e712u, 0xe868e0f1u, 0x24c2e06fu, 0x2e07e976u, 0xe2ade9e8u, 0x6c22ee0bu, 0xa088ee95u,
+   0x79a8fc39u, 0xb502fca7u, 0x3b8dfb44u, 0xf727fbdau, 0xfde2f2c3u, 0x3148f25du, 0xbfc7f5beu, 0x736df520u,
+   0xd6f6d6a7u, 0x1a5cd639u, 0x94d3d1dau, 0x5879d144u, 0x52bcd85du, 0x9e16d8c3u, 0x1099df20u, 0xdc33dfbeu,
+   0x0513cd12u, 0xc9b9cd8cu, 0x4736ca6fu, 0x8b9ccaf1u, 0x8159c3e8u, 0x4df3c376u, 0xc37cc495u, 0x0fd6c40bu,
+   0x7aa64737u, 0xb60c47a9u, 0x3883404au, 0xf42940d4u, 0xfeec49cdu, 0x32464953u, 0xbcc94eb0u, 0x70634e2eu,
+   0xa9435c82u, 0x65e95c1cu, 0xeb665bffu, 0x27cc5b61u, 0x2d095278u, 0xe1a352e6u, 0x6f2c5505u, 0xa386559bu,
+   0x061d761cu, 0xcab77682u, 0x44387161u, 0x889271ffu, 0x825778e6u, 0x4efd7878u, 0xc0727f9bu, 0x0cd87f05u,
+   0xd5f86da9u, 0x19526d37u, 0x97dd6ad4u, 0x5b776a4au, 0x51b26353u, 0x9d1863cdu, 0x1397642eu, 0xdf3d64b0u,
+   0x83d02561u, 0x4f7a25ffu, 0xc1f5221cu, 0x0d5f2282u, 0x079a2b9bu, 0xcb302b05u, 0x45bf2ce6u, 0x89152c78u,
+   0x50353ed4u, 0x9c9f3e4au, 0x121039a9u, 0xdeba3937u, 0xd47f302eu, 0x18d530b0u, 0x965a3753u, 0x5af037cdu,
+   0xff6b144au, 0x33c114d4u, 0xbd4e1337u, 0x71e413a9u, 0x7b211ab0u, 0xb78b1a2eu, 0x39041dcdu, 0xf5ae1d53u,
+   0x2c8e0fffu, 0xe0240f61u, 0x6eab0882u, 0xa201081cu, 0xa8c40105u, 0x646e019bu, 0xeae10678u, 0x264b06e6u},
+  {0x00000000u, 0x177b1443u, 0x2ef62886u, 0x398d3cc5u, 0x5dec510cu, 0x4a97454fu, 0x731a798au, 0x64616dc9u,
+   0xbbd8a218u, 0xaca3b65bu, 0x952e8a9eu, 0x82559eddu, 0xe634f314u, 0xf14fe757u, 0xc8c2db92u, 0xdfb9cfd1u,
+   0xacc04271u, 0xbbbb5632u, 0x82366af7u, 0x954d7eb4u, 0xf12c137du, 0xe657073eu, 0xdfda3bfbu, 0xc8a12fb8u,
+   0x1718e069u, 0x0063f42au, 0x39eec8efu, 0x2e95dcacu, 0x4af4b165u, 0x5d8fa526u, 0x640299e3u, 0x73798da0u,
+   0x82f182a3u, 0x958a96e0u, 0xac07aa25u, 0xbb7cbe66u, 0xdf1dd3afu, 0xc866c7ecu, 0xf1ebfb29u, 0xe690ef6au,
+   0x392920bbu, 0x2e5234f8u, 0x17df083du, 0x00a41c7eu, 0x64c571b7u, 0x73be65f4u, 0x4a335931u, 0x5d484d72u,
+   0x2e31c0d2u, 0x394ad491u, 0x00c7e854u, 0x17bcfc17u, 0x73dd91deu, 0x64a6859du, 0x5d2bb958u, 0x4a50ad1bu,
+   0x95e962cau, 0x82927689u, 0xbb1f4a4cu, 0xac645e0fu, 0xc80533c6u, 0xdf7e2785u, 0xe6f31b40u, 0xf1880f03u,
+   0xde920307u, 0xc9e91744u, 0xf0642b81u, 0xe71f3fc2u, 0x837e520bu, 0x94054648u, 0xad887a8du, 0xbaf36eceu,
+   0x654aa11fu, 0x7231b55cu, 0x4bbc8999u, 0x5cc79ddau, 0x38a6f013u, 0x2fdde450u, 0x1650d895u, 0x012bccd6u,
+   0x72524176u, 0x65295535u, 0x5ca469f0u, 0x4bdf7db3u, 0x2fbe107au, 0x38c50439u, 0x014838fcu, 0x16332cbfu,
+   0xc98ae36eu, 0xdef1f72du, 0xe77ccbe8u, 0xf007dfabu, 0x9466b262u, 0x831da621u, 0xba909ae4u, 0xadeb8ea7u,
+   0x5c6381a4u, 0x4b1895e7u, 0x7295a922u, 0x65eebd61u, 0x018fd0a8u, 0x16f4c4ebu, 0x2f79f82eu, 0x3802ec6du,
+   0xe7bb23bcu, 0xf0c037ffu, 0xc94d0b3au, 0xde361f79u, 0xba5772b0u, 0xad2c66f3u, 0x94a15a36u, 0x83da4e75u,
+   0xf0a3c3d5u, 0xe7d8d796u, 0xde55eb53u, 0xc92eff10u, 0xad4f92d9u, 0xba34869au, 0x83b9ba5fu, 0x94c2ae1cu,
+   0x4b7b61cdu, 0x5c00758eu, 0x658d494bu, 0x72f65d08u, 0x169730c1u, 0x01ec2482u, 0x38611847u, 0x2f1a0c04u,
+   0x6655004fu, 0x712e140cu, 0x48a328c9u, 0x5fd83c8au, 0x3bb95143u, 0x2cc24500u, 0x154f79c5u, 0x02346d86u,
+   0xdd8da257u, 0xcaf6b614u, 0xf37b8ad1u, 0xe4009e92u, 0x8061f35bu, 0x971ae718u, 0xae97dbddu, 0xb9eccf9eu,
+   0xca95423eu, 0xddee567du, 0xe4636ab8u, 0xf3187efbu, 0x97791332u, 0x80020771u, 0xb98f3bb4u, 0xaef42ff7u,
+   0x714de026u, 0x6636f465u, 0x5fbbc8a0u, 0x48c0dce3u, 0x2ca1b12au, 0x3bdaa569u, 0x025799acu, 0x152c8defu,
+   0xe4a482ecu, 0xf3df96afu, 0xca52aa6au, 0xdd29be29u, 0xb948d3e0u, 0xae33c7a3u, 0x97befb66u, 0x80c5ef25u,
+   0x5f7c20f4u, 0x480734b7u, 0x718a0872u, 0x66f11c31u, 0x029071f8u, 0x15eb65bbu, 0x2c66597eu, 0x3b1d4d3du,
+   0x4864c09du, 0x5f1fd4deu, 0x6692e81bu, 0x71e9fc58u, 0x15889191u, 0x02f385d2u, 0x3b7eb917u, 0x2c05ad54u,
+   0xf3bc6285u, 0xe4c776c6u, 0xdd4a4a03u, 0xca315e40u, 0xae503389u, 0xb92b27cau, 0x80a61b0fu, 0x97dd0f4cu,
+   0xb8c70348u, 0xafbc170bu, 0x96312bceu, 0x814a3f8du, 0xe52b5244u, 0xf2504607u, 0xcbdd7ac2u, 0xdca66e81u,
+   0x031fa150u, 0x1464b513u, 0x2de989d6u, 0x3a929d95u, 0x5ef3f05cu, 0x4988e41fu, 0x7005d8dau, 0x677ecc99u,
+   0x14074139u, 0x037c557au, 0x3af169bfu, 0x2d8a7dfcu, 0x49eb1035u, 0x5e900476u, 0x671d38b3u, 0x70662cf0u,
+   0xafdfe321u, 0xb8a4f762u, 0x8129cba7u, 0x9652dfe4u, 0xf233b22du, 0xe548a66eu, 0xdcc59aabu, 0xcbbe8ee8u,
+   0x3a3681ebu, 0x2d4d95a8u, 0x14c0a96du, 0x03bbbd2eu, 0x67dad0e7u, 0x70a1c4a4u, 0x492cf861u, 0x5e57ec22u,
+   0x81ee23f3u, 0x969537b0u, 0xaf180b75u, 0xb8631f36u, 0xdc0272ffu, 0xcb7966bcu, 0xf2f45a79u, 0xe58f4e3au,
+   0x96f6c39au, 0x818dd7d9u, 0xb800eb1cu, 0xaf7bff5fu, 0xcb1a9296u, 0xdc6186d5u, 0xe5ecba10u, 0xf297ae53u,
+   0x2d2e6182u, 0x3a5575c1u, 0x03d84904u, 0x14a35d47u, 0x70c2308eu, 0x67b924cdu, 0x5e341808u, 0x494f0c4bu},
+  {0x00000000u, 0xefc26b3eu, 0x04f5d03du, 0xeb37bb03u, 0x09eba07au, 0xe629cb44u, 0x0d1e7047u, 0xe2dc1b79u,
+   0x13d740f4u, 0xfc152bcau, 0x172290c9u, 0xf8e0fbf7u, 0x1a3ce08eu, 0xf5fe8bb0u, 0x1ec930b3u, 0xf10b5b8du,
+   0x27ae81e8u, 0xc86cead6u, 0x235b51d5u, 0xcc993aebu, 0x2e452192u, 0xc1874aacu, 0x2ab0f1afu, 0xc5729a91u,
+   0x3479c11cu, 0xdbbbaa22u, 0x308c1121u, 0xdf4e7a1fu, 0x3d926166u, 0xd2500a58u, 0x3967b15bu, 0xd6a5da65u,
+   0x4f5d03d0u, 0xa09f68eeu, 0x4ba8d3edu, 0xa46ab8d3u, 0x46b6a3aau, 0xa974c894u, 0x42437397u, 0xad8118a9u,
+   0x5c8a4324u, 0xb348281au, 0x587f9319u, 0xb7bdf827u, 0x5561e35eu, 0xbaa38860u, 0x51943363u, 0xbe56585du,
+   0x68f38238u, 0x8731e906u, 0x6c065205u, 0x83c4393bu, 0x61182242u, 0x8eda497cu, 0x65edf27fu, 0x8a2f9941u,
+   0x7b24c2ccu, 0x94e6a9f2u, 0x7fd112f1u, 0x901379cfu, 0x72cf62b6u, 0x9d0d0988u, 0x763ab28bu, 0x99f8d9b5u,
+   0x9eba07a0u, 0x71786c9eu, 0x9a4fd79du, 0x758dbca3u, 0x9751a7dau, 0x7893cce4u, 0x93a477e7u, 0x7c661cd9u,
+   0x8d6d4754u, 0x62af2c6au, 0x89989769u, 0x665afc57u, 0x8486e72eu, 0x6b448c10u, 0x80733713u, 0x6fb15c2du,
+   0xb9148648u, 0x56d6ed76u, 0xbde15675u, 0x52233d4bu, 0xb0ff2632u, 0x5f3d4d0cu, 0xb40af60fu, 0x5bc89d31u,
+   0xaac3c6bcu, 0x4501ad82u, 0xae361681u, 0x41f47dbfu, 0xa32866c6u, 0x4cea0df8u, 0xa7ddb6fbu, 0x481fddc5u,
+   0xd1e70470u, 0x3e256f4eu, 0xd512d44du, 0x3ad0bf73u, 0xd80ca40au, 0x37cecf34u, 0xdcf97437u, 0x333b1f09u,
+   0xc2304484u, 0x2df22fbau, 0xc6c594b9u, 0x2907ff87u, 0xcbdbe4feu, 0x24198fc0u, 0xcf2e34c3u, 0x20ec5ffdu,
+   0xf6498598u, 0x198beea6u, 0xf2bc55a5u, 0x1d7e3e9bu, 0xffa225e2u, 0x10604edcu, 0xfb57f5dfu, 0x14959ee1u,
+   0xe59ec56cu, 0x0a5cae52u, 0xe16b1551u, 0x0ea97e6fu, 0xec756516u, 0x03b70e28u, 0xe880b52bu, 0x0742de15u,
+   0xe6050901u, 0x09c7623fu, 0xe2f0d93cu, 0x0d32b202u, 0xefeea97bu, 0x002cc245u, 0xeb1b7946u, 0x04d91278u,
+   0xf5d249f5u, 0x1a1022cbu, 0xf12799c8u, 0x1ee5f2f6u, 0xfc39e98fu, 0x13fb82b1u, 0xf8cc39b2u, 0x170e528cu,
+   0xc1ab88e9u, 0x2e69e3d7u, 0xc55e58d4u, 0x2a9c33eau, 0xc8402893u, 0x278243adu, 0xccb5f8aeu, 0x23779390u,
+   0xd27cc81du, 0x3dbea323u, 0xd6891820u, 0x394b731eu, 0xdb976867u, 0x34550359u, 0xdf62b85au, 0x30a0d364u,
+   0xa9580ad1u, 0x469a61efu, 0xadaddaecu, 0x426fb1d2u, 0xa0b3aaabu, 0x4f71c195u, 0xa4467a96u, 0x4b8411a8u,
+   0xba8f4a25u, 0x554d211bu, 0xbe7a9a18u, 0x51b8f126u, 0xb364ea5fu, 0x5ca68161u, 0xb7913a62u, 0x5853515cu,
+   0x8ef68b39u, 0x6134e007u, 0x8a035b04u, 0x65c1303au, 0x871d2b43u, 0x68df407du, 0x83e8fb7eu, 0x6c2a9040u,
+   0x9d21cbcdu, 0x72e3a0f3u, 0x99d41bf0u, 0x761670ceu, 0x94ca6bb7u, 0x7b080089u, 0x903fbb8au, 0x7ffdd0b4u,
+   0x78bf0ea1u, 0x977d659fu, 0x7c4ade9cu, 0x9388b5a2u, 0x7154aedbu, 0x9e96c5e5u, 0x75a17ee6u, 0x9a6315d8u,
+   0x6b684e55u, 0x84aa256bu, 0x6f9d9e68u, 0x805ff556u, 0x6283ee2fu, 0x8d418511u, 0x66763e12u, 0x89b4552cu,
+   0x5f118f49u, 0xb0d3e477u, 0x5be45f74u, 0xb426344au, 0x56fa2f33u, 0xb938440du, 0x520fff0eu, 0xbdcd9430u,
+   0x4cc6cfbdu, 0xa304a483u, 0x48331f80u, 0xa7f174beu, 0x452d6fc7u, 0xaaef04f9u, 0x41d8bffau, 0xae1ad4c4u,
+   0x37e20d71u, 0xd820664fu, 0x3317dd4cu, 0xdcd5b672u, 0x3e09ad0bu, 0xd1cbc635u, 0x3afc7d36u, 0xd53e1608u,
+   0x24354d85u, 0xcbf726bbu, 0x20c09db8u, 0xcf02f686u, 0x2ddeedffu, 0xc21c86c1u, 0x292b3dc2u, 0xc6e956fcu,
+   0x104c8c99u, 0xff8ee7a7u, 0x14b95ca4u, 0xfb7b379au, 0x19a72ce3u, 0xf66547ddu, 0x1d52fcdeu, 0xf29097e0u,
+   0x039bcc6du, 0xec59a753u, 0x076e1c50u, 0xe8ac776eu, 0x0a706c17u, 0xe5b20729u, 0x0e85bc2au, 0xe147d714u},
+  {0x00000000u, 0xc18edfc0u, 0x586cb9c1u, 0x99e26601u, 0xb0d97382u, 0x7157ac42u, 0xe8b5ca43u, 0x293b1583u,
+   0xbac3e145u, 0x7b4d3e85u, 0xe2af5884u, 0x23218744u, 0x0a1a92c7u, 0xcb944d07u, 0x52762b06u, 0x93f8f4c6u,
+   0xaef6c4cbu, 0x6f781b0bu, 0xf69a7d0au, 0x3714a2cau, 0x1e2fb749u, 0xdfa16889u, 0x46430e88u, 0x87cdd148u,
+   0x1435258eu, 0xd5bbfa4eu, 0x4c599c4fu, 0x8dd7438fu, 0xa4ec560cu, 0x656289ccu, 0xfc80efcdu, 0x3d0e300du,
+   0x869c8fd7u, 0x47125017u, 0xdef03616u, 0x1f7ee9d6u, 0x3645fc55u, 0xf7cb2395u, 0x6e294594u, 0xafa79a54u,
+   0x3c5f6e92u, 0xfdd1b152u, 0x6433d753u, 0xa5bd0893u, 0x8c861d10u, 0x4d08c2d0u, 0xd4eaa4d1u, 0x15647b11u,
+   0x286a4b1cu, 0xe9e494dcu, 0x7006f2ddu, 0xb1882d1du, 0x98b3389eu, 0x593de75eu, 0xc0df815fu, 0x01515e9fu,
+   0x92a9aa59u, 0x53277599u, 0xcac51398u, 0x0b4bcc58u, 0x2270d9dbu, 0xe3fe061bu, 0x7a1c601au, 0xbb92bfdau,
+   0xd64819efu, 0x17c6c62fu, 0x8e24a02eu, 0x4faa7feeu, 0x66916a6du, 0xa71fb5adu, 0x3efdd3acu, 0xff730c6cu,
+   0x6c8bf8aau, 0xad05276au, 0x34e7416bu, 0xf5699eabu, 0xdc528b28u, 0x1ddc54e8u, 0x843e32e9u, 0x45b0ed29u,
+   0x78bedd24u, 0xb93002e4u, 0x20d264e5u, 0xe15cbb25u, 0xc867aea6u, 0x09e97166u, 0x900b1767u, 0x5185c8a7u,
+   0xc27d3c61u, 0x03f3e3a1u, 0x9a1185a0u, 0x5b9f5a60u, 0x72a44fe3u, 0xb32a9023u, 0x2ac8f622u, 0xeb4629e2u,
+   0x50d49638u, 0x915a49f8u, 0x08b82ff9u, 0xc936f039u, 0xe00de5bau, 0x21833a7au, 0xb8615c7bu, 0x79ef83bbu,
+   0xea17777du, 0x2b99a8bdu, 0xb27bcebcu, 0x73f5117cu, 0x5ace04ffu, 0x9b40db3fu, 0x02a2bd3eu, 0xc32c62feu,
+   0xfe2252f3u, 0x3fac8d33u, 0xa64eeb32u, 0x67c034f2u, 0x4efb2171u, 0x8f75feb1u, 0x169798b0u, 0xd7194770u,
+   0x44e1b3b6u, 0x856f6c76u, 0x1c8d0a77u, 0xdd03d5b7u, 0xf438c034u, 0x35b61ff4u, 0xac5479f5u, 0x6ddaa635u,
+   0x77e1359fu, 0xb66fea5fu, 0x2f8d8c5eu, 0xee03539eu, 0xc738461du, 0x06b699ddu, 0x9f54ffdcu, 0x5eda201cu,
+   0xcd22d4dau, 0x0cac0b1au, 0x954e6d1bu, 0x54c0b2dbu, 0x7dfba758u, 0xbc757898u, 0x25971e99u, 0xe419c159u,
+   0xd917f154u, 0x18992e94u, 0x817b4895u, 0x40f59755u, 0x69ce82d6u, 0xa8405d16u, 0x31a23b17u, 0xf02ce4d7u,
+   0x63d41011u, 0xa25acfd1u, 0x3bb8a9d0u, 0xfa367610u, 0xd30d6393u, 0x1283bc53u, 0x8b61da52u, 0x4aef0592u,
+   0xf17dba48u, 0x30f36588u, 0xa9110389u, 0x689fdc49u, 0x41a4c9cau, 0x802a160au, 0x19c8700bu, 0xd846afcbu,
+   0x4bbe5b0du, 0x8a3084cdu, 0x13d2e2ccu, 0xd25c3d0cu, 0xfb67288fu, 0x3ae9f74fu, 0xa30b914eu, 0x62854e8eu,
+   0x5f8b7e83u, 0x9e05a143u, 0x07e7c742u, 0xc6691882u, 0xef520d01u, 0x2edcd2c1u, 0xb73eb4c0u, 0x76b06b00u,
+   0xe5489fc6u, 0x24c64006u, 0xbd242607u, 0x7caaf9c7u, 0x5591ec44u, 0x941f3384u, 0x0dfd5585u, 0xcc738a45u,
+   0xa1a92c70u, 0x6027f3b0u, 0xf9c595b1u, 0x384b4a71u, 0x11705ff2u, 0xd0fe8032u, 0x491ce633u, 0x889239f3u,
+   0x1b6acd35u, 0xdae412f5u, 0x430674f4u, 0x8288ab34u, 0xabb3beb7u, 0x6a3d6177u, 0xf3df0776u, 0x3251d8b6u,
+   0x0f5fe8bbu, 0xced1377bu, 0x5733517au, 0x96bd8ebau, 0xbf869b39u, 0x7e0844f9u, 0xe7ea22f8u, 0x2664fd38u,
+   0xb59c09feu, 0x7412d63eu, 0xedf0b03fu, 0x2c7e6fffu, 0x05457a7cu, 0xc4cba5bcu, 0x5d29c3bdu, 0x9ca71c7du,
+   0x2735a3a7u, 0xe6bb7c67u, 0x7f591a66u, 0xbed7c5a6u, 0x97ecd025u, 0x56620fe5u, 0xcf8069e4u, 0x0e0eb624u,
+   0x9df642e2u, 0x5c789d22u, 0xc59afb23u, 0x041424e3u, 0x2d2f3160u, 0xeca1eea0u, 0x754388a1u, 0xb4cd5761u,
+   0x89c3676cu, 0x484db8acu, 0xd1afdeadu, 0x1021016du, 0x391a14eeu, 0xf894cb2eu, 0x6176ad2fu, 0xa0f872efu,
+   0x33008629u, 0xf28e59e9u, 0x6b6c3fe8u, 0xaae2e028u, 0x83d9f5abu, 0x42572a6bu, 0xdbb54c6au, 0x1a3b93aau},
+  {0x00000000u, 0x9ba54c6fu, 0xec3b9e9fu, 0x779ed2f0u, 0x03063b7fu, 0x98a37710u, 0xef3da5e0u, 0x7498e98fu,
+   0x060c76feu, 0x9da93a91u, 0xea37e861u, 0x7192a40eu, 0x050a4d81u, 0x9eaf01eeu, 0xe931d31eu, 0x72949f71u,
+   0x0c18edfcu, 0x97bda193u, 0xe0237363u, 0x7b863f0cu, 0x0f1ed683u, 0x94bb9aecu, 0xe325481cu, 0x78800473u,
+   0x0a149b02u, 0x91b1d76du, 0xe62f059du, 0x7d8a49f2u, 0x0912a07du, 0x92b7ec12u, 0xe5293ee2u, 0x7e8c728du,
+   0x1831dbf8u, 0x83949797u, 0xf40a4567u, 0x6faf0908u, 0x1b37e087u, 0x8092ace8u, 0xf70c7e18u, 0x6ca93277u,
+   0x1e3dad06u, 0x8598e169u, 0xf2063399u, 0x69a37ff6u, 0x1d3b9679u, 0x869eda16u, 0xf10008e6u, 0x6aa54489u,
+   0x14293604u, 0x8f8c7a6bu, 0xf812a89bu, 0x63b7e4f4u, 0x172f0d7bu, 0x8c8a4114u, 0xfb1493e4u, 0x60b1df8bu,
+   0x122540fau, 0x89800c95u, 0xfe1ede65u, 0x65bb920au, 0x11237b85u, 0x8a8637eau, 0xfd18e51au, 0x66bda975u,
+   0x3063b7f0u, 0xabc6fb9fu, 0xdc58296fu, 0x47fd6500u, 0x33658c8fu, 0xa8c0c0e0u, 0xdf5e1210u, 0x44fb5e7fu,
+   0x366fc10eu, 0xadca8d61u, 0xda545f91u, 0x41f113feu, 0x3569fa71u, 0xaeccb61eu, 0xd95264eeu, 0x42f72881u,
+   0x3c7b5a0cu, 0xa7de1663u, 0xd040c493u, 0x4be588fcu, 0x3f7d6173u, 0xa4d82d1cu, 0xd346ffecu, 0x48e3b383u,
+   0x3a772cf2u, 0xa1d2609du, 0xd64cb26du, 0x4de9fe02u, 0x3971178du, 0xa2d45be2u, 0xd54a8912u, 0x4eefc57du,
+   0x28526c08u, 0xb3f72067u, 0xc469f297u, 0x5fccbef8u, 0x2b545777u, 0xb0f11b18u, 0xc76fc9e8u, 0x5cca8587u,
+   0x2e5e1af6u, 0xb5fb5699u, 0xc2658469u, 0x59c0c806u, 0x2d582189u, 0xb6fd6de6u, 0xc163bf16u, 0x5ac6f379u,
+   0x244a81f4u, 0xbfefcd9bu, 0xc8711f6bu, 0x53d45304u, 0x274cba8bu, 0xbce9f6e4u, 0xcb772414u, 0x50d2687bu,
+   0x2246f70au, 0xb9e3bb65u, 0xce7d6995u, 0x55d825fau, 0x2140cc75u, 0xbae5801au, 0xcd7b52eau, 0x56de1e85u,
+   0x60c76fe0u, 0xfb62238fu, 0x8cfcf17fu, 0x1759bd10u, 0x63c1549fu, 0xf86418f0u, 0x8ffaca00u, 0x145f866fu,
+   0x66cb191eu, 0xfd6e5571u, 0x8af08781u, 0x1155cbeeu, 0x65cd2261u, 0xfe686e0eu, 0x89f6bcfeu, 0x1253f091u,
+   0x6cdf821cu, 0xf77ace73u, 0x80e41c83u, 0x1b4150ecu, 0x6fd9b963u, 0xf47cf50cu, 0x83e227fcu, 0x18476b93u,
+   0x6ad3f4e2u, 0xf176b88du, 0x86e86a7du, 0x1d4d2612u, 0x69d5cf9du, 0xf27083f2u, 0x85ee5102u, 0x1e4b1d6du,
+   0x78f6b418u, 0xe353f877u, 0x94cd2a87u, 0x0f6866e8u, 0x7bf08f67u, 0xe055c308u, 0x97cb11f8u, 0x0c6e5d97u,
+   0x7efac2e6u, 0xe55f8e89u, 0x92c15c79u, 0x09641016u, 0x7dfcf999u, 0xe659b5f6u, 0x91c76706u, 0x0a622b69u,
+   0x74ee59e4u, 0xef4b158bu, 0x98d5c77bu, 0x03708b14u, 0x77e8629bu, 0xec4d2ef4u, 0x9bd3fc04u, 0x0076b06bu,
+   0x72e22f1au, 0xe9476375u, 0x9ed9b185u, 0x057cfdeau, 0x71e41465u, 0xea41580au, 0x9ddf8afau, 0x067ac695u,
+   0x50a4d810u, 0xcb01947fu, 0xbc9f468fu, 0x273a0ae0u, 0x53a2e36fu, 0xc807af00u, 0xbf997df0u, 0x243c319fu,
+   0x56a8aeeeu, 0xcd0de281u, 0xba933071u, 0x21367c1eu, 0x55ae9591u, 0xce0bd9feu, 0xb9950b0eu, 0x22304761u,
+   0x5cbc35ecu, 0xc7197983u, 0xb087ab73u, 0x2b22e71cu, 0x5fba0e93u, 0xc41f42fcu, 0xb381900cu, 0x2824dc63u,
+   0x5ab04312u, 0xc1150f7du, 0xb68bdd8du, 0x2d2e91e2u, 0x59b6786du, 0xc2133402u, 0xb58de6f2u, 0x2e28aa9du,
+   0x489503e8u, 0xd3304f87u, 0xa4ae9d77u, 0x3f0bd118u, 0x4b933897u, 0xd03674f8u, 0xa7a8a608u, 0x3c0dea67u,
+   0x4e997516u, 0xd53c3979u, 0xa2a2eb89u, 0x3907a7e6u, 0x4d9f4e69u, 0xd63a0206u, 0xa1a4d0f6u, 0x3a019c99u,
+   0x448dee14u, 0xdf28a27bu, 0xa8b6708bu, 0x33133ce4u, 0x478bd56bu, 0xdc2e9904u, 0xabb04bf4u, 0x3015079bu,
+   0x428198eau, 0xd924d485u, 0xaeba0675u, 0x351f4a1au, 0x4187a395u, 0xda22effau, 0xadbc3d0au, 0x36197165u},
+  {0x00000000u, 0xdd96d985u, 0x605cb54bu, 0xbdca6cceu, 0xc0b96a96u, 0x1d2fb313u, 0xa0e5dfddu, 0x7d730658u,
+   0x5a03d36du, 0x87950ae8u, 0x3a5f6626u, 0xe7c9bfa3u, 0x9abab9fbu, 0x472c607eu, 0xfae60cb0u, 0x2770d535u,
+   0xb407a6dau, 0x69917f5fu, 0xd45b1391u, 0x09cdca14u, 0x74becc4cu, 0xa92815c9u, 0x14e27907u, 0xc974a082u,
+   0xee0475b7u, 0x3392ac32u, 0x8e58c0fcu, 0x53ce1979u, 0x2ebd1f21u, 0xf32bc6a4u, 0x4ee1aa6au, 0x937773efu,
+   0xb37e4bf5u, 0x6ee89270u, 0xd322febeu, 0x0eb4273bu, 0x73c72163u, 0xae51f8e6u, 0x139b9428u, 0xce0d4dadu,
+   0xe97d9898u, 0x34eb411du, 0x89212dd3u, 0x54b7f456u, 0x29c4f20eu, 0xf4522b8bu, 0x49984745u, 0x940e9ec0u,
+   0x0779ed2fu, 0xdaef34aau, 0x67255864u, 0xbab381e1u, 0xc7c087b9u, 0x1a565e3cu, 0xa79c32f2u, 0x7a0aeb77u,
+   0x5d7a3e42u, 0x80ece7c7u, 0x3d268b09u, 0xe0b0528cu, 0x9dc354d4u, 0x40558d51u, 0xfd9fe19fu, 0x2009381au,
+   0xbd8d91abu, 0x601b482eu, 0xddd124e0u, 0x0047fd65u, 0x7d34fb3du, 0xa0a222b8u, 0x1d684e76u, 0xc0fe97f3u,
+   0xe78e42c6u, 0x3a189b43u, 0x87d2f78du, 0x5a442e08u, 0x27372850u, 0xfaa1f1d5u, 0x476b9d1bu, 0x9afd449eu,
+   0x098a3771u, 0xd41ceef4u, 0x69d6823au, 0xb4405bbfu, 0xc9335de7u, 0x14a58462u, 0xa96fe8acu, 0x74f93129u,
+   0x5389e41cu, 0x8e1f3d99u, 0x33d55157u, 0xee4388d2u, 0x93308e8au, 0x4ea6570fu, 0xf36c3bc1u, 0x2efae244u,
+   0x0ef3da5eu, 0xd36503dbu, 0x6eaf6f15u, 0xb339b690u, 0xce4ab0c8u, 0x13dc694du, 0xae160583u, 0x7380dc06u,
+   0x54f00933u, 0x8966d0b6u, 0x34acbc78u, 0xe93a65fdu, 0x944963a5u, 0x49dfba20u, 0xf415d6eeu, 0x29830f6bu,
+   0xbaf47c84u, 0x6762a501u, 0xdaa8c9cfu, 0x073e104au, 0x7a4d1612u, 0xa7dbcf97u, 0x1a11a359u, 0xc7877adcu,
+   0xe0f7afe9u, 0x3d61766cu, 0x80ab1aa2u, 0x5d3dc327u, 0x204ec57fu, 0xfdd81cfau, 0x40127034u, 0x9d84a9b1u,
+   0xa06a2517u, 0x7dfcfc92u, 0xc036905cu, 0x1da049d9u, 0x60d34f81u, 0xbd459604u, 0x008ffacau, 0xdd19234fu,
+   0xfa69f67au, 0x27ff2fffu, 0x9a354331u, 0x47a39ab4u, 0x3ad09cecu, 0xe7464569u, 0x5a8c29a7u, 0x871af022u,
+   0x146d83cdu, 0xc9fb5a48u, 0x74313686u, 0xa9a7ef03u, 0xd4d4e95bu, 0x094230deu, 0xb4885c10u, 0x691e8595u,
+   0x4e6e50a0u, 0x93f88925u, 0x2e32e5ebu, 0xf3a43c6eu, 0x8ed73a36u, 0x5341e3b3u, 0xee8b8f7du, 0x331d56f8u,
+   0x13146ee2u, 0xce82b767u, 0x7348dba9u, 0xaede022cu, 0xd3ad0474u, 0x0e3bddf1u, 0xb3f1b13fu, 0x6e6768bau,
+   0x4917bd8fu, 0x9481640au, 0x294b08c4u, 0xf4ddd141u, 0x89aed719u, 0x54380e9cu, 0xe9f26252u, 0x3464bbd7u,
+   0xa713c838u, 0x7a8511bdu, 0xc74f7d73u, 0x1ad9a4f6u, 0x67aaa2aeu, 0xba3c7b2bu, 0x07f617e5u, 0xda60ce60u,
+   0xfd101b55u, 0x2086c2d0u, 0x9d4cae1eu, 0x40da779bu, 0x3da971c3u, 0xe03fa846u, 0x5df5c488u, 0x80631d0du,
+   0x1de7b4bcu, 0xc0716d39u, 0x7dbb01f7u, 0xa02dd872u, 0xdd5ede2au, 0x00c807afu, 0xbd026b61u, 0x6094b2e4u,
+   0x47e467d1u, 0x9a72be54u, 0x27b8d29au, 0xfa2e0b1fu, 0x875d0d47u, 0x5acbd4c2u, 0xe701b80cu, 0x3a976189u,
+   0xa9e01266u, 0x7476cbe3u, 0xc9bca72du, 0x142a7ea8u, 0x695978f0u, 0xb4cfa175u, 0x0905cdbbu, 0xd493143eu,
+   0xf3e3c10bu, 0x2e75188eu, 0x93bf7440u, 0x4e29adc5u, 0x335aab9du, 0xeecc7218u, 0x53061ed6u, 0x8e90c753u,
+   0xae99ff49u, 0x730f26ccu, 0xcec54a02u, 0x13539387u, 0x6e2095dfu, 0xb3b64c5au, 0x0e7c2094u, 0xd3eaf911u,
+   0xf49a2c24u, 0x290cf5a1u, 0x94c6996fu, 0x495040eau, 0x342346b2u, 0xe9b59f37u, 0x547ff3f9u, 0x89e92a7cu,
+   0x1a9e5993u, 0xc7088016u, 0x7ac2ecd8u, 0xa754355du, 0xda273305u, 0x07b1ea80u, 0xba7b864eu, 0x67ed5fcbu,
+   0x409d8afeu, 0x9d0b537bu, 0x20c13fb5u, 0xfd57e630u, 0x8024e068u, 0x5db239edu, 0xe0785523u, 0x3dee8ca6u},
+  {0x00000000u, 0x9d0fe176u, 0xe16ec4adu, 0x7c6125dbu, 0x19ac8f1bu, 0x84a36e6du, 0xf8c24bb6u, 0x65cdaac0u,
+   0x33591e36u, 0xae56ff40u, 0xd237da9bu, 0x4f383bedu, 0x2af5912du, 0xb7fa705bu, 0xcb9b5580u, 0x5694b4f6u,
+   0x66b23c6cu, 0xfbbddd1au, 0x87dcf8c1u, 0x1ad319b7u, 0x7f1eb377u, 0xe2115201u, 0x9e7077dau, 0x037f96acu,
+   0x55eb225au, 0xc8e4c32cu, 0xb485e6f7u, 0x298a0781u, 0x4c47ad41u, 0xd1484c37u, 0xad2969ecu, 0x3026889au,
+   0xcd6478d8u, 0x506b99aeu, 0x2c0abc75u, 0xb1055d03u, 0xd4c8f7c3u, 0x49c716b5u, 0x35a6336eu, 0xa8a9d218u,
+   0xfe3d66eeu, 0x63328798u, 0x1f53a243u, 0x825c4335u, 0xe791e9f5u, 0x7a9e0883u, 0x06ff2d58u, 0x9bf0cc2eu,
+   0xabd644b4u, 0x36d9a5c2u, 0x4ab88019u, 0xd7b7616fu, 0xb27acbafu, 0x2f752ad9u, 0x53140f02u, 0xce1bee74u,
+   0x988f5a82u, 0x0580bbf4u, 0x79e19e2fu, 0xe4ee7f59u, 0x8123d599u, 0x1c2c34efu, 0x604d1134u, 0xfd42f042u,
+   0x41b9f7f1u, 0xdcb61687u, 0xa0d7335cu, 0x3dd8d22au, 0x581578eau, 0xc51a999cu, 0xb97bbc47u, 0x24745d31u,
+   0x72e0e9c7u, 0xefef08b1u, 0x938e2d6au, 0x0e81cc1cu, 0x6b4c66dcu, 0xf64387aau, 0x8a22a271u, 0x172d4307u,
+   0x270bcb9du, 0xba042aebu, 0xc6650f30u, 0x5b6aee46u, 0x3ea74486u, 0xa3a8a5f0u, 0xdfc9802bu, 0x42c6615du,
+   0x1452d5abu, 0x895d34ddu, 0xf53c1106u, 0x6833f070u, 0x0dfe5ab0u, 0x90f1bbc6u, 0xec909e1du, 0x719f7f6bu,
+   0x8cdd8f29u, 0x11d26e5fu, 0x6db34b84u, 0xf0bcaaf2u, 0x95710032u, 0x087ee144u, 0x741fc49fu, 0xe91025e9u,
+   0xbf84911fu, 0x228b7069u, 0x5eea55b2u, 0xc3e5b4c4u, 0xa6281e04u, 0x3b27ff72u, 0x4746daa9u, 0xda493bdfu,
+   0xea6fb345u, 0x77605233u, 0x0b0177e8u, 0x960e969eu, 0xf3c33c5eu, 0x6eccdd28u, 0x12adf8f3u, 0x8fa21985u,
+   0xd936ad73u, 0x44394c05u, 0x385869deu, 0xa55788a8u, 0xc09a2268u, 0x5d95c31eu, 0x21f4e6c5u, 0xbcfb07b3u,
+   0x8373efe2u, 0x1e7c0e94u, 0x621d2b4fu, 0xff12ca39u, 0x9adf60f9u, 0x07d0818fu, 0x7bb1a454u, 0xe6be4522u,
+   0xb02af1d4u, 0x2d2510a2u, 0x51443579u, 0xcc4bd40fu, 0xa9867ecfu, 0x34899fb9u, 0x48e8ba62u, 0xd5e75b14u,
+   0xe5c1d38eu, 0x78ce32f8u, 0x04af1723u, 0x99a0f655u, 0xfc6d5c95u, 0x6162bde3u, 0x1d039838u, 0x800c794eu,
+   0xd698cdb8u, 0x4b972cceu, 0x37f60915u, 0xaaf9e863u, 0xcf3442a3u, 0x523ba3d5u, 0x2e5a860eu, 0xb3556778u,
+   0x4e17973au, 0xd318764cu, 0xaf795397u, 0x3276b2e1u, 0x57bb1821u, 0xcab4f957u, 0xb6d5dc8cu, 0x2bda3dfau,
+   0x7d4e890cu, 0xe041687au, 0x9c204da1u, 0x012facd7u, 0x64e20617u, 0xf9ede761u, 0x858cc2bau, 0x188323ccu,
+   0x28a5ab56u, 0xb5aa4a20u, 0xc9cb6ffbu, 0x54c48e8du, 0x3109244du, 0xac06c53bu, 0xd067e0e0u, 0x4d680196u,
+   0x1bfcb560u, 0x86f35416u, 0xfa9271cdu, 0x679d90bbu, 0x02503a7bu, 0x9f5fdb0du, 0xe33efed6u, 0x7e311fa0u,
+   0xc2ca1813u, 0x5fc5f965u, 0x23a4dcbeu, 0xbeab3dc8u, 0xdb669708u, 0x4669767eu, 0x3a0853a5u, 0xa707b2d3u,
+   0xf1930625u, 0x6c9ce753u, 0x10fdc288u, 0x8df223feu, 0xe83f893eu, 0x75306848u, 0x09514d93u, 0x945eace5u,
+   0xa478247fu, 0x3977c509u, 0x4516e0d2u, 0xd81901a4u, 0xbdd4ab64u, 0x20db4a12u, 0x5cba6fc9u, 0xc1b58ebfu,
+   0x97213a49u, 0x0a2edb3fu, 0x764ffee4u, 0xeb401f92u, 0x8e8db552u, 0x13825424u, 0x6fe371ffu, 0xf2ec9089u,
+   0x0fae60cbu, 0x92a181bdu, 0xeec0a466u, 0x73cf4510u, 0x1602efd0u, 0x8b0d0ea6u, 0xf76c2b7du, 0x6a63ca0bu,
+   0x3cf77efdu, 0xa1f89f8bu, 0xdd99ba50u, 0x40965b26u, 0x255bf1e6u, 0xb8541090u, 0xc435354bu, 0x593ad43du,
+   0x691c5ca7u, 0xf413bdd1u, 0x8872980au, 0x157d797cu, 0x70b0d3bcu, 0xedbf32cau, 0x91de1711u, 0x0cd1f667u,
+   0x5a454291u, 0xc74aa3e7u, 0xbb2b863cu, 0x2624674au, 0x43e9cd8au, 0xdee62cfcu, 0xa2870927u, 0x3f88e851u},
+  {0x00000000u, 0xb9fbdbe8u, 0xa886b191u, 0x117d6a79u, 0x8a7c6563u, 0x3387be8bu, 0x22fad4f2u, 0x9b010f1au,
+   0xcf89cc87u, 0x7672176fu, 0x670f7d16u, 0xdef4a6feu, 0x45f5a9e4u, 0xfc0e720cu, 0xed731875u, 0x5488c39du,
+   0x44629f4fu, 0xfd9944a7u, 0xece42edeu, 0x551ff536u, 0xce1efa2cu, 0x77e521c4u, 0x66984bbdu, 0xdf639055u,
+   0x8beb53c8u, 0x32108820u, 0x236de259u, 0x9a9639b1u, 0x019736abu, 0xb86ced43u, 0xa911873au, 0x10ea5cd2u,
+   0x88c53e9eu, 0x313ee576u, 0x20438f0fu, 0x99b854e7u, 0x02b95bfdu, 0xbb428015u, 0xaa3fea6cu, 0x13c43184u,
+   0x474cf219u, 0xfeb729f1u, 0xefca4388u, 0x56319860u, 0xcd30977au, 0x74cb4c92u, 0x65b626ebu, 0xdc4dfd03u,
+   0xcca7a1d1u, 0x755c7a39u, 0x64211040u, 0xdddacba8u, 0x46dbc4b2u, 0xff201f5au, 0xee5d7523u, 0x57a6aecbu,
+   0x032e6d56u, 0xbad5b6beu, 0xaba8dcc7u, 0x1253072fu, 0x89520835u, 0x30a9d3ddu, 0x21d4b9a4u, 0x982f624cu,
+   0xcafb7b7du, 0x7300a095u, 0x627dcaecu, 0xdb861104u, 0x40871e1eu, 0xf97cc5f6u, 0xe801af8fu, 0x51fa7467u,
+   0x0572b7fau, 0xbc896c12u, 0xadf4066bu, 0x140fdd83u, 0x8f0ed299u, 0x36f50971u, 0x27886308u, 0x9e73b8e0u,
+   0x8e99e432u, 0x37623fdau, 0x261f55a3u, 0x9fe48e4bu, 0x04e58151u, 0xbd1e5ab9u, 0xac6330c0u, 0x1598eb28u,
+   0x411028b5u, 0xf8ebf35du, 0xe9969924u, 0x506d42ccu, 0xcb6c4dd6u, 0x7297963eu, 0x63eafc47u, 0xda1127afu,
+   0x423e45e3u, 0xfbc59e0bu, 0xeab8f472u, 0x53432f9au, 0xc8422080u, 0x71b9fb68u, 0x60c49111u, 0xd93f4af9u,
+   0x8db78964u, 0x344c528cu, 0x253138f5u, 0x9ccae31du, 0x07cbec07u, 0xbe3037efu, 0xaf4d5d96u, 0x16b6867eu,
+   0x065cdaacu, 0xbfa70144u, 0xaeda6b3du, 0x1721b0d5u, 0x8c20bfcfu, 0x35db6427u, 0x24a60e5eu, 0x9d5dd5b6u,
+   0xc9d5162bu, 0x702ecdc3u, 0x6153a7bau, 0xd8a87c52u, 0x43a97348u, 0xfa52a8a0u, 0xeb2fc2d9u, 0x52d41931u,
+   0x4e87f0bbu, 0xf77c2b53u, 0xe601412au, 0x5ffa9ac2u, 0xc4fb95d8u, 0x7d004e30u, 0x6c7d2449u, 0xd586ffa1u,
+   0x810e3c3cu, 0x38f5e7d4u, 0x29888dadu, 0x90735645u, 0x0b72595fu, 0xb28982b7u, 0xa3f4e8ceu, 0x1a0f3326u,
+   0x0ae56ff4u, 0xb31eb41cu, 0xa263de65u, 0x1b98058du, 0x80990a97u, 0x3962d17fu, 0x281fbb06u, 0x91e460eeu,
+   0xc56ca373u, 0x7c97789bu, 0x6dea12e2u, 0xd411c90au, 0x4f10c610u, 0xf6eb1df8u, 0xe7967781u, 0x5e6dac69u,
+   0xc642ce25u, 0x7fb915cdu, 0x6ec47fb4u, 0xd73fa45cu, 0x4c3eab46u, 0xf5c570aeu, 0xe4b81ad7u, 0x5d43c13fu,
+   0x09cb02a2u, 0xb030d94au, 0xa14db333u, 0x18b668dbu, 0x83b767c1u, 0x3a4cbc29u, 0x2b31d650u, 0x92ca0db8u,
+   0x8220516au, 0x3bdb8a82u, 0x2aa6e0fbu, 0x935d3b13u, 0x085c3409u, 0xb1a7efe1u, 0xa0da8598u, 0x19215e70u,
+   0x4da99dedu, 0xf4524605u, 0xe52f2c7cu, 0x5cd4f794u, 0xc7d5f88eu, 0x7e2e2366u, 0x6f53491fu, 0xd6a892f7u,
+   0x847c8bc6u, 0x3d87502eu, 0x2cfa3a57u, 0x9501e1bfu, 0x0e00eea5u, 0xb7fb354du, 0xa6865f34u, 0x1f7d84dcu,
+   0x4bf54741u, 0xf20e9ca9u, 0xe373f6d0u, 0x5a882d38u, 0xc1892222u, 0x7872f9cau, 0x690f93b3u, 0xd0f4485bu,
+   0xc01e1489u, 0x79e5cf61u, 0x6898a518u, 0xd1637ef0u, 0x4a6271eau, 0xf399aa02u, 0xe2e4c07bu, 0x5b1f1b93u,
+   0x0f97d80eu, 0xb66c03e6u, 0xa711699fu, 0x1eeab277u, 0x85ebbd6du, 0x3c106685u, 0x2d6d0cfcu, 0x9496d714u,
+   0x0cb9b558u, 0xb5426eb0u, 0xa43f04c9u, 0x1dc4df21u, 0x86c5d03bu, 0x3f3e0bd3u, 0x2e4361aau, 0x97b8ba42u,
+   0xc33079dfu, 0x7acba237u, 0x6bb6c84eu, 0xd24d13a6u, 0x494c1cbcu, 0xf0b7c754u, 0xe1caad2du, 0x583176c5u,
+   0x48db2a17u, 0xf120f1ffu, 0xe05d9b86u, 0x59a6406eu, 0xc2a74f74u, 0x7b5c949cu, 0x6a21fee5u, 0xd3da250du,
+   0x8752e690u, 0x3ea93d78u, 0x2fd45701u, 0x962f8ce9u, 0x0d2e83f3u, 0xb4d5581bu, 0xa5a83262u, 0x1c53e98au},
+  {0x00000000u, 0xae689191u, 0x87a02563u, 0x29c8b4f2u, 0xd4314c87u, 0x7a59dd16u, 0x539169e4u, 0xfdf9f875u,
+   0x73139f4fu, 0xdd7b0edeu, 0xf4b3ba2cu, 0x5adb2bbdu, 0xa722d3c8u, 0x094a4259u, 0x2082f6abu, 0x8eea673au,
+   0xe6273e9eu, 0x484faf0fu, 0x61871bfdu, 0xcfef8a6cu, 0x32167219u, 0x9c7ee388u, 0xb5b6577au, 0x1bdec6ebu,
+   0x9534a1d1u, 0x3b5c3040u, 0x129484b2u, 0xbcfc1523u, 0x4105ed56u, 0xef6d7cc7u, 0xc6a5c835u, 0x68cd59a4u,
+   0x173f7b7du, 0xb957eaecu, 0x909f5e1eu, 0x3ef7cf8fu, 0xc30e37fau, 0x6d66a66bu, 0x44ae1299u, 0xeac68308u,
+   0x642ce432u, 0xca4475a3u, 0xe38cc151u, 0x4de450c0u, 0xb01da8b5u, 0x1e753924u, 0x37bd8dd6u, 0x99d51c47u,
+   0xf11845e3u, 0x5f70d472u, 0x76b86080u, 0xd8d0f111u, 0x25290964u, 0x8b4198f5u, 0xa2892c07u, 0x0ce1bd96u,
+   0x820bdaacu, 0x2c634b3du, 0x05abffcfu, 0xabc36e5eu, 0x563a962bu, 0xf85207bau, 0xd19ab348u, 0x7ff222d9u,
+   0x2e7ef6fau, 0x8016676bu, 0xa9ded399u, 0x07b64208u, 0xfa4fba7du, 0x54272becu, 0x7def9f1eu, 0xd3870e8fu,
+   0x5d6d69b5u, 0xf305f824u, 0xdacd4cd6u, 0x74a5dd47u, 0x895c2532u, 0x2734b4a3u, 0x0efc0051u, 0xa09491c0u,
+   0xc859c864u, 0x663159f5u, 0x4ff9ed07u, 0xe1917c96u, 0x1c6884e3u, 0xb2001572u, 0x9bc8a180u, 0x35a03011u,
+   0xbb4a572bu, 0x1522c6bau, 0x3cea7248u, 0x9282e3d9u, 0x6f7b1bacu, 0xc1138a3du, 0xe8db3ecfu, 0x46b3af5eu,
+   0x39418d87u, 0x97291c16u, 0xbee1a8e4u, 0x10893975u, 0xed70c100u, 0x43185091u, 0x6ad0e463u, 0xc4b875f2u,
+   0x4a5212c8u, 0xe43a8359u, 0xcdf237abu, 0x639aa63au, 0x9e635e4fu, 0x300bcfdeu, 0x19c37b2cu, 0xb7abeabdu,
+   0xdf66b319u, 0x710e2288u, 0x58c6967au, 0xf6ae07ebu, 0x0b57ff9eu, 0xa53f6e0fu, 0x8cf7dafdu, 0x229f4b6cu,
+   0xac752c56u, 0x021dbdc7u, 0x2bd50935u, 0x85bd98a4u, 0x784460d1u, 0xd62cf140u, 0xffe445b2u, 0x518cd423u,
+   0x5cfdedf4u, 0xf2957c65u, 0xdb5dc897u, 0x75355906u, 0x88cca173u, 0x26a430e2u, 0x0f6c8410u, 0xa1041581u,
+   0x2fee72bbu, 0x8186e32au, 0xa84e57d8u, 0x0626c649u, 0xfbdf3e3cu, 0x55b7afadu, 0x7c7f1b5fu, 0xd2178aceu,
+   0xbadad36au, 0x14b242fbu, 0x3d7af609u, 0x93126798u, 0x6eeb9fedu, 0xc0830e7cu, 0xe94bba8eu, 0x47232b1fu,
+   0xc9c94c25u, 0x67a1ddb4u, 0x4e696946u, 0xe001f8d7u, 0x1df800a2u, 0xb3909133u, 0x9a5825c1u, 0x3430b450u,
+   0x4bc29689u, 0xe5aa0718u, 0xcc62b3eau, 0x620a227bu, 0x9ff3da0eu, 0x319b4b9fu, 0x1853ff6du, 0xb63b6efcu,
+   0x38d109c6u, 0x96b99857u, 0xbf712ca5u, 0x1119bd34u, 0xece04541u, 0x4288d4d0u, 0x6b406022u, 0xc528f1b3u,
+   0xade5a817u, 0x038d3986u, 0x2a458d74u, 0x842d1ce5u, 0x79d4e490u, 0xd7bc7501u, 0xfe74c1f3u, 0x501c5062u,
+   0xdef63758u, 0x709ea6c9u, 0x5956123bu, 0xf73e83aau, 0x0ac77bdfu, 0xa4afea4eu, 0x8d675ebcu, 0x230fcf2du,
+   0x72831b0eu, 0xdceb8a9fu, 0xf5233e6du, 0x5b4baffcu, 0xa6b25789u, 0x08dac618u, 0x211272eau, 0x8f7ae37bu,
+   0x01908441u, 0xaff815d0u, 0x8630a122u, 0x285830b3u, 0xd5a1c8c6u, 0x7bc95957u, 0x5201eda5u, 0xfc697c34u,
+   0x94a42590u, 0x3accb401u, 0x130400f3u, 0xbd6c9162u, 0x40956917u, 0xeefdf886u, 0xc7354c74u, 0x695ddde5u,
+   0xe7b7badfu, 0x49df2b4eu, 0x60179fbcu, 0xce7f0e2du, 0x3386f658u, 0x9dee67c9u, 0xb426d33bu, 0x1a4e42aau,
+   0x65bc6073u, 0xcbd4f1e2u, 0xe21c4510u, 0x4c74d481u, 0xb18d2cf4u, 0x1fe5bd65u, 0x362d0997u, 0x98459806u,
+   0x16afff3cu, 0xb8c76eadu, 0x910fda5fu, 0x3f674bceu, 0xc29eb3bbu, 0x6cf6222au, 0x453e96d8u, 0xeb560749u,
+   0x839b5eedu, 0x2df3cf7cu, 0x043b7b8eu, 0xaa53ea1fu, 0x57aa126au, 0xf9c283fbu, 0xd00a3709u, 0x7e62a698u,
+   0xf088c1a2u, 0x5ee05033u, 0x7728e4c1u, 0xd9407550u, 0x24b98d25u, 0x8ad11cb4u, 0xa319a846u, 0x0d7139d7u}
+};
+
+/*crc is the running CRC register, which starts at 0xffffffff and is inverted at the end.
+Does 16 bytes per step with the slice-by-16 tables.*/
+static unsigned crc32Update_tables(unsigned crc, const unsigned char* data, size_t length)
 {
-    unsigned crc = 0xffffffffu;
-    const unsigned char* current = (const unsigned char*)data;
-    while (length--)
-    {
-        unsigned char s = unsigned char(crc) ^ *current++;
-        unsigned low = (s ^ (s << 6)) & 0xFF;
-        unsigned a = (low * ((1 << 23) + (1 << 14) + (1 << 2)));
-        crc = (crc >> 8) ^
-            (low * ((1 << 24) + (1 << 16) + (1 << 8))) ^
-            a ^
-            (a >> 1) ^
-            (low * ((1 << 20) + (1 << 12))) ^
-            (low << 19) ^
-            (low << 17) ^
-            (low >> 2);
-    }
-    return ~crc;
+  const unsigned (*table)[256] = CRC32_TABLE;
+  for(; length >= 16; length -= 16, data += 16)
+  {
+    unsigned a = readLE32(data) ^ crc;
+    unsigned b = readLE32(data + 4);
+    unsigned c = readLE32(data + 8);
+    unsigned d = readLE32(data + 12);
+    crc = table[15][a & 255u] ^ table[14][(a >> 8) & 255u] ^ table[13][(a >> 16) & 255u] ^ table[12][a >> 24]
+        ^ table[11][b & 255u] ^ table[10][(b >> 8) & 255u] ^ table[9][(b >> 16) & 255u] ^ table[8][b >> 24]
+        ^ table[7][c & 255u] ^ table[6][(c >> 8) & 255u] ^ table[5][(c >> 16) & 255u] ^ table[4][c >> 24]
+        ^ table[3][d & 255u] ^ table[2][(d >> 8) & 255u] ^ table[1][(d >> 16) & 255u] ^ table[0][d >> 24];
+  }
+  for(size_t i = 0; i != length; ++i) crc = (crc >> 8) ^ table[0][(crc ^ data[i]) & 255u];
+  return crc;
+}
+
+#ifdef LODEPNG_COMPILE_SIMD
+/*Folds 64 bytes at a time with carry-less multiplication, then reduces to 32 bits with a Barrett
+reduction. From Intel's paper "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+Instruction", with the bit-reflected constants for this polynomial as in Chromium's zlib.
+length must be a multiple of 16 and at least 64.*/
+static LODEPNG_TARGET("sse2,pclmul") unsigned crc32Update_pclmul(unsigned crc, const unsigned char* data,
+                                                                 size_t length)
+{
+  // the 33-bit constants as pairs of 32-bit halves, low half first, without the 64-bit literals of C++11
+  const __m128i k1k2 = _mm_setr_epi32(0x54442bd4, 1, (int)0xc6e41596u, 1);
+  const __m128i k3k4 = _mm_setr_epi32(0x751997d0, 1, (int)0xccaa009eu, 0);
+  const __m128i k5 = _mm_setr_epi32(0x63cd6124, 1, 0, 0);
+  const __m128i poly = _mm_setr_epi32((int)0xdb710641u, 1, (int)0xf7011641u, 1);
+  const __m128i mask32 = _mm_setr_epi32(-1, 0, -1, 0);
+
+  __m128i x1 = _mm_loadu_si128((const __m128i*)(data + 0));
+  __m128i x2 = _mm_loadu_si128((const __m128i*)(data + 16));
+  __m128i x3 = _mm_loadu_si128((const __m128i*)(data + 32));
+  __m128i x4 = _mm_loadu_si128((const __m128i*)(data + 48));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+  data += 64;
+  length -= 64;
+
+  // four folds in parallel, 64 bytes per step
+  for(; length >= 64; length -= 64, data += 64)
+  {
+    __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(data + 0)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 16)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 32)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 48)));
+  }
+
+  // fold the four into one, then any remaining 16 byte blocks into that
+  __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+  for(; length >= 16; length -= 16, data += 16)
+  {
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)data)), x5);
+  }
+
+  // 128 bits to 64
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5, 0x00), x2);
+
+  // Barrett reduction to 32 bits
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+#endif // LODEPNG_COMPILE_SIMD
+
+// Updates the running CRC register crc with the data, with the fastest method the CPU has.
+static unsigned crc32Update(unsigned crc, const unsigned char* data, size_t length)
+{
+#ifdef LODEPNG_COMPILE_SIMD
+  const unsigned needed = LODEPNG_CPU_SSE2 | LODEPNG_CPU_PCLMUL;
+  if(length >= 64 && (getCpuFeatures() & needed) == needed)
+  {
+    size_t blocks = length & ~(size_t)15;
+    crc = crc32Update_pclmul(crc, data, blocks);
+    data += blocks;
+    length -= blocks;
+  }
+#endif // LODEPNG_COMPILE_SIMD
+  return crc32Update_tables(crc, data, length);
+}
+
+// compute CRC32 of the data. Polynomial: 0xedb88320
+static unsigned lodepng_crc32(const void* data, size_t length)
+{
+  return ~crc32Update(0xffffffffu, (const unsigned char*)data, length);
 }
 
 
@@ -2177,17 +4050,6 @@ static unsigned readBitsFromReversedStream(size_t* bitpointer, const unsigned ch
   return result;
 }
 
-static void setBitOfReversedStream0(size_t* bitpointer, unsigned char* bitstream, unsigned char bit)
-{
-  // the current bit in bitstream must be 0 for this to work
-  if(bit)
-  {
-    // earlier bit of huffman code is in a lesser significant bit of an earlier byte
-    bitstream[(*bitpointer) >> 3] |= (bit << (7 - ((*bitpointer) & 0x7)));
-  }
-  ++(*bitpointer);
-}
-
 static void setBitOfReversedStream(size_t* bitpointer, unsigned char* bitstream, unsigned char bit)
 {
   // the current bit in bitstream may be 0 or 1 for this to work
@@ -2196,17 +4058,231 @@ static void setBitOfReversedStream(size_t* bitpointer, unsigned char* bitstream,
   ++(*bitpointer);
 }
 
-//////////////////////////////////////////////////////////////////////////// 
-/// PNG chunks                                                             / 
-//////////////////////////////////////////////////////////////////////////// 
+/*Copies numbits bits from the start of in to bit position outbit of out, in both the first bit is the
+most significant bit of a byte. The bits of out around the copied range are left as they are.*/
+static void copyBitsToReversedStream(unsigned char* out, size_t outbit, const unsigned char* in, size_t numbits)
+{
+  size_t numbytes = numbits >> 3;
+  unsigned rest = (unsigned)(numbits & 7u);
+  unsigned shift = (unsigned)(outbit & 7u);
+  out += outbit >> 3;
+  if(shift == 0)
+  {
+    memcpy(out, in, numbytes);
+    if(rest)
+    {
+      unsigned char mask = (unsigned char)(0xff00u >> rest);
+      out[numbytes] = (unsigned char)((out[numbytes] & ~mask) | (in[numbytes] & mask));
+    }
+    return;
+  }
 
-// The lodepng_chunk functions are normally not needed, except to traverse the
-// unknown chunks stored in the LodePNGInfo struct, or add new ones to it.
-// It also allows traversing the chunks of an encoded PNG file yourself.
-// 
-// PNG standard chunk naming conventions:
-// First byte: uppercase = critical, lowercase = ancillary
-// Second byte: uppercase = public, lowercase = private
+  // each input byte gives the low 8 - shift bits of one output byte and the high shift bits of the next
+  unsigned acc = out[0] & (0xff00u >> shift);
+  size_t i = 0;
+  for(; i + 8 <= numbytes; i += 8) // the same with 8 bytes at a time
+  {
+    uint64_t v = lodepng_read64bitInt(in + i);
+    lodepng_set64bitInt(out + i, ((uint64_t)acc << 56) | (v >> shift));
+    acc = (unsigned)(v << (8 - shift)) & 255u;
+  }
+  for(; i != numbytes; ++i)
+  {
+    out[i] = (unsigned char)(acc | (in[i] >> shift));
+    acc = (in[i] << (8 - shift)) & 255u;
+  }
+  // acc has shift bits in its high bits, followed by the rest bits of the last partial input byte
+  unsigned last = rest ? in[numbytes] & (0xff00u >> rest) : 0;
+  unsigned total = shift + rest;
+  acc |= last >> shift;
+  if(total <= 8)
+  {
+    unsigned char mask = (unsigned char)(0xff00u >> total);
+    out[numbytes] = (unsigned char)((out[numbytes] & ~mask) | (acc & mask));
+  }
+  else
+  {
+    unsigned char mask = (unsigned char)(0xff00u >> (total - 8));
+    out[numbytes] = (unsigned char)acc;
+    out[numbytes + 1] = (unsigned char)((out[numbytes + 1] & ~mask) | ((last << (8 - shift)) & mask));
+  }
+}
+
+/*Copies numbits bits from bit position inbit of in to the start of out, the opposite of
+copyBitsToReversedStream. The bits after them in the last byte of out are set to 0. Only the bytes of
+in that have bits of the range are read.*/
+static void copyBitsFromReversedStream(unsigned char* out, const unsigned char* in, size_t inbit, size_t numbits)
+{
+  size_t numbytes = (numbits + 7) >> 3;
+  unsigned shift = (unsigned)(inbit & 7u);
+  in += inbit >> 3;
+  if(numbytes == 0) return;
+  if(shift == 0) memcpy(out, in, numbytes);
+  else
+  {
+    // each output byte has the low 8 - shift bits of an input byte and the high shift bits of the next
+    size_t inbytes = (shift + numbits + 7) >> 3;
+    size_t i = 0;
+    for(; i + 9 <= inbytes; i += 8)
+    {
+      uint64_t v = lodepng_read64bitInt(in + i);
+      lodepng_set64bitInt(out + i, (v << shift) | (in[i + 8] >> (8 - shift)));
+    }
+    for(; i != numbytes; ++i)
+    {
+      out[i] = (unsigned char)((in[i] << shift) | (i + 1 < inbytes ? in[i + 1] >> (8 - shift) : 0));
+    }
+  }
+  if(numbits & 7u) out[numbytes - 1] &= (unsigned char)(0xff00u >> (numbits & 7u));
+}
+
+/*The samples of 1, 2 or 4 bits of a nibble, [log2 of bits][nibble], a byte each from the top of the
+32 bits. The samples of a byte are those of its high nibble followed by those of its low nibble.*/
+static const unsigned UNPACK_NIBBLE[3][16] = {
+  {0x00000000u, 0x00000001u, 0x00000100u, 0x00000101u, 0x00010000u, 0x00010001u, 0x00010100u, 0x00010101u,
+   0x01000000u, 0x01000001u, 0x01000100u, 0x01000101u, 0x01010000u, 0x01010001u, 0x01010100u, 0x01010101u},
+  {0x00000000u, 0x00010000u, 0x00020000u, 0x00030000u, 0x01000000u, 0x01010000u, 0x01020000u, 0x01030000u,
+   0x02000000u, 0x02010000u, 0x02020000u, 0x02030000u, 0x03000000u, 0x03010000u, 0x03020000u, 0x03030000u},
+  {0x00000000u, 0x01000000u, 0x02000000u, 0x03000000u, 0x04000000u, 0x05000000u, 0x06000000u, 0x07000000u,
+   0x08000000u, 0x09000000u, 0x0a000000u, 0x0b000000u, 0x0c000000u, 0x0d000000u, 0x0e000000u, 0x0f000000u}
+};
+
+// the byte with its bits in the reverse order
+static const unsigned char REVERSE_BITS[256] = {
+  0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0, 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+  0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8, 0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
+  0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4, 0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
+  0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec, 0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
+  0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2, 0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
+  0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea, 0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
+  0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6, 0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
+  0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee, 0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
+  0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1, 0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
+  0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9, 0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
+  0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5, 0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
+  0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed, 0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
+  0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3, 0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
+  0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb, 0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
+  0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7, 0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
+  0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef, 0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff
+};
+
+#ifdef LODEPNG_COMPILE_SIMD
+// unpackBits for 1 bit, 16 bytes of in at a time. Returns amount of bytes of in done
+static LODEPNG_TARGET("ssse3") size_t unpackBits1_ssse3(unsigned char* out, const unsigned char* in,
+                                                        size_t numbytes, unsigned scale)
+{
+  const __m128i bits = _mm_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+  const __m128i value = _mm_set1_epi8((char)scale);
+  const __m128i two = _mm_set1_epi8(2);
+  size_t j = 0;
+  for(; j + 16 <= numbytes; j += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(in + j));
+    __m128i index = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    for(unsigned k = 0; k != 8; ++k)
+    {
+      __m128i y = _mm_shuffle_epi8(x, index); // 2 bytes, each repeated for its 8 pixels
+      y = _mm_cmpeq_epi8(_mm_and_si128(y, bits), bits);
+      _mm_storeu_si128((__m128i*)(out + (j + k * 2) * 8), _mm_and_si128(y, value));
+      index = _mm_add_epi8(index, two);
+    }
+  }
+  return j;
+}
+
+// packBits for 1 bit, 16 pixels at a time. Returns amount of bytes of out done
+static LODEPNG_TARGET("sse2") size_t packBits1_sse2(unsigned char* out, const unsigned char* in,
+                                                    size_t numbytes, unsigned shift)
+{
+  const __m128i count = _mm_cvtsi32_si128((int)(7 - shift));
+  size_t j = 0;
+  for(; j + 2 <= numbytes; j += 2)
+  {
+    // the bit at shift of each byte to its top bit, gathered with the first pixel in the lowest bit
+    __m128i x = _mm_sll_epi16(_mm_loadu_si128((const __m128i*)(in + j * 8)), count);
+    unsigned m = (unsigned)_mm_movemask_epi8(x);
+    out[j] = REVERSE_BITS[m & 255u];
+    out[j + 1] = REVERSE_BITS[m >> 8];
+  }
+  return j;
+}
+#endif // LODEPNG_COMPILE_SIMD
+
+// the samples of BITS bits of a byte with UNPACK_NIBBLE, a byte each from the top of the 64 bits
+template<unsigned BITS>
+static uint64_t unpackByte(unsigned char v)
+{
+  const unsigned* table = UNPACK_NIBBLE[BITS == 1 ? 0 : BITS == 2 ? 1 : 2];
+  return ((uint64_t)table[v >> 4] << 32) | ((uint64_t)table[v & 15u] << (32 - 32 / BITS));
+}
+
+/*Unpacks numpixels samples of BITS bits, 1, 2 or 4, to a byte each, a byte of in at a time with
+unpackByte. Samples are multiplied by scale, 1 for palette indices, 255 / (2^BITS - 1) for grey.*/
+template<unsigned BITS>
+static void unpackBits(unsigned char* out, const unsigned char* in, size_t numpixels, unsigned scale)
+{
+  const unsigned perbyte = 8 / BITS;
+  size_t numbytes = numpixels / perbyte, j = 0;
+#ifdef LODEPNG_COMPILE_SIMD
+  if(BITS == 1 && numbytes >= 16 && (getCpuFeatures() & LODEPNG_CPU_SSSE3))
+  {
+    j = unpackBits1_ssse3(out, in, numbytes, scale);
+  }
+#endif // LODEPNG_COMPILE_SIMD
+  for(; j != numbytes; ++j)
+  {
+    uint64_t samples = unpackByte<BITS>(in[j]) * scale; // the scaled samples still fit in their byte
+    for(unsigned k = 0; k != perbyte; ++k) out[j * perbyte + k] = (unsigned char)(samples >> (56 - 8 * k));
+  }
+  unsigned rest = (unsigned)(numpixels % perbyte);
+  if(rest)
+  {
+    uint64_t samples = unpackByte<BITS>(in[numbytes]) * scale;
+    for(unsigned k = 0; k != rest; ++k) out[numbytes * perbyte + k] = (unsigned char)(samples >> (56 - 8 * k));
+  }
+}
+
+/*Packs numpixels bytes to samples of BITS bits, 1, 2 or 4, taking the BITS bits from bit shift up of
+each byte: shift 0 for palette indices, 8 - BITS for the highest bits of grey. The padding bits of the
+last byte are 0.*/
+template<unsigned BITS>
+static void packBits(unsigned char* out, const unsigned char* in, size_t numpixels, unsigned shift)
+{
+  const unsigned perbyte = 8 / BITS;
+  const unsigned mask = (1u << BITS) - 1u;
+  size_t numbytes = numpixels / perbyte, j = 0;
+#ifdef LODEPNG_COMPILE_SIMD
+  if(BITS == 1 && numbytes >= 2 && (getCpuFeatures() & LODEPNG_CPU_SSE2)) j = packBits1_sse2(out, in, numbytes, shift);
+#endif // LODEPNG_COMPILE_SIMD
+  for(; j != numbytes; ++j)
+  {
+    const unsigned char* pixels = &in[j * perbyte];
+    unsigned byte = 0;
+    for(unsigned k = 0; k != perbyte; ++k) byte = (byte << BITS) | ((pixels[k] >> shift) & mask);
+    out[j] = (unsigned char)byte;
+  }
+  unsigned rest = (unsigned)(numpixels % perbyte);
+  if(rest)
+  {
+    const unsigned char* pixels = &in[numbytes * perbyte];
+    unsigned byte = 0;
+    for(unsigned k = 0; k != rest; ++k) byte |= ((pixels[k] >> shift) & mask) << (8 - BITS * (k + 1));
+    out[numbytes] = (unsigned char)byte;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////// 
+/// PNG chunks                                                             / 
+//////////////////////////////////////////////////////////////////////////// 
+
+// The lodepng_chunk functions are normally not needed, except to traverse the
+// unknown chunks stored in the LodePNGInfo struct, or add new ones to it.
+// It also allows traversing the chunks of an encoded PNG file yourself.
+// 
+// PNG standard chunk naming conventions:
+// First byte: uppercase = critical, lowercase = ancillary
+// Second byte: uppercase = public, lowercase = private
 // Third byte: must be uppercase
 // Fourth byte: uppercase = unsafe to copy, lowercase = safe to copy
 
@@ -2238,6 +4314,14 @@ void lodepng_chunk_generate_crc(unsigned char* chunk)
   lodepng_set32bitInt(chunk + 8 + length, CRC);
 }
 
+// returns 1 if the CRC of the chunk is wrong, 0 if it's correct
+unsigned lodepng_chunk_check_crc(const unsigned char* chunk)
+{
+  unsigned length = lodepng_chunk_length(chunk);
+  unsigned CRC = lodepng_read32bitInt(&chunk[length + 8]);
+  return CRC != lodepng_crc32(&chunk[4], length + 4);
+}
+
 const unsigned char* lodepng_chunk_next_const(const unsigned char* chunk)
 {
   unsigned total_chunk_length = lodepng_chunk_length(chunk) + 12;
@@ -2324,6 +4408,7 @@ void lodepng_color_mode_init(LodePNGColorMode* info)
   info->key_r = info->key_g = info->key_b = 0;
   info->colortype = LCT_RGBA;
   info->bitdepth = 8;
+  info->sampleformat = LSF_BIG_ENDIAN;
   info->palette = 0;
   info->palettesize = 0;
 }
@@ -2347,7 +4432,8 @@ unsigned lodepng_color_mode_copy(LodePNGColorMode* dest, const LodePNGColorMode*
   return 0;
 }
 
-static int lodepng_color_mode_equal(const LodePNGColorMode* a, const LodePNGColorMode* b)
+// whether the modes have the same pixels, but maybe with their samples in another format
+static int lodepng_color_mode_equal_pixels(const LodePNGColorMode* a, const LodePNGColorMode* b)
 {
   size_t i;
   if(a->colortype != b->colortype) return 0;
@@ -2367,6 +4453,11 @@ static int lodepng_color_mode_equal(const LodePNGColorMode* a, const LodePNGColo
   return 1;
 }
 
+static int lodepng_color_mode_equal(const LodePNGColorMode* a, const LodePNGColorMode* b)
+{
+  return a->sampleformat == b->sampleformat && lodepng_color_mode_equal_pixels(a, b);
+}
+
 void lodepng_palette_clear(LodePNGColorMode* info)
 {
   if(info->palette) free(info->palette);
@@ -2397,8 +4488,9 @@ unsigned lodepng_palette_add(LodePNGColorMode* info,
 
 unsigned lodepng_get_bpp(const LodePNGColorMode* info)
 {
-  // calculate bits per pixel out of colortype and bitdepth
-  return lodepng_get_bpp_lct(info->colortype, info->bitdepth);
+  // calculate bits per pixel out of colortype and bitdepth, float samples have 32 bits
+  unsigned bpp = lodepng_get_bpp_lct(info->colortype, info->bitdepth);
+  return (info->sampleformat == LSF_FLOAT && info->bitdepth == 16) ? bpp * 2 : bpp;
 }
 
 unsigned lodepng_get_channels(const LodePNGColorMode* info)
@@ -2630,47 +4722,6 @@ static unsigned rgba8ToPixel(unsigned char* out, size_t i,
   return 0; // no error
 }
 
-// put a pixel, given its RGBA16 color, into image of any color 16-bitdepth type
-static void rgba16ToPixel(unsigned char* out, size_t i,
-                         const LodePNGColorMode* mode,
-                         unsigned short r, unsigned short g, unsigned short b, unsigned short a)
-{
-  if(mode->colortype == LCT_GREY)
-  {
-    unsigned short grey = r; /*((unsigned)r + g + b) / 3*/;
-    out[i * 2 + 0] = (grey >> 8) & 255;
-    out[i * 2 + 1] = grey & 255;
-  }
-  else if(mode->colortype == LCT_RGB)
-  {
-    out[i * 6 + 0] = (r >> 8) & 255;
-    out[i * 6 + 1] = r & 255;
-    out[i * 6 + 2] = (g >> 8) & 255;
-    out[i * 6 + 3] = g & 255;
-    out[i * 6 + 4] = (b >> 8) & 255;
-    out[i * 6 + 5] = b & 255;
-  }
-  else if(mode->colortype == LCT_GREY_ALPHA)
-  {
-    unsigned short grey = r; /*((unsigned)r + g + b) / 3*/;
-    out[i * 4 + 0] = (grey >> 8) & 255;
-    out[i * 4 + 1] = grey & 255;
-    out[i * 4 + 2] = (a >> 8) & 255;
-    out[i * 4 + 3] = a & 255;
-  }
-  else if(mode->colortype == LCT_RGBA)
-  {
-    out[i * 8 + 0] = (r >> 8) & 255;
-    out[i * 8 + 1] = r & 255;
-    out[i * 8 + 2] = (g >> 8) & 255;
-    out[i * 8 + 3] = g & 255;
-    out[i * 8 + 4] = (b >> 8) & 255;
-    out[i * 8 + 5] = b & 255;
-    out[i * 8 + 6] = (a >> 8) & 255;
-    out[i * 8 + 7] = a & 255;
-  }
-}
-
 // Get RGBA8 color of pixel with index i (y * width + x) from the raw image with given color type.
 static void getPixelColorRGBA8(unsigned char* r, unsigned char* g,
                                unsigned char* b, unsigned char* a,
@@ -2777,141 +4828,25 @@ static void getPixelColorRGBA8(unsigned char* r, unsigned char* g,
   }
 }
 
-/*Similar to getPixelColorRGBA8, but with all the for loops inside of the color
-mode test cases, optimized to convert the colors much faster, when converting
-to RGBA or RGB with 8 bit per channel. buffer must be RGBA or RGB output with
-enough memory, if has_alpha is true the output is RGBA. mode has the color mode
-of the input buffer.*/
-static void getPixelColorsRGBA8(unsigned char* buffer, size_t numpixels,
-                                unsigned has_alpha, const unsigned char* in,
-                                const LodePNGColorMode* mode)
+/*Gets the color key of mode as the bytes a pixel has in a grey or RGB image of 8 or 16 bits, so
+that testing a pixel against it is a single compare. Returns 0 if no pixel can match: there is
+no key, or a key value doesn't fit in the bit depth.*/
+static unsigned getKeyBytes(unsigned char* key, const LodePNGColorMode* mode)
 {
-  unsigned num_channels = has_alpha ? 4 : 3;
-  size_t i;
-  if(mode->colortype == LCT_GREY)
-  {
-    if(mode->bitdepth == 8)
-    {
-      for(i = 0; i != numpixels; ++i, buffer += num_channels)
-      {
-        buffer[0] = buffer[1] = buffer[2] = in[i];
-        if(has_alpha) buffer[3] = mode->key_defined && in[i] == mode->key_r ? 0 : 255;
-      }
-    }
-    else if(mode->bitdepth == 16)
-    {
-      for(i = 0; i != numpixels; ++i, buffer += num_channels)
-      {
-        buffer[0] = buffer[1] = buffer[2] = in[i * 2];
-        if(has_alpha) buffer[3] = mode->key_defined && 256U * in[i * 2 + 0] + in[i * 2 + 1] == mode->key_r ? 0 : 255;
-      }
-    }
-    else
-    {
-      unsigned highest = ((1U << mode->bitdepth) - 1U); // highest possible value for this bit depth
-      size_t j = 0;
-      for(i = 0; i != numpixels; ++i, buffer += num_channels)
-      {
-        unsigned value = readBitsFromReversedStream(&j, in, mode->bitdepth);
-        buffer[0] = buffer[1] = buffer[2] = (value * 255) / highest;
-        if(has_alpha) buffer[3] = mode->key_defined && value == mode->key_r ? 0 : 255;
-      }
-    }
-  }
-  else if(mode->colortype == LCT_RGB)
-  {
-    if(mode->bitdepth == 8)
-    {
-      for(i = 0; i != numpixels; ++i, buffer += num_channels)
-      {
-        buffer[0] = in[i * 3 + 0];
-        buffer[1] = in[i * 3 + 1];
-        buffer[2] = in[i * 3 + 2];
-        if(has_alpha) buffer[3] = mode->key_defined && buffer[0] == mode->key_r
-           && buffer[1]== mode->key_g && buffer[2] == mode->key_b ? 0 : 255;
-      }
-    }
-    else
-    {
-      for(i = 0; i != numpixels; ++i, buffer += num_channels)
-      {
-        buffer[0] = in[i * 6 + 0];
-        buffer[1] = in[i * 6 + 2];
-        buffer[2] = in[i * 6 + 4];
-        if(has_alpha) buffer[3] = mode->key_defined
-           && 256U * in[i * 6 + 0] + in[i * 6 + 1] == mode->key_r
-           && 256U * in[i * 6 + 2] + in[i * 6 + 3] == mode->key_g
-           && 256U * in[i * 6 + 4] + in[i * 6 + 5] == mode->key_b ? 0 : 255;
-      }
-    }
-  }
-  else if(mode->colortype == LCT_PALETTE)
-  {
-    unsigned index;
-    size_t j = 0;
-    for(i = 0; i != numpixels; ++i, buffer += num_channels)
-    {
-      if(mode->bitdepth == 8) index = in[i];
-      else index = readBitsFromReversedStream(&j, in, mode->bitdepth);
-
-      if(index >= mode->palettesize)
-      {
-        /*This is an error according to the PNG spec, but most PNG decoders make it black instead.
-        Done here too, slightly faster due to no error handling needed.*/
-        buffer[0] = buffer[1] = buffer[2] = 0;
-        if(has_alpha) buffer[3] = 255;
-      }
-      else
-      {
-        buffer[0] = mode->palette[index * 4 + 0];
-        buffer[1] = mode->palette[index * 4 + 1];
-        buffer[2] = mode->palette[index * 4 + 2];
-        if(has_alpha) buffer[3] = mode->palette[index * 4 + 3];
-      }
-    }
-  }
-  else if(mode->colortype == LCT_GREY_ALPHA)
-  {
-    if(mode->bitdepth == 8)
-    {
-      for(i = 0; i != numpixels; ++i, buffer += num_channels)
-      {
-        buffer[0] = buffer[1] = buffer[2] = in[i * 2 + 0];
-        if(has_alpha) buffer[3] = in[i * 2 + 1];
-      }
-    }
-    else
-    {
-      for(i = 0; i != numpixels; ++i, buffer += num_channels)
-      {
-        buffer[0] = buffer[1] = buffer[2] = in[i * 4 + 0];
-        if(has_alpha) buffer[3] = in[i * 4 + 2];
-      }
-    }
-  }
-  else if(mode->colortype == LCT_RGBA)
+  unsigned values[3] = {mode->key_r, mode->key_g, mode->key_b};
+  unsigned num = mode->colortype == LCT_RGB ? 3 : 1;
+  if(!mode->key_defined) return 0;
+  for(unsigned c = 0; c != num; ++c)
   {
-    if(mode->bitdepth == 8)
-    {
-      for(i = 0; i != numpixels; ++i, buffer += num_channels)
-      {
-        buffer[0] = in[i * 4 + 0];
-        buffer[1] = in[i * 4 + 1];
-        buffer[2] = in[i * 4 + 2];
-        if(has_alpha) buffer[3] = in[i * 4 + 3];
-      }
-    }
+    if(values[c] >> mode->bitdepth) return 0;
+    if(mode->bitdepth == 8) key[c] = (unsigned char)values[c];
     else
     {
-      for(i = 0; i != numpixels; ++i, buffer += num_channels)
-      {
-        buffer[0] = in[i * 8 + 0];
-        buffer[1] = in[i * 8 + 2];
-        buffer[2] = in[i * 8 + 4];
-        if(has_alpha) buffer[3] = in[i * 8 + 6];
-      }
+      key[c * 2 + 0] = (unsigned char)(values[c] >> 8);
+      key[c * 2 + 1] = (unsigned char)(values[c] & 255);
     }
   }
+  return 1;
 }
 
 /*Get RGBA16 color of pixel with index i (y * width + x) from the raw image with
@@ -2950,107 +4885,747 @@ static void getPixelColorRGBA16(unsigned short* r, unsigned short* g, unsigned s
   }
 }
 
-unsigned lodepng_convert(unsigned char* out, const unsigned char* in,
-                         const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
-                         unsigned w, unsigned h)
+// converts numpixels pixels of one color mode pair, see getConvertKernel
+typedef void (*ConvertKernel)(unsigned char* out, const unsigned char* in, size_t numpixels);
+
+typedef struct ColorConvert ColorConvert;
+// reads numpixels pixels as RGBA of 8 or 16 bits per channel, see getReadRGBA
+typedef void (*ReadRGBAFunc)(unsigned char* rgba, const unsigned char* in, size_t numpixels,
+                             const ColorConvert* convert);
+// writes numpixels pixels from RGBA, see getWriteRGBA. return value is error
+typedef unsigned (*WriteRGBAFunc)(unsigned char* out, const unsigned char* rgba, size_t numpixels,
+                                  ColorConvert* convert);
+
+/*Converts pixels from one color mode to another, any amount of pixels at a time: lodepng_convert
+converts whole images with it, the decoder single scanlines.*/
+struct ColorConvert
 {
-  size_t i;
+  const LodePNGColorMode* mode_out;
+  const LodePNGColorMode* mode_in;
+  unsigned copy; // the modes are equal, the bytes are copied literally
+  unsigned indices; // palette in and out, the indices are kept but change bit depth
+  unsigned usetree; // palette output, tree gives the palette index of each color
   ColorTree tree;
-  size_t numpixels = w * h;
-  unsigned error = 0;
+  unsigned char* colors; // palette or grey input of up to 8 bits: the table of makeColorTable, or 0
+  ConvertKernel kernel; // vectorized conversion of this mode pair, or 0
+  /*otherwise pixels go through RGBA: read gives them as RGBA with 16 bits per channel if both modes
+  have 16 bits, 8 otherwise, and write puts them in the output, or is 0 if RGBA is the output*/
+  ReadRGBAFunc read;
+  WriteRGBAFunc write;
+  unsigned char key[6]; // the color key of mode_in for read, see getKeyBytes
+  LodePNGSampleFormat sampleformat; // of mode_out, the samples are converted big endian and then stored in it
+  unsigned storeonly; // the modes only differ in sample format, the samples of in are stored as they are
+};
+
+/*Makes the table for converting palette or greyscale input of up to 8 bits: for each value of an
+input byte, the RGBA8 colors of the 8 / bitdepth pixels in it, 4 bytes per pixel. That is one
+lookup per byte instead of a palette read and bit depth test per pixel, and it keeps the colors
+of getPixelColorRGBA8, including black for indices outside the palette and the color key. Returns
+0 for other color modes, or if out of memory, then the pixels are converted one by one as before.*/
+static unsigned char* makeColorTable(const LodePNGColorMode* mode)
+{
+  if(mode->bitdepth > 8 || (mode->colortype != LCT_PALETTE && mode->colortype != LCT_GREY)) return 0;
+  unsigned bits = mode->bitdepth, perbyte = 8 / bits;
+  unsigned char* table = (unsigned char*)malloc(256 * perbyte * 4);
+  if(!table) return 0;
 
-  if(lodepng_color_mode_equal(mode_out, mode_in))
+  unsigned char colors[256 * 4]; // RGBA of each pixel value
+  for(unsigned v = 0; v != (1u << bits); ++v)
   {
-    size_t numbytes = lodepng_get_raw_size(w, h, mode_in);
-    for(i = 0; i != numbytes; ++i) out[i] = in[i];
-    return 0;
+    unsigned char byte = (unsigned char)(v << (8 - bits));
+    unsigned char* c = &colors[v * 4];
+    getPixelColorRGBA8(&c[0], &c[1], &c[2], &c[3], &byte, 0, mode);
   }
-
-  if(mode_out->colortype == LCT_PALETTE)
+  unsigned mask = (1u << bits) - 1u;
+  for(unsigned v = 0; v != 256; ++v)
   {
-    size_t palettesize = mode_out->palettesize;
-    const unsigned char* palette = mode_out->palette;
-    size_t palsize = (size_t)1u << mode_out->bitdepth;
-    /*if the user specified output palette but did not give the values, assume
-    they want the values of the input color type (assuming that one is palette).
-    Note that we never create a new palette ourselves.*/
-    if(palettesize == 0)
+    for(unsigned k = 0; k != perbyte; ++k)
     {
-      palettesize = mode_in->palettesize;
-      palette = mode_in->palette;
-      /*if the input was also palette with same bitdepth, then the color types are also
-      equal, so copy literally. This to preserve the exact indices that were in the PNG
-      even in case there are duplicate colors in the palette.*/
-      if (mode_in->colortype == LCT_PALETTE && mode_in->bitdepth == mode_out->bitdepth)
-      {
-        size_t numbytes = lodepng_get_raw_size(w, h, mode_in);
-        for(i = 0; i != numbytes; ++i) out[i] = in[i];
-        return 0;
-      }
+      unsigned value = (v >> (8 - bits * (k + 1))) & mask;
+      memcpy(&table[(v * perbyte + k) * 4], &colors[value * 4], 4);
     }
-    if(palettesize < palsize) palsize = palettesize;
-    color_tree_init(&tree);
-    for(i = 0; i != palsize; ++i)
+  }
+  return table;
+}
+
+#ifdef LODEPNG_COMPILE_SIMD
+// 8 pixels at a time, the table has one 32-bit color per byte value. Returns amount of pixels done
+static LODEPNG_TARGET("avx2") size_t expandColors_avx2(unsigned char* out, const unsigned char* in,
+                                                       size_t numpixels, const unsigned char* table)
+{
+  size_t i = 0;
+  for(; i + 8 <= numpixels; i += 8)
+  {
+    __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + i)));
+    __m256i colors = _mm256_i32gather_epi32((const int*)table, index, 4);
+    _mm256_storeu_si256((__m256i*)(out + i * 4), colors);
+  }
+  return i;
+}
+#endif // LODEPNG_COMPILE_SIMD
+
+/*Converts numpixels pixels with the table of makeColorTable to RGBA8, or RGB8 if has_alpha is 0.
+Pixels of an input byte are copied from its table entry together.*/
+static void expandColors(unsigned char* out, size_t numpixels, unsigned has_alpha,
+                         const unsigned char* in, unsigned bits, const unsigned char* table)
+{
+  size_t i = 0;
+  unsigned perbyte = 8 / bits;
+  if(has_alpha)
+  {
+    if(bits == 8)
     {
-      const unsigned char* p = &palette[i * 4];
-      color_tree_add(&tree, p[0], p[1], p[2], p[3], (unsigned)i);
+#ifdef LODEPNG_COMPILE_SIMD
+      if(numpixels >= 8 && (getCpuFeatures() & LODEPNG_CPU_AVX2)) i = expandColors_avx2(out, in, numpixels, table);
+#endif
+      for(; i != numpixels; ++i) memcpy(&out[i * 4], &table[in[i] * 4], 4);
+      return;
     }
+    size_t numbytes = numpixels / perbyte;
+    for(size_t j = 0; j != numbytes; ++j) memcpy(&out[j * perbyte * 4], &table[in[j] * perbyte * 4], perbyte * 4);
+    i = numbytes * perbyte;
+    if(i != numpixels) memcpy(&out[i * 4], &table[in[numbytes] * perbyte * 4], (numpixels - i) * 4);
   }
-
-  if(mode_in->bitdepth == 16 && mode_out->bitdepth == 16)
+  else if(numpixels != 0)
   {
-    for(i = 0; i != numpixels; ++i)
+    // 4 bytes are stored per pixel, the 4th is overwritten by the next pixel, except for the last one
+    if(bits == 8) for(; i + 1 < numpixels; ++i) memcpy(&out[i * 3], &table[in[i] * 4], 4);
+    else for(size_t j = 0; i + 1 < numpixels; ++j)
     {
-      unsigned short r = 0, g = 0, b = 0, a = 0;
-      getPixelColorRGBA16(&r, &g, &b, &a, in, i, mode_in);
-      rgba16ToPixel(out, i, mode_out, r, g, b, a);
+      const unsigned char* colors = &table[in[j] * perbyte * 4];
+      for(unsigned k = 0; k != perbyte && i + 1 < numpixels; ++k, ++i) memcpy(&out[i * 3], &colors[k * 4], 4);
     }
+    memcpy(&out[i * 3], &table[(in[i / perbyte] * perbyte + i % perbyte) * 4], 3);
   }
-  else if(mode_out->bitdepth == 8 && mode_out->colortype == LCT_RGBA)
+}
+
+#ifdef LODEPNG_COMPILE_SIMD
+/*SIMD conversions between the common 8- and 16-bit color modes, each pixel a byte shuffle of the
+input. Loads and stores stay inside the numpixels pixels of in and out, the pixels at the end
+that don't fill a vector are converted one at a time.*/
+
+static LODEPNG_TARGET("ssse3") void convertRGB8ToRGBA8_ssse3(unsigned char* out, const unsigned char* in,
+                                                             size_t numpixels)
+{
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha = _mm_set1_epi32((int)0xff000000u);
+  size_t i = 0;
+  for(; i + 6 <= numpixels; i += 4) // 16 bytes are loaded for 4 pixels
   {
-    getPixelColorsRGBA8(out, numpixels, 1, in, mode_in);
+    __m128i x = _mm_loadu_si128((const __m128i*)(in + i * 3));
+    _mm_storeu_si128((__m128i*)(out + i * 4), _mm_or_si128(_mm_shuffle_epi8(x, shuffle), alpha));
   }
-  else if(mode_out->bitdepth == 8 && mode_out->colortype == LCT_RGB)
+  for(; i != numpixels; ++i)
   {
-    getPixelColorsRGBA8(out, numpixels, 0, in, mode_in);
+    out[i * 4 + 0] = in[i * 3 + 0];
+    out[i * 4 + 1] = in[i * 3 + 1];
+    out[i * 4 + 2] = in[i * 3 + 2];
+    out[i * 4 + 3] = 255;
   }
-  else
+}
+
+static LODEPNG_TARGET("ssse3") void convertRGBA8ToRGB8_ssse3(unsigned char* out, const unsigned char* in,
+                                                             size_t numpixels)
+{
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  size_t i = 0;
+  for(; i + 4 <= numpixels; i += 4)
   {
-    unsigned char r = 0, g = 0, b = 0, a = 0;
-    for(i = 0; i != numpixels; ++i)
-    {
-      getPixelColorRGBA8(&r, &g, &b, &a, in, i, mode_in);
-      error = rgba8ToPixel(out, i, mode_out, &tree, r, g, b, a);
-      if (error) break;
-    }
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i * 4)), shuffle);
+    int last = _mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+    _mm_storel_epi64((__m128i*)(out + i * 3), x);
+    memcpy(out + i * 3 + 8, &last, 4);
   }
+  for(; i != numpixels; ++i)
+  {
+    out[i * 3 + 0] = in[i * 4 + 0];
+    out[i * 3 + 1] = in[i * 4 + 1];
+    out[i * 3 + 2] = in[i * 4 + 2];
+  }
+}
 
-  if(mode_out->colortype == LCT_PALETTE)
+static LODEPNG_TARGET("sse2") void convertGrey8ToRGBA8_sse2(unsigned char* out, const unsigned char* in,
+                                                            size_t numpixels)
+{
+  const __m128i alpha = _mm_set1_epi32((int)0xff000000u);
+  size_t i = 0;
+  for(; i + 16 <= numpixels; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+    __m128i lo = _mm_unpacklo_epi8(x, x), hi = _mm_unpackhi_epi8(x, x);
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 0), _mm_or_si128(_mm_unpacklo_epi16(lo, lo), alpha));
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 16), _mm_or_si128(_mm_unpackhi_epi16(lo, lo), alpha));
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 32), _mm_or_si128(_mm_unpacklo_epi16(hi, hi), alpha));
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 48), _mm_or_si128(_mm_unpackhi_epi16(hi, hi), alpha));
+  }
+  for(; i != numpixels; ++i)
   {
-    color_tree_cleanup(&tree);
+    out[i * 4 + 0] = out[i * 4 + 1] = out[i * 4 + 2] = in[i];
+    out[i * 4 + 3] = 255;
   }
+}
 
-  return error;
+static LODEPNG_TARGET("ssse3") void convertGreyAlpha8ToRGBA8_ssse3(unsigned char* out, const unsigned char* in,
+                                                                   size_t numpixels)
+{
+  const __m128i lo = _mm_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+  const __m128i hi = _mm_setr_epi8(8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+  size_t i = 0;
+  for(; i + 8 <= numpixels; i += 8)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(in + i * 2));
+    _mm_storeu_si128((__m128i*)(out + i * 4), _mm_shuffle_epi8(x, lo));
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 16), _mm_shuffle_epi8(x, hi));
+  }
+  for(; i != numpixels; ++i)
+  {
+    out[i * 4 + 0] = out[i * 4 + 1] = out[i * 4 + 2] = in[i * 2 + 0];
+    out[i * 4 + 3] = in[i * 2 + 1];
+  }
 }
 
+// keeps the high byte of each big endian sample, which is the first one
+static LODEPNG_TARGET("sse2") void convertRGBA16ToRGBA8_sse2(unsigned char* out, const unsigned char* in,
+                                                             size_t numpixels)
+{
+  const __m128i mask = _mm_set1_epi16(255);
+  size_t i = 0;
+  for(; i + 4 <= numpixels; i += 4)
+  {
+    __m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i*)(in + i * 8)), mask);
+    __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i*)(in + i * 8 + 16)), mask);
+    _mm_storeu_si128((__m128i*)(out + i * 4), _mm_packus_epi16(a, b));
+  }
+  for(; i != numpixels; ++i)
+  {
+    for(unsigned c = 0; c != 4; ++c) out[i * 4 + c] = in[i * 8 + c * 2];
+  }
+}
 
-void lodepng_color_profile_init(LodePNGColorProfile* profile)
+static LODEPNG_TARGET("ssse3") void convertRGB16ToRGBA16_ssse3(unsigned char* out, const unsigned char* in,
+                                                               size_t numpixels)
 {
-  profile->colored = 0;
-  profile->key = 0;
-  profile->key_r = profile->key_g = profile->key_b = 0;
-  profile->alpha = 0;
-  profile->numcolors = 0;
-  profile->bits = 1;
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+  const __m128i alpha = _mm_set_epi32((int)0xffff0000u, 0, (int)0xffff0000u, 0);
+  size_t i = 0;
+  for(; i + 3 <= numpixels; i += 2) // 16 bytes are loaded for 2 pixels
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(in + i * 6));
+    _mm_storeu_si128((__m128i*)(out + i * 8), _mm_or_si128(_mm_shuffle_epi8(x, shuffle), alpha));
+  }
+  for(; i != numpixels; ++i)
+  {
+    for(unsigned c = 0; c != 6; ++c) out[i * 8 + c] = in[i * 6 + c];
+    out[i * 8 + 6] = out[i * 8 + 7] = 255;
+  }
 }
 
-// function used for debug purposes with C++
-/*void printColorProfile(LodePNGColorProfile* p)
+static LODEPNG_TARGET("ssse3") void convertRGBA16ToRGB16_ssse3(unsigned char* out, const unsigned char* in,
+                                                               size_t numpixels)
 {
-  std::cout << "colored: " << (int)p->colored << ", ";
-  std::cout << "key: " << (int)p->key << ", ";
-  std::cout << "key_r: " << (int)p->key_r << ", ";
-  std::cout << "key_g: " << (int)p->key_g << ", ";
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+  size_t i = 0;
+  for(; i + 2 <= numpixels; i += 2)
+  {
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i * 8)), shuffle);
+    int last = _mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+    _mm_storel_epi64((__m128i*)(out + i * 6), x);
+    memcpy(out + i * 6 + 8, &last, 4);
+  }
+  for(; i != numpixels; ++i)
+  {
+    for(unsigned c = 0; c != 6; ++c) out[i * 6 + c] = in[i * 8 + c];
+  }
+}
+#endif // LODEPNG_COMPILE_SIMD
+
+// grey of 1, 2 or 4 bits to 8 bits, the key doesn't matter without alpha
+template<unsigned BITS>
+static void convertGreyBitsToGrey8(unsigned char* out, const unsigned char* in, size_t numpixels)
+{
+  unpackBits<BITS>(out, in, numpixels, 255 / ((1u << BITS) - 1u));
+}
+
+// grey of 8 bits to its highest 1, 2 or 4 bits
+template<unsigned BITS>
+static void convertGrey8ToGreyBits(unsigned char* out, const unsigned char* in, size_t numpixels)
+{
+  packBits<BITS>(out, in, numpixels, 8 - BITS);
+}
+
+/*Returns the kernel converting mode_in to mode_out if there is one for this pair and CPU, or 0 to use
+the generic conversion: the grey bit depth conversions, and SIMD ones for the common 8 and 16 bit modes,
+which don't handle inputs with a color key.*/
+static ConvertKernel getConvertKernel(const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in)
+{
+  if(mode_in->colortype == LCT_GREY && mode_out->colortype == LCT_GREY)
+  {
+    unsigned inbits = mode_in->bitdepth, outbits = mode_out->bitdepth;
+    if(outbits == 8 && inbits < 8)
+    {
+      return inbits == 1 ? convertGreyBitsToGrey8<1> : inbits == 2 ? convertGreyBitsToGrey8<2>
+                                                                   : convertGreyBitsToGrey8<4>;
+    }
+    if(inbits == 8 && outbits < 8)
+    {
+      return outbits == 1 ? convertGrey8ToGreyBits<1> : outbits == 2 ? convertGrey8ToGreyBits<2>
+                                                                     : convertGrey8ToGreyBits<4>;
+    }
+  }
+#ifdef LODEPNG_COMPILE_SIMD
+  unsigned features = getCpuFeatures();
+  LodePNGColorType in = mode_in->colortype, out = mode_out->colortype;
+  unsigned inbits = mode_in->bitdepth, outbits = mode_out->bitdepth;
+  if(mode_in->key_defined && (in == LCT_GREY || in == LCT_RGB)) return 0;
+  if(!(features & LODEPNG_CPU_SSE2)) return 0;
+  if(outbits == 8 && out == LCT_RGBA)
+  {
+    if(inbits == 16 && in == LCT_RGBA) return convertRGBA16ToRGBA8_sse2;
+    if(inbits == 8 && in == LCT_GREY) return convertGrey8ToRGBA8_sse2;
+  }
+  if(!(features & LODEPNG_CPU_SSSE3) || outbits != inbits) return 0;
+  if(inbits == 8)
+  {
+    if(in == LCT_RGB && out == LCT_RGBA) return convertRGB8ToRGBA8_ssse3;
+    if(in == LCT_RGBA && out == LCT_RGB) return convertRGBA8ToRGB8_ssse3;
+    if(in == LCT_GREY_ALPHA && out == LCT_RGBA) return convertGreyAlpha8ToRGBA8_ssse3;
+  }
+  else if(inbits == 16)
+  {
+    if(in == LCT_RGB && out == LCT_RGBA) return convertRGB16ToRGBA16_ssse3;
+    if(in == LCT_RGBA && out == LCT_RGB) return convertRGBA16ToRGB16_ssse3;
+  }
+#else // LODEPNG_COMPILE_SIMD
+  (void)mode_out;
+  (void)mode_in;
+#endif // LODEPNG_COMPILE_SIMD
+  return 0;
+}
+
+/*The generic conversion, one template instance per input and per output color mode so that the
+loops have no tests of the modes. Samples are big endian bytes everywhere, S is the amount of
+bytes per channel of the RGBA in between, 2 only if both modes have 16 bits.*/
+
+/*Reads grey, grey+alpha, RGB or RGBA of 8 or 16 bits. Without alpha, KEY tells whether the pixels
+are compared with the color key, when it is one that can match.*/
+template<LodePNGColorType CT, unsigned BITS, unsigned KEY, unsigned S>
+static void readRGBA(unsigned char* rgba, const unsigned char* in, size_t numpixels, const ColorConvert* convert)
+{
+  const unsigned colored = CT == LCT_RGB || CT == LCT_RGBA;
+  const unsigned channels = CT == LCT_GREY ? 1 : CT == LCT_GREY_ALPHA ? 2 : CT == LCT_RGB ? 3 : 4;
+  const unsigned sample = BITS / 8; // bytes per input sample
+  const unsigned bytes = channels * sample;
+  for(size_t i = 0; i != numpixels; ++i, in += bytes, rgba += 4 * S)
+  {
+    for(unsigned k = 0; k != S; ++k)
+    {
+      rgba[k] = in[k];
+      rgba[S + k] = in[(colored ? sample : 0) + k];
+      rgba[2 * S + k] = in[(colored ? 2 * sample : 0) + k];
+      if(CT == LCT_GREY_ALPHA || CT == LCT_RGBA) rgba[3 * S + k] = in[(channels - 1) * sample + k];
+      else rgba[3 * S + k] = KEY && !memcmp(in, convert->key, bytes) ? 0 : 255;
+    }
+  }
+}
+
+// reads palette or grey of up to 8 bits with the color table of makeColorTable
+static void readRGBAColorTable(unsigned char* rgba, const unsigned char* in, size_t numpixels,
+                               const ColorConvert* convert)
+{
+  expandColors(rgba, numpixels, 1, in, convert->mode_in->bitdepth, convert->colors);
+}
+
+// reads palette or grey of up to 8 bits a pixel at a time, when there was no memory for the table
+static void readRGBAPixels(unsigned char* rgba, const unsigned char* in, size_t numpixels,
+                           const ColorConvert* convert)
+{
+  for(size_t i = 0; i != numpixels; ++i, rgba += 4)
+  {
+    getPixelColorRGBA8(&rgba[0], &rgba[1], &rgba[2], &rgba[3], in, i, convert->mode_in);
+  }
+}
+
+/*Writes grey of 1 to 16 bits, grey+alpha, RGB or RGBA of 8 or 16 bits. Grey is the red channel,
+8-bit channels are repeated to make 16-bit ones and cut to their highest bits for less than 8.*/
+template<LodePNGColorType CT, unsigned BITS, unsigned S>
+static unsigned writeRGBA(unsigned char* out, const unsigned char* rgba, size_t numpixels, ColorConvert*)
+{
+  if(BITS < 8)
+  {
+    const unsigned perbyte = 8 / BITS;
+    for(size_t i = 0; i != numpixels; ++out)
+    {
+      unsigned byte = 0, shift = 8;
+      for(unsigned k = 0; k != perbyte && i != numpixels; ++k, ++i, rgba += 4)
+      {
+        shift -= BITS;
+        byte |= (unsigned)(rgba[0] >> (8 - BITS)) << shift;
+      }
+      *out = (unsigned char)byte;
+    }
+    return 0;
+  }
+  const unsigned channels = CT == LCT_GREY ? 1 : CT == LCT_GREY_ALPHA ? 2 : CT == LCT_RGB ? 3 : 4;
+  const unsigned sample = BITS / 8; // bytes per output sample
+  for(size_t i = 0; i != numpixels; ++i, out += channels * sample, rgba += 4 * S)
+  {
+    for(unsigned c = 0; c != channels; ++c)
+    {
+      unsigned from = (CT == LCT_GREY_ALPHA && c == 1) ? 3 : c; // the RGBA channel
+      for(unsigned k = 0; k != sample; ++k) out[c * sample + k] = rgba[from * S + (S == 1 ? 0 : k)];
+    }
+  }
+  return 0;
+}
+
+// writes palette indices of the colors in the palette of the output, error 82 for other colors
+static unsigned writeRGBAPalette(unsigned char* out, const unsigned char* rgba, size_t numpixels,
+                                 ColorConvert* convert)
+{
+  for(size_t i = 0; i != numpixels; ++i, rgba += 4)
+  {
+    CERROR_TRY_RETURN(rgba8ToPixel(out, i, convert->mode_out, &convert->tree, rgba[0], rgba[1], rgba[2], rgba[3]));
+  }
+  return 0;
+}
+
+// returns the reader of mode_in for RGBA of S bytes per channel, convert->key must be set
+template<unsigned S>
+static ReadRGBAFunc getReadRGBAFor(const ColorConvert* convert, unsigned key)
+{
+  const LodePNGColorMode* mode = convert->mode_in;
+  if(mode->colortype == LCT_PALETTE || mode->bitdepth < 8 || (mode->colortype == LCT_GREY && mode->bitdepth == 8))
+  {
+    return convert->colors ? readRGBAColorTable : readRGBAPixels;
+  }
+  unsigned wide = mode->bitdepth == 16;
+  switch(mode->colortype)
+  {
+    case LCT_GREY: return key ? readRGBA<LCT_GREY, 16, 1, S> : readRGBA<LCT_GREY, 16, 0, S>;
+    case LCT_RGB:
+      if(wide) return key ? readRGBA<LCT_RGB, 16, 1, S> : readRGBA<LCT_RGB, 16, 0, S>;
+      return key ? readRGBA<LCT_RGB, 8, 1, S> : readRGBA<LCT_RGB, 8, 0, S>;
+    case LCT_GREY_ALPHA: return wide ? readRGBA<LCT_GREY_ALPHA, 16, 0, S> : readRGBA<LCT_GREY_ALPHA, 8, 0, S>;
+    default: return wide ? readRGBA<LCT_RGBA, 16, 0, S> : readRGBA<LCT_RGBA, 8, 0, S>;
+  }
+}
+
+// RGBA of 16 bits is only read from 16-bit inputs
+template<>
+ReadRGBAFunc getReadRGBAFor<2>(const ColorConvert* convert, unsigned key)
+{
+  switch(convert->mode_in->colortype)
+  {
+    case LCT_GREY: return key ? readRGBA<LCT_GREY, 16, 1, 2> : readRGBA<LCT_GREY, 16, 0, 2>;
+    case LCT_RGB: return key ? readRGBA<LCT_RGB, 16, 1, 2> : readRGBA<LCT_RGB, 16, 0, 2>;
+    case LCT_GREY_ALPHA: return readRGBA<LCT_GREY_ALPHA, 16, 0, 2>;
+    default: return readRGBA<LCT_RGBA, 16, 0, 2>;
+  }
+}
+
+template<unsigned S>
+static WriteRGBAFunc getWriteRGBAFor(const LodePNGColorMode* mode)
+{
+  unsigned wide = mode->bitdepth == 16;
+  switch(mode->colortype)
+  {
+    case LCT_GREY:
+      switch(mode->bitdepth)
+      {
+        case 1: return writeRGBA<LCT_GREY, 1, S>;
+        case 2: return writeRGBA<LCT_GREY, 2, S>;
+        case 4: return writeRGBA<LCT_GREY, 4, S>;
+        case 8: return writeRGBA<LCT_GREY, 8, S>;
+        default: return writeRGBA<LCT_GREY, 16, S>;
+      }
+    case LCT_RGB: return wide ? writeRGBA<LCT_RGB, 16, S> : writeRGBA<LCT_RGB, 8, S>;
+    case LCT_GREY_ALPHA: return wide ? writeRGBA<LCT_GREY_ALPHA, 16, S> : writeRGBA<LCT_GREY_ALPHA, 8, S>;
+    case LCT_PALETTE: return writeRGBAPalette;
+    default: return (mode->bitdepth == S * 8) ? 0 : writeRGBA<LCT_RGBA, 16, S>; // RGBA of S bytes is the output
+  }
+}
+
+/*Sets the reader and writer of the conversion through RGBA, once the color table is made. Each
+mode pair gets the instances of its input and output mode.*/
+static void ColorConvert_initRGBA(ColorConvert* convert)
+{
+  const LodePNGColorMode* mode_out = convert->mode_out;
+  const LodePNGColorMode* mode_in = convert->mode_in;
+  unsigned key = (mode_in->colortype == LCT_GREY || mode_in->colortype == LCT_RGB)
+                 && mode_in->bitdepth >= 8 && getKeyBytes(convert->key, mode_in);
+  if(mode_in->bitdepth == 16 && mode_out->bitdepth == 16)
+  {
+    convert->read = getReadRGBAFor<2>(convert, key);
+    convert->write = getWriteRGBAFor<2>(mode_out);
+  }
+  else
+  {
+    convert->read = getReadRGBAFor<1>(convert, key);
+    convert->write = getWriteRGBAFor<1>(mode_out);
+  }
+}
+
+static void ColorConvert_init(ColorConvert* convert,
+                              const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in)
+{
+  convert->mode_out = mode_out;
+  convert->mode_in = mode_in;
+  convert->copy = lodepng_color_mode_equal(mode_out, mode_in);
+  convert->sampleformat = mode_out->sampleformat;
+  convert->storeonly = !convert->copy && lodepng_color_mode_equal_pixels(mode_out, mode_in);
+  convert->indices = 0;
+  convert->usetree = 0;
+  convert->colors = 0;
+  convert->kernel = 0;
+  convert->read = 0;
+  convert->write = 0;
+
+  if(!convert->copy && mode_out->colortype == LCT_PALETTE)
+  {
+    size_t palettesize = mode_out->palettesize;
+    const unsigned char* palette = mode_out->palette;
+    size_t palsize = (size_t)1u << mode_out->bitdepth;
+    /*if the user specified output palette but did not give the values, assume
+    they want the values of the input color type (assuming that one is palette).
+    Note that we never create a new palette ourselves.*/
+    if(palettesize == 0)
+    {
+      palettesize = mode_in->palettesize;
+      palette = mode_in->palette;
+      /*if the input was also palette with same bitdepth, then the color types are also
+      equal, so copy literally. This to preserve the exact indices that were in the PNG
+      even in case there are duplicate colors in the palette. With another bitdepth, the
+      indices are kept as well, without looking up their colors.*/
+      if (mode_in->colortype == LCT_PALETTE)
+      {
+        if(mode_in->bitdepth == mode_out->bitdepth) convert->copy = 1;
+        else convert->indices = 1;
+        return;
+      }
+    }
+    if(palettesize < palsize) palsize = palettesize;
+    color_tree_init(&convert->tree);
+    for(size_t i = 0; i != palsize; ++i)
+    {
+      const unsigned char* p = &palette[i * 4];
+      color_tree_add(&convert->tree, p[0], p[1], p[2], p[3], (unsigned)i);
+    }
+    convert->usetree = 1;
+  }
+  if(convert->copy || convert->storeonly) return;
+  convert->kernel = getConvertKernel(mode_out, mode_in);
+  if(convert->kernel) return;
+  convert->colors = makeColorTable(mode_in);
+  ColorConvert_initRGBA(convert);
+}
+
+static void ColorConvert_cleanup(ColorConvert* convert)
+{
+  if(convert->usetree) color_tree_cleanup(&convert->tree);
+  free(convert->colors);
+}
+
+/*Converts palette indices of inbits bits to outbits bits, e.g. unpacks indices of 1, 2 or 4 bits to a
+byte each. return value is error, 82 if an index doesn't fit in outbits*/
+static unsigned convertIndices(unsigned char* out, const unsigned char* in, size_t numpixels,
+                               unsigned outbits, unsigned inbits)
+{
+  size_t i = 0;
+  if(outbits == 8)
+  {
+    if(inbits == 1) unpackBits<1>(out, in, numpixels, 1);
+    else if(inbits == 2) unpackBits<2>(out, in, numpixels, 1);
+    else unpackBits<4>(out, in, numpixels, 1);
+    return 0;
+  }
+  if(inbits == 8)
+  {
+    unsigned used = 0; // the bits used by any index
+    for(i = 0; i != numpixels; ++i) used |= in[i];
+    if(used >> outbits) return 82; // error: an index isn't in the output palette
+    if(outbits == 1) packBits<1>(out, in, numpixels, 0);
+    else if(outbits == 2) packBits<2>(out, in, numpixels, 0);
+    else packBits<4>(out, in, numpixels, 0);
+    return 0;
+  }
+
+  size_t bp = 0;
+  for(i = 0; i != numpixels; ++i)
+  {
+    unsigned index = inbits == 8 ? in[i] : readBitsFromReversedStream(&bp, in, inbits);
+    if(index >> outbits) return 82; // error: the index isn't in the output palette
+    addColorBits(out, i, outbits, index);
+  }
+  return 0;
+}
+
+// pixels converted at a time through RGBA, a multiple of 8 so that chunks start at a byte
+#define CONVERT_CHUNK 256
+
+// ColorConvert_pixels with big endian samples in out, whatever the sample format of mode_out is
+static unsigned ColorConvert_bigEndian(ColorConvert* convert, unsigned char* out, const unsigned char* in,
+                                       size_t numpixels)
+{
+  const LodePNGColorMode* mode_out = convert->mode_out;
+  const LodePNGColorMode* mode_in = convert->mode_in;
+  size_t i;
+
+  if(convert->copy)
+  {
+    size_t numbytes = (numpixels * lodepng_get_bpp(mode_in) + 7) / 8;
+    for(i = 0; i != numbytes; ++i) out[i] = in[i];
+  }
+  else if(convert->indices)
+  {
+    return convertIndices(out, in, numpixels, mode_out->bitdepth, mode_in->bitdepth);
+  }
+  else if(convert->kernel)
+  {
+    convert->kernel(out, in, numpixels);
+  }
+  else if(convert->colors && mode_out->bitdepth == 8 && mode_out->colortype == LCT_RGB)
+  {
+    expandColors(out, numpixels, 0, in, mode_in->bitdepth, convert->colors);
+  }
+  else
+  {
+    /*in chunks of whole bytes of in and out, converted through RGBA in a buffer that stays in the
+    cache, unless the RGBA is the output itself*/
+    unsigned char rgba[CONVERT_CHUNK * 8];
+    size_t bpp_in = lodepng_get_bpp(mode_in), bpp_out = lodepng_get_bpp_lct(mode_out->colortype, mode_out->bitdepth);
+    for(i = 0; i < numpixels; i += CONVERT_CHUNK)
+    {
+      size_t num = numpixels - i < CONVERT_CHUNK ? numpixels - i : CONVERT_CHUNK;
+      const unsigned char* chunkin = in + i / 8 * bpp_in;
+      unsigned char* chunkout = out + i / 8 * bpp_out;
+      if(!convert->write) convert->read(chunkout, chunkin, num, convert);
+      else
+      {
+        convert->read(rgba, chunkin, num, convert);
+        CERROR_TRY_RETURN(convert->write(chunkout, rgba, num, convert));
+      }
+    }
+  }
+
+  return 0;
+}
+
+#ifdef LODEPNG_COMPILE_SIMD
+static LODEPNG_TARGET("sse2") size_t storeNative16_sse2(unsigned char* out, const unsigned char* in,
+                                                        size_t numsamples)
+{
+  size_t i = 0;
+  for(; i + 8 <= numsamples; i += 8)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(in + i * 2));
+    _mm_storeu_si128((__m128i*)(out + i * 2), _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+  }
+  return i;
+}
+
+static LODEPNG_TARGET("sse2") size_t storeFloat_sse2(unsigned char* out, const unsigned char* in,
+                                                     size_t numsamples)
+{
+  const __m128 max = _mm_set1_ps(65535.0f);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for(; i + 8 <= numsamples; i += 8)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(in + i * 2));
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    __m128 lo = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero)), max);
+    __m128 hi = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero)), max);
+    _mm_storeu_ps((float*)(out + i * 4), lo);
+    _mm_storeu_ps((float*)(out + i * 4 + 16), hi);
+  }
+  return i;
+}
+#endif // LODEPNG_COMPILE_SIMD
+
+// stores numsamples big endian 16-bit samples of in to out in the sample format LSF_NATIVE or LSF_FLOAT
+static void storeSamples(unsigned char* out, const unsigned char* in, size_t numsamples, LodePNGSampleFormat format)
+{
+  size_t i = 0;
+  if(format == LSF_NATIVE)
+  {
+#ifdef LODEPNG_COMPILE_SIMD
+    if(getCpuFeatures() & LODEPNG_CPU_SSE2) i = storeNative16_sse2(out, in, numsamples);
+#endif // LODEPNG_COMPILE_SIMD
+    for(; i != numsamples; ++i)
+    {
+      unsigned short value = (unsigned short)((in[i * 2] << 8) | in[i * 2 + 1]);
+      memcpy(out + i * 2, &value, 2);
+    }
+  }
+  else
+  {
+#ifdef LODEPNG_COMPILE_SIMD
+    if(getCpuFeatures() & LODEPNG_CPU_SSE2) i = storeFloat_sse2(out, in, numsamples);
+#endif // LODEPNG_COMPILE_SIMD
+    for(; i != numsamples; ++i)
+    {
+      float value = (float)((in[i * 2] << 8) | in[i * 2 + 1]) / 65535.0f;
+      memcpy(out + i * 4, &value, 4);
+    }
+  }
+}
+
+/*Converts numpixels pixels. in and out point to the first pixel, and must start at a byte if
+pixels are smaller than a byte. Samples of another format than big endian are stored in it in the same
+pass, a chunk of pixels at a time while they're still in the cache. return value is error*/
+static unsigned ColorConvert_pixels(ColorConvert* convert, unsigned char* out, const unsigned char* in,
+                                    size_t numpixels)
+{
+  if(convert->sampleformat == LSF_BIG_ENDIAN) return ColorConvert_bigEndian(convert, out, in, numpixels);
+
+  unsigned char samples[CONVERT_CHUNK * 8];
+  size_t bpp_in = lodepng_get_bpp(convert->mode_in);
+  size_t channels = lodepng_get_channels(convert->mode_out);
+  size_t samplesize = convert->sampleformat == LSF_FLOAT ? 4 : 2;
+  for(size_t i = 0; i < numpixels; i += CONVERT_CHUNK)
+  {
+    size_t num = numpixels - i < CONVERT_CHUNK ? numpixels - i : CONVERT_CHUNK;
+    const unsigned char* chunkin = in + i / 8 * bpp_in;
+    if(!convert->storeonly)
+    {
+      CERROR_TRY_RETURN(ColorConvert_bigEndian(convert, samples, chunkin, num));
+      chunkin = samples;
+    }
+    storeSamples(out + i * channels * samplesize, chunkin, num * channels, convert->sampleformat);
+  }
+  return 0;
+}
+
+unsigned lodepng_convert(unsigned char* out, const unsigned char* in,
+                         const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
+                         unsigned w, unsigned h)
+{
+  if(mode_in->sampleformat != LSF_BIG_ENDIAN) return 101; // error: only the output can have such samples
+  if(mode_out->sampleformat != LSF_BIG_ENDIAN && mode_out->bitdepth != 16) return 101;
+  ColorConvert convert;
+  ColorConvert_init(&convert, mode_out, mode_in);
+  unsigned error = ColorConvert_pixels(&convert, out, in, (size_t)w * h);
+  ColorConvert_cleanup(&convert);
+  return error;
+}
+
+void lodepng_color_profile_init(LodePNGColorProfile* profile)
+{
+  profile->colored = 0;
+  profile->key = 0;
+  profile->key_r = profile->key_g = profile->key_b = 0;
+  profile->alpha = 0;
+  profile->numcolors = 0;
+  profile->bits = 1;
+}
+
+// function used for debug purposes with C++
+/*void printColorProfile(LodePNGColorProfile* p)
+{
+  std::cout << "colored: " << (int)p->colored << ", ";
+  std::cout << "key: " << (int)p->key << ", ";
+  std::cout << "key_r: " << (int)p->key_r << ", ";
+  std::cout << "key_g: " << (int)p->key_g << ", ";
   std::cout << "key_b: " << (int)p->key_b << ", ";
   std::cout << "alpha: " << (int)p->alpha << ", ";
   std::cout << "numcolors: " << (int)p->numcolors << ", ";
@@ -3428,6 +6003,10 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
   {
     CERROR_RETURN_ERROR(state->error, 29); // error: it doesn't start with a IHDR chunk!
   }
+  if(state->decoder.check_crc && lodepng_chunk_check_crc(in + 8))
+  {
+    CERROR_RETURN_ERROR(state->error, 57); // error: wrong CRC of the header
+  }
 
   // read the values given in the header
   *w = lodepng_read32bitInt(&in[16]);
@@ -3452,37 +6031,278 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
   return state->error;
 }
 
-static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
-                                 size_t bytewidth, unsigned char filterType, size_t length)
+/*Unfilters one scanline with a single filter type. recon, scanline and precon are as in
+unfilterScanline, precon is never null.*/
+typedef void (*UnfilterFunc)(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                             size_t length);
+
+/*The unfilter functions for one image, chosen once depending on the bytewidth and the CPU.
+A null function means the scalar code of unfilterScanline is used for that filter type.*/
+typedef struct UnfilterKernels
 {
-  /*
-  For PNG filter method 0
-  unfilter a PNG image scanline by scanline. when the pixels are smaller than 1 byte,
-  the filter works byte per byte (bytewidth = 1)
-  precon is the previous unfiltered scanline, recon the result, scanline the current one
-  the incoming scanlines do NOT include the filtertype byte, that one is given in the parameter filterType instead
-  recon and scanline MAY be the same memory address! precon must be disjoint.
-  */
+  UnfilterFunc sub;
+  UnfilterFunc up;
+  UnfilterFunc avg;
+  UnfilterFunc paeth;
+} UnfilterKernels;
 
-  size_t i;
-  switch(filterType)
+#ifdef LODEPNG_COMPILE_SIMD
+/*Sub and Up can be done many bytes at a time, Avg and Paeth depend on the reconstructed pixel to
+their left, so for those only the bytes of one pixel are done at once, for pixels of 3 bytes or
+more. The loads and stores never touch bytes outside the scanlines, and scanline is always read
+before recon at the same position is written, so recon and scanline may still be the same.*/
+
+/*Loads the bytes of one pixel into the lowest bytes of a vector, with integer loads of the exact
+size: going through a buffer in memory is slow here since it stalls store forwarding.*/
+template<unsigned BPP>
+static LODEPNG_TARGET("sse2") __m128i loadPixel(const unsigned char* p)
+{
+  switch(BPP)
   {
-    case 0:
-      for(i = 0; i != length; ++i) recon[i] = scanline[i];
+    case 3: return _mm_cvtsi32_si128((int)(p[0] | (p[1] << 8) | (p[2] << 16)));
+    case 4: return _mm_cvtsi32_si128((int)readLE32(p));
+    case 6: return _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)readLE32(p)), _mm_cvtsi32_si128(p[4] | (p[5] << 8)));
+    default: return _mm_loadl_epi64((const __m128i*)p);
+  }
+}
+
+template<unsigned BPP>
+static LODEPNG_TARGET("sse2") void storePixel(unsigned char* p, __m128i v)
+{
+  unsigned value = (unsigned)_mm_cvtsi128_si32(v);
+  switch(BPP)
+  {
+    case 3:
+      p[0] = (unsigned char)value;
+      p[1] = (unsigned char)(value >> 8);
+      p[2] = (unsigned char)(value >> 16);
       break;
-    case 1:
-      for(i = 0; i != bytewidth; ++i) recon[i] = scanline[i];
-      for(i = bytewidth; i < length; ++i) recon[i] = scanline[i] + recon[i - bytewidth];
+    case 4: memcpy(p, &value, 4); break;
+    case 6:
+      memcpy(p, &value, 4);
+      value = (unsigned)_mm_extract_epi16(v, 2);
+      p[4] = (unsigned char)value;
+      p[5] = (unsigned char)(value >> 8);
       break;
-    case 2:
-      if(precon)
-      {
-        for(i = 0; i != length; ++i) recon[i] = scanline[i] + precon[i];
-      }
-      else
-      {
-        for(i = 0; i != length; ++i) recon[i] = scanline[i];
-      }
+    default: _mm_storel_epi64((__m128i*)p, v); break;
+  }
+}
+
+/*Sub: each block of 16 bytes (15 or 12 for 3 and 6 byte pixels, to hold whole pixels) gets the last
+pixel of the previous block added to its first pixel, then a prefix sum over its pixels with shifts.*/
+template<unsigned BPP>
+static LODEPNG_TARGET("sse2") void unfilterSub_sse2(unsigned char* recon, const unsigned char* scanline,
+                                                    const unsigned char* precon, size_t length)
+{
+  const size_t step = (16 / BPP) * BPP;
+  __m128i carry = _mm_setzero_si128(); // the previous pixel, in the lowest bytes
+  size_t i = 0;
+  (void)precon;
+  for(; i + 16 <= length; i += step)
+  {
+    __m128i x = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(scanline + i)), carry);
+    x = _mm_add_epi8(x, _mm_slli_si128(x, BPP));
+    if(2 * BPP < step) x = _mm_add_epi8(x, _mm_slli_si128(x, 2 * BPP));
+    if(4 * BPP < step) x = _mm_add_epi8(x, _mm_slli_si128(x, 4 * BPP));
+    if(8 * BPP < step) x = _mm_add_epi8(x, _mm_slli_si128(x, 8 * BPP));
+    if(step == 16)
+    {
+      _mm_storeu_si128((__m128i*)(recon + i), x);
+      carry = _mm_srli_si128(x, 16 - BPP);
+    }
+    else
+    {
+      // the bytes past the last whole pixel aren't stored, they may be unread bytes of scanline
+      unsigned char buffer[8];
+      _mm_storel_epi64((__m128i*)(recon + i), x);
+      _mm_storel_epi64((__m128i*)buffer, _mm_srli_si128(x, 8));
+      memcpy(recon + i + 8, buffer, step - 8);
+      carry = _mm_srli_si128(_mm_slli_si128(x, 16 - step), 16 - BPP);
+    }
+  }
+  for(; i < length; ++i) recon[i] = scanline[i] + (i >= BPP ? recon[i - BPP] : 0);
+}
+
+static LODEPNG_TARGET("sse2") void unfilterUp_sse2(unsigned char* recon, const unsigned char* scanline,
+                                                   const unsigned char* precon, size_t length)
+{
+  size_t i = 0;
+  for(; i + 16 <= length; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(scanline + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(precon + i));
+    _mm_storeu_si128((__m128i*)(recon + i), _mm_add_epi8(x, b));
+  }
+  for(; i < length; ++i) recon[i] = scanline[i] + precon[i];
+}
+
+static LODEPNG_TARGET("avx2") void unfilterUp_avx2(unsigned char* recon, const unsigned char* scanline,
+                                                   const unsigned char* precon, size_t length)
+{
+  size_t i = 0;
+  for(; i + 32 <= length; i += 32)
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(scanline + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(precon + i));
+    _mm256_storeu_si256((__m256i*)(recon + i), _mm256_add_epi8(x, b));
+  }
+  for(; i < length; ++i) recon[i] = scanline[i] + precon[i];
+}
+
+// Avg: the rounded up average of pavgb, minus the bit that rounded it up
+template<unsigned BPP>
+static LODEPNG_TARGET("sse2") void unfilterAvg_sse2(unsigned char* recon, const unsigned char* scanline,
+                                                    const unsigned char* precon, size_t length)
+{
+  const __m128i one = _mm_set1_epi8(1);
+  __m128i a = _mm_setzero_si128(); // the pixel to the left, 0 for the first one
+  for(size_t i = 0; i != length; i += BPP)
+  {
+    __m128i b = loadPixel<BPP>(precon + i);
+    __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+    a = _mm_add_epi8(loadPixel<BPP>(scanline + i), avg);
+    storePixel<BPP>(recon + i, a);
+  }
+}
+
+/*Paeth on 16-bit lanes, given pa = |b - c|, pb = |a - c| and pc = |a + b - 2c|. Picks c if
+pc < min(pa, pb), else b if pb < pa, else a, the same choice as paethPredictor.*/
+static LODEPNG_TARGET("sse2") __m128i paethPick(__m128i a, __m128i b, __m128i c, __m128i pa, __m128i pb, __m128i pc)
+{
+  __m128i useb = _mm_cmplt_epi16(pb, pa);
+  __m128i pred = _mm_or_si128(_mm_and_si128(useb, b), _mm_andnot_si128(useb, a));
+  __m128i usec = _mm_cmplt_epi16(pc, _mm_min_epi16(pa, pb));
+  return _mm_or_si128(_mm_and_si128(usec, c), _mm_andnot_si128(usec, pred));
+}
+
+template<unsigned BPP>
+static LODEPNG_TARGET("sse2") void unfilterPaeth_sse2(unsigned char* recon, const unsigned char* scanline,
+                                                      const unsigned char* precon, size_t length)
+{
+  const __m128i zero = _mm_setzero_si128();
+  // the pixels to the left and upper left, 0 for the first one
+  __m128i a = zero;
+  __m128i c = zero;
+  for(size_t i = 0; i != length; i += BPP)
+  {
+    __m128i b = _mm_unpacklo_epi8(loadPixel<BPP>(precon + i), zero);
+    __m128i pa = _mm_sub_epi16(b, c);
+    __m128i pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_add_epi16(pa, pb);
+    // no pabsw in SSE2
+    pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+    pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+    pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+    __m128i pred = paethPick(a, b, c, pa, pb, pc);
+    __m128i x = _mm_add_epi8(loadPixel<BPP>(scanline + i), _mm_packus_epi16(pred, pred));
+    storePixel<BPP>(recon + i, x);
+    a = _mm_unpacklo_epi8(x, zero);
+    c = b;
+  }
+}
+
+template<unsigned BPP>
+static LODEPNG_TARGET("ssse3") void unfilterPaeth_ssse3(unsigned char* recon, const unsigned char* scanline,
+                                                        const unsigned char* precon, size_t length)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = zero;
+  __m128i c = zero;
+  for(size_t i = 0; i != length; i += BPP)
+  {
+    __m128i b = _mm_unpacklo_epi8(loadPixel<BPP>(precon + i), zero);
+    __m128i pa = _mm_sub_epi16(b, c);
+    __m128i pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_abs_epi16(_mm_add_epi16(pa, pb));
+    pa = _mm_abs_epi16(pa);
+    pb = _mm_abs_epi16(pb);
+    __m128i pred = paethPick(a, b, c, pa, pb, pc);
+    __m128i x = _mm_add_epi8(loadPixel<BPP>(scanline + i), _mm_packus_epi16(pred, pred));
+    storePixel<BPP>(recon + i, x);
+    a = _mm_unpacklo_epi8(x, zero);
+    c = b;
+  }
+}
+
+template<unsigned BPP>
+static void getUnfilterKernelsFor(UnfilterKernels* kernels, unsigned features)
+{
+  if(!(features & LODEPNG_CPU_SSE2)) return;
+  kernels->sub = unfilterSub_sse2<BPP>;
+  kernels->up = (features & LODEPNG_CPU_AVX2) ? unfilterUp_avx2 : unfilterUp_sse2;
+  // for pixels of 1 and 2 bytes the vector registers barely help over the scalar code
+  if(BPP >= 3)
+  {
+    kernels->avg = unfilterAvg_sse2<BPP>;
+    kernels->paeth = (features & LODEPNG_CPU_SSSE3) ? unfilterPaeth_ssse3<BPP> : unfilterPaeth_sse2<BPP>;
+  }
+}
+#endif // LODEPNG_COMPILE_SIMD
+
+static void getUnfilterKernels(UnfilterKernels* kernels, size_t bytewidth)
+{
+  kernels->sub = kernels->up = kernels->avg = kernels->paeth = 0;
+#ifdef LODEPNG_COMPILE_SIMD
+  unsigned features = getCpuFeatures();
+  switch(bytewidth)
+  {
+    case 1: getUnfilterKernelsFor<1>(kernels, features); break;
+    case 2: getUnfilterKernelsFor<2>(kernels, features); break;
+    case 3: getUnfilterKernelsFor<3>(kernels, features); break;
+    case 4: getUnfilterKernelsFor<4>(kernels, features); break;
+    case 6: getUnfilterKernelsFor<6>(kernels, features); break;
+    case 8: getUnfilterKernelsFor<8>(kernels, features); break;
+    default: break;
+  }
+#else
+  (void)bytewidth;
+#endif // LODEPNG_COMPILE_SIMD
+}
+
+static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                 size_t bytewidth, unsigned char filterType, size_t length,
+                                 const UnfilterKernels* kernels)
+{
+  /*
+  For PNG filter method 0
+  unfilter a PNG image scanline by scanline. when the pixels are smaller than 1 byte,
+  the filter works byte per byte (bytewidth = 1)
+  precon is the previous unfiltered scanline, recon the result, scanline the current one
+  the incoming scanlines do NOT include the filtertype byte, that one is given in the parameter filterType instead
+  recon and scanline MAY be the same memory address! precon must be disjoint.
+  kernels are the faster versions of the code below to use where available, the code below is the reference.
+  */
+
+  UnfilterFunc kernel = 0;
+  if(filterType == 1) kernel = kernels->sub;
+  else if(precon && filterType == 2) kernel = kernels->up;
+  else if(precon && filterType == 3) kernel = kernels->avg;
+  else if(precon && filterType == 4) kernel = kernels->paeth;
+  if(kernel)
+  {
+    kernel(recon, scanline, precon, length);
+    return 0;
+  }
+
+  size_t i;
+  switch(filterType)
+  {
+    case 0:
+      for(i = 0; i != length; ++i) recon[i] = scanline[i];
+      break;
+    case 1:
+      for(i = 0; i != bytewidth; ++i) recon[i] = scanline[i];
+      for(i = bytewidth; i < length; ++i) recon[i] = scanline[i] + recon[i - bytewidth];
+      break;
+    case 2:
+      if(precon)
+      {
+        for(i = 0; i != length; ++i) recon[i] = scanline[i] + precon[i];
+      }
+      else
+      {
+        for(i = 0; i != length; ++i) recon[i] = scanline[i];
+      }
       break;
     case 3:
       if(precon)
@@ -3541,6 +6361,8 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
   // bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise
   size_t bytewidth = (bpp + 7) / 8;
   size_t linebytes = (w * bpp + 7) / 8;
+  UnfilterKernels kernels;
+  getUnfilterKernels(&kernels, bytewidth);
 
   for(unsigned y = 0; y < h; ++y)
   {
@@ -3548,7 +6370,8 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
     size_t inindex = (1 + linebytes) * y; // the extra filterbyte added to each row
     unsigned char filterType = in[inindex];
 
-    CERROR_TRY_RETURN(unfilterScanline(&out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes));
+    CERROR_TRY_RETURN(unfilterScanline(&out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes,
+                                       &kernels));
 
     prevline = &out[outindex];
   }
@@ -3556,147 +6379,208 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
   return 0;
 }
 
-/*
-in: Adam7 interlaced image, with no padding bits between scanlines, but between
- reduced images so that each reduced image starts at a byte.
-out: the same pixels, but re-ordered so that they're now a non-interlaced image with size w*h
-bpp: bits per pixel
-out has the following size in bits: w * h * bpp.
-in is possibly bigger due to padding bits between reduced images.
-out must be big enough AND must be 0 everywhere if bpp < 8 in the current implementation
-(because that's likely a little bit faster)
-NOTE: comments about padding bits are only relevant if bpp < 8
-*/
-static void Adam7_deinterlace(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
-{
-  unsigned passw[7], passh[7];
-  size_t filter_passstart[8], padded_passstart[8], passstart[8];
-  unsigned i;
-
-  Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+/*Copies the pixels of a row of a reduced image to every DX-th pixel of a row of the full image, out
+points to the first of them. For pixels of BYTES bytes, one instantiation per pass and pixel size.*/
+typedef void (*Adam7ScatterFunc)(unsigned char* out, const unsigned char* in, size_t numpixels);
 
-  if(bpp >= 8)
+template<unsigned BYTES, unsigned DX>
+static void adam7Scatter(unsigned char* out, const unsigned char* in, size_t numpixels)
+{
+  if(DX == 1)
   {
-    for(i = 0; i != 7; ++i)
-    {
-      unsigned x, y, b;
-      size_t bytewidth = bpp / 8;
-      for(y = 0; y < passh[i]; ++y)
-      for(x = 0; x < passw[i]; ++x)
-      {
-        size_t pixelinstart = passstart[i] + (y * passw[i] + x) * bytewidth;
-        size_t pixeloutstart = ((ADAM7_IY[i] + y * ADAM7_DY[i]) * w + ADAM7_IX[i] + x * ADAM7_DX[i]) * bytewidth;
-        for(b = 0; b < bytewidth; ++b)
-        {
-          out[pixeloutstart + b] = in[pixelinstart + b];
-        }
-      }
-    }
+    memcpy(out, in, numpixels * BYTES);
+    return;
   }
-  else // bpp < 8: Adam7 with pixels < 8 bit is a bit trickier: with bit pointers
+  for(size_t i = 0; i != numpixels; ++i)
   {
-    for(i = 0; i != 7; ++i)
-    {
-      unsigned x, y, b;
-      unsigned ilinebits = bpp * passw[i];
-      unsigned olinebits = bpp * w;
-      size_t obp, ibp; // bit pointers (for out and in buffer)
-      for(y = 0; y < passh[i]; ++y)
-      for(x = 0; x < passw[i]; ++x)
-      {
-        ibp = (8 * passstart[i]) + (y * ilinebits + x * bpp);
-        obp = (ADAM7_IY[i] + y * ADAM7_DY[i]) * olinebits + (ADAM7_IX[i] + x * ADAM7_DX[i]) * bpp;
-        for(b = 0; b < bpp; ++b)
-        {
-          unsigned char bit = readBitFromReversedStream(&ibp, in);
-          // note that this function assumes the out buffer is completely 0, use setBitOfReversedStream otherwise
-          setBitOfReversedStream0(&obp, out, bit);
-        }
-      }
-    }
+    for(unsigned b = 0; b != BYTES; ++b) out[i * DX * BYTES + b] = in[i * BYTES + b];
   }
 }
 
-static void removePaddingBits(unsigned char* out, const unsigned char* in,
-                              size_t olinebits, size_t ilinebits, unsigned h)
+template<unsigned BYTES>
+static void getAdam7ScatterFor(Adam7ScatterFunc scatter[7])
 {
-  /*
-  After filtering there are still padding bits if scanlines have non multiple of 8 bit amounts. They need
-  to be removed (except at last scanline of (Adam7-reduced) image) before working with pure image buffers
-  for the Adam7 code, the color convert code and the output to the user.
-  in and out are allowed to be the same buffer, in may also be higher but still overlapping; in must
-  have >= ilinebits*h bits, out must have >= olinebits*h bits, olinebits must be <= ilinebits
-  also used to move bits after earlier such operations happened, e.g. in a sequence of reduced images from Adam7
-  only useful if (ilinebits - olinebits) is a value in the range 1..7
-  */
-  unsigned y;
-  size_t diff = ilinebits - olinebits;
-  size_t ibp = 0, obp = 0; // input and output bit pointers
-  for(y = 0; y < h; ++y)
+  scatter[0] = scatter[1] = adam7Scatter<BYTES, 8>;
+  scatter[2] = scatter[3] = adam7Scatter<BYTES, 4>;
+  scatter[4] = scatter[5] = adam7Scatter<BYTES, 2>;
+  scatter[6] = adam7Scatter<BYTES, 1>;
+}
+
+// The scatter function of each pass, for pixels of bytewidth bytes
+static void getAdam7Scatter(Adam7ScatterFunc scatter[7], size_t bytewidth)
+{
+  switch(bytewidth)
   {
-    size_t x;
-    for(x = 0; x < olinebits; ++x)
-    {
-      unsigned char bit = readBitFromReversedStream(&ibp, in);
-      setBitOfReversedStream(&obp, out, bit);
-    }
-    ibp += diff;
+    case 1: getAdam7ScatterFor<1>(scatter); break;
+    case 2: getAdam7ScatterFor<2>(scatter); break;
+    case 3: getAdam7ScatterFor<3>(scatter); break;
+    case 4: getAdam7ScatterFor<4>(scatter); break;
+    case 6: getAdam7ScatterFor<6>(scatter); break;
+    default: getAdam7ScatterFor<8>(scatter); break;
+  }
+}
+
+/*For pixels of 1, 2 and 4 bits, and each x delta 2, 4 and 8 of the passes: the pixels of a nibble of a
+reduced image spread out over 4 * dx bits of the full image, with their pixels of the other passes as 0
+bits, from the top of the 32 bits. [log2 of bpp][log2 of dx - 1][nibble]*/
+static const unsigned ADAM7_SPREAD[3][3][16] = {
+  {
+    {0x00000000u, 0x02000000u, 0x08000000u, 0x0a000000u, 0x20000000u, 0x22000000u, 0x28000000u, 0x2a000000u,
+     0x80000000u, 0x82000000u, 0x88000000u, 0x8a000000u, 0xa0000000u, 0xa2000000u, 0xa8000000u, 0xaa000000u},
+    {0x00000000u, 0x00080000u, 0x00800000u, 0x00880000u, 0x08000000u, 0x08080000u, 0x08800000u, 0x08880000u,
+     0x80000000u, 0x80080000u, 0x80800000u, 0x80880000u, 0x88000000u, 0x88080000u, 0x88800000u, 0x88880000u},
+    {0x00000000u, 0x00000080u, 0x00008000u, 0x00008080u, 0x00800000u, 0x00800080u, 0x00808000u, 0x00808080u,
+     0x80000000u, 0x80000080u, 0x80008000u, 0x80008080u, 0x80800000u, 0x80800080u, 0x80808000u, 0x80808080u}
+  },
+  {
+    {0x00000000u, 0x04000000u, 0x08000000u, 0x0c000000u, 0x40000000u, 0x44000000u, 0x48000000u, 0x4c000000u,
+     0x80000000u, 0x84000000u, 0x88000000u, 0x8c000000u, 0xc0000000u, 0xc4000000u, 0xc8000000u, 0xcc000000u},
+    {0x00000000u, 0x00400000u, 0x00800000u, 0x00c00000u, 0x40000000u, 0x40400000u, 0x40800000u, 0x40c00000u,
+     0x80000000u, 0x80400000u, 0x80800000u, 0x80c00000u, 0xc0000000u, 0xc0400000u, 0xc0800000u, 0xc0c00000u},
+    {0x00000000u, 0x00004000u, 0x00008000u, 0x0000c000u, 0x40000000u, 0x40004000u, 0x40008000u, 0x4000c000u,
+     0x80000000u, 0x80004000u, 0x80008000u, 0x8000c000u, 0xc0000000u, 0xc0004000u, 0xc0008000u, 0xc000c000u}
+  },
+  {
+    {0x00000000u, 0x10000000u, 0x20000000u, 0x30000000u, 0x40000000u, 0x50000000u, 0x60000000u, 0x70000000u,
+     0x80000000u, 0x90000000u, 0xa0000000u, 0xb0000000u, 0xc0000000u, 0xd0000000u, 0xe0000000u, 0xf0000000u},
+    {0x00000000u, 0x10000000u, 0x20000000u, 0x30000000u, 0x40000000u, 0x50000000u, 0x60000000u, 0x70000000u,
+     0x80000000u, 0x90000000u, 0xa0000000u, 0xb0000000u, 0xc0000000u, 0xd0000000u, 0xe0000000u, 0xf0000000u},
+    {0x00000000u, 0x10000000u, 0x20000000u, 0x30000000u, 0x40000000u, 0x50000000u, 0x60000000u, 0x70000000u,
+     0x80000000u, 0x90000000u, 0xa0000000u, 0xb0000000u, 0xc0000000u, 0xd0000000u, 0xe0000000u, 0xf0000000u}
+  }
+};
+
+/*Same as adam7Scatter for pixels of bpp 1, 2 or 4 bits, a byte of in at a time, with x start ix and
+delta dx other than 1. out is the row of the full image, which must be 0 where the pixels of this pass
+go, and have room for dx bytes per byte of in. The padding bits of in are ignored.*/
+static void adam7ScatterBits(unsigned char* out, const unsigned char* in, size_t numpixels,
+                             unsigned bpp, unsigned ix, unsigned dx)
+{
+  const unsigned* table = ADAM7_SPREAD[bpp == 1 ? 0 : bpp == 2 ? 1 : 2][dx == 2 ? 0 : dx == 4 ? 1 : 2];
+  size_t numbits = numpixels * bpp;
+  size_t numbytes = (numbits + 7) / 8;
+  unsigned shift = ix * bpp;
+  for(size_t j = 0; j != numbytes; ++j)
+  {
+    unsigned char v = in[j];
+    if(j + 1 == numbytes && numbits % 8 != 0) v &= (unsigned char)(0xff00u >> (numbits % 8));
+    // the pixels of the byte over dx bytes, the first of them the most significant byte
+    uint64_t spread = ((uint64_t)table[v >> 4] << 32) | ((uint64_t)table[v & 15u] << (32 - 4 * dx));
+    spread >>= shift;
+    unsigned char* o = out + j * dx;
+    for(unsigned k = 0; k != dx; ++k) o[k] |= (unsigned char)(spread >> (56 - 8 * k));
   }
 }
 
-/*out must be buffer big enough to contain full image, and in must contain the full decompressed data from
-the IDAT chunks (with filter index bytes and possible padding bits)
+/*in: Adam7 interlaced image, unfiltered by Adam7_unfilter: each reduced image starts at a byte, and so
+does each of its scanlines, with padding bits at their end if bpp < 8.
+Puts rows y0 up to y1 of the full image together from the rows of the reduced images that are on it,
+and converts each to mode_out straight into out, where row y starts at byte y * stride, or with stride 0
+packed without padding bits as lodepng_decode outputs them. Rows that don't start at a byte leave the
+bits of the rows around them untouched, y0 and y1 must be a multiple of 8 or h so that rows of
+different calls don't share bytes.
 return value is error*/
-static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
-                                     unsigned w, unsigned h, const LodePNGInfo* info_png)
+static unsigned Adam7_deinterlace(unsigned char* out, size_t stride, unsigned w, unsigned h,
+                                  const unsigned char* in, unsigned y0, unsigned y1,
+                                  const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in)
 {
-  /*
-  This function converts the filtered-padded-interlaced data into pure 2D image buffer with the PNG's colortype.
-  Steps:
-  *) if no Adam7: 1) unfilter 2) remove padding bits (= posible extra bits per scanline if bpp < 8)
-  *) if adam7: 1) 7x unfilter 2) 7x remove padding bits 3) Adam7_deinterlace
-  NOTE: the in buffer will be overwritten with intermediate data!
-  */
-  unsigned bpp = lodepng_get_bpp(&info_png->color);
+  unsigned passw[7], passh[7];
+  size_t filter_passstart[8], padded_passstart[8], passstart[8];
+  unsigned bpp = lodepng_get_bpp(mode_in);
   if(bpp == 0) return 31; // error: invalid colortype
+  Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
 
-  if(info_png->interlace_method == 0)
+  size_t bytewidth = (bpp + 7) / 8;
+  size_t linebytes = ((size_t)w * bpp + 7) / 8;
+  size_t outlinebits = (size_t)w * lodepng_get_bpp(mode_out);
+  size_t outlinebytes = (outlinebits + 7) / 8;
+  Adam7ScatterFunc scatter[7];
+  getAdam7Scatter(scatter, bytewidth);
+
+  ColorConvert convert;
+  ColorConvert_init(&convert, mode_out, mode_in);
+  // as in decodeScanlineRows, rows of full bytes without conversion are put together straight in out
+  unsigned aligned = stride != 0 || outlinebits % 8 == 0;
+  if(stride == 0) stride = outlinebytes;
+  unsigned direct = convert.copy && aligned && bpp >= 8;
+  unsigned packed = !convert.copy && !aligned;
+
+  unsigned error = 0;
+  // the row put together, with room for the last byte of a reduced row spreading out, and the converted row if packed
+  unsigned char* line = (unsigned char*)malloc(linebytes + 16 + (packed ? outlinebytes : 0));
+  if(!line) error = 83; // alloc fail
+  if(!error && !aligned && y1 == h) out[(outlinebits * h + 7) / 8 - 1] = 0;
+
+  for(unsigned y = y0; y < y1 && !error; ++y)
   {
-    if(bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8)
+    unsigned char* row = direct ? out + y * stride : line;
+    // the pixels of odd rows all come from the last pass, the others are put together from several
+    if(bpp < 8 && y % 2 == 0) memset(line, 0, linebytes + 16);
+    for(unsigned i = 0; i != 7; ++i)
     {
-      CERROR_TRY_RETURN(unfilter(in, in, w, h, bpp));
-      removePaddingBits(out, in, w * bpp, ((w * bpp + 7) / 8) * 8, h);
+      if(passw[i] == 0 || y < ADAM7_IY[i] || (y - ADAM7_IY[i]) % ADAM7_DY[i] != 0) continue;
+      size_t passlinebytes = ((size_t)passw[i] * bpp + 7) / 8;
+      const unsigned char* passline = in + padded_passstart[i] + (y - ADAM7_IY[i]) / ADAM7_DY[i] * passlinebytes;
+      if(bpp >= 8) scatter[i](row + ADAM7_IX[i] * bytewidth, passline, passw[i]);
+      else if(ADAM7_DX[i] == 1) memcpy(row, passline, passlinebytes);
+      else adam7ScatterBits(row, passline, passw[i], bpp, ADAM7_IX[i], ADAM7_DX[i]);
     }
-    // we can immediately filter into the out buffer, no other steps needed
-    else CERROR_TRY_RETURN(unfilter(out, in, w, h, bpp));
-  }
-  else // interlace_method is 1 (Adam7)
-  {
-    unsigned passw[7], passh[7]; size_t filter_passstart[8], padded_passstart[8], passstart[8];
-    unsigned i;
-
-    Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
 
-    for(i = 0; i != 7; ++i)
+    if(direct) continue;
+    if(convert.copy)
     {
-      CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp));
-      /*TODO: possible efficiency improvement: if in this reduced image the bits fit nicely in 1 scanline,
-      move bytes instead of bits or move not at all*/
-      if(bpp < 8)
-      {
-        /*remove padding bits in scanlines; after this there still may be padding
-        bits between the different reduced images: each reduced image still starts nicely at a byte*/
-        removePaddingBits(&in[passstart[i]], &in[padded_passstart[i]], passw[i] * bpp,
-                          ((passw[i] * bpp + 7) / 8) * 8, passh[i]);
-      }
+      if(aligned) memcpy(out + y * stride, line, outlinebytes);
+      else copyBitsToReversedStream(out, y * outlinebits, line, outlinebits);
     }
-
-    Adam7_deinterlace(out, in, w, h, bpp);
+    else if(packed)
+    {
+      unsigned char* converted = line + linebytes + 16;
+      error = ColorConvert_pixels(&convert, converted, line, w);
+      if(!error) copyBitsToReversedStream(out, y * outlinebits, converted, outlinebits);
+    }
+    else error = ColorConvert_pixels(&convert, out + y * stride, line, w);
   }
 
+  free(line);
+  ColorConvert_cleanup(&convert);
+  return error;
+}
+
+/*Unfilters the 7 reduced images of the decompressed data of an Adam7 image in place: the pixels of
+each reduced image go where its scanlines without filter bytes start, padded_passstart of
+Adam7_getpassvalues, so each of its scanlines still starts at a byte.
+return value is error*/
+static unsigned Adam7_unfilter(unsigned char* in, unsigned w, unsigned h, unsigned bpp)
+{
+  unsigned passw[7], passh[7];
+  size_t filter_passstart[8], padded_passstart[8], passstart[8];
+  if(bpp == 0) return 31; // error: invalid colortype
+  Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
+  for(unsigned i = 0; i != 7; ++i)
+  {
+    CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp));
+  }
   return 0;
 }
 
+/*out must be buffer big enough to contain full image in the color mode mode_out, with rows at stride
+as in Adam7_deinterlace, and in must contain the full decompressed data from the IDAT chunks of an
+Adam7 image (with filter index bytes and possible padding bits). Images without interlacing are
+decoded by decodeScanlines instead.
+return value is error*/
+static unsigned postProcessScanlines(unsigned char* out, size_t stride, unsigned char* in,
+                                     unsigned w, unsigned h, const LodePNGInfo* info_png,
+                                     const LodePNGColorMode* mode_out)
+{
+  /*
+  This function converts the filtered-padded-interlaced data into pure 2D image buffer with the colortype
+  of mode_out. Steps: 1) 7x unfilter 2) Adam7_deinterlace, which also converts the rows.
+  NOTE: the in buffer will be overwritten with intermediate data!
+  */
+  CERROR_TRY_RETURN(Adam7_unfilter(in, w, h, lodepng_get_bpp(&info_png->color)));
+  return Adam7_deinterlace(out, stride, w, h, in, 0, h, mode_out, &info_png->color);
+}
+
 static unsigned readChunk_PLTE(LodePNGColorMode* color, const unsigned char* data, size_t chunkLength)
 {
   unsigned pos = 0, i;
@@ -3755,142 +6639,1463 @@ static unsigned readChunk_tRNS(LodePNGColorMode* color, const unsigned char* dat
 }
 
 
-// read a PNG, the result will be in the same color type as the PNG (hence "generic")
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-                          LodePNGState* state,
-                          const unsigned char* in, size_t insize)
+/*Makes sure the inflater's output holds size bytes from *start on, inflating more data as needed.
+When the output buffer gets too full, the data before *start that is no longer needed as window
+for the inflater is dropped, *start moves along with the remaining data.*/
+static unsigned inflateWindow(Inflator* inflator, size_t* start, size_t size)
 {
-  unsigned char IEND = 0;
-  const unsigned char* chunk;
-  size_t i;
-  ucvector idat; // the data from idat chunks
-  ucvector scanlines;
-  size_t predict;
-  size_t numpixels;
-  size_t outsize = 0;
-
-  // for unknown chunk order
-  unsigned unknown = 0;
-
-  // provide some proper output values if error will happen
-  *out = 0;
-
-  state->error = lodepng_inspect(w, h, state, in, insize); // reads header and resets other parameters in state->info_png
-  if(state->error) return;
-
-  numpixels = *w * *h;
+  if(*start + size + INFLATE_FAST_MARGIN > inflator->out->allocsize)
+  {
+    size_t amount = inflator->pos > 32768 ? inflator->pos - 32768 : 0;
+    if(amount > *start) amount = *start;
+    Inflator_discard(inflator, amount);
+    *start -= amount;
+  }
+  return Inflator_run(inflator, *start + size);
+}
 
-  // multiplication overflow
-  if(*h != 0 && numpixels / *h != *w) CERROR_RETURN(state->error, 92);
-  /*multiplication overflow possible further below. Allows up to 2^31-1 pixel
-  bytes with 16-bit RGBA, the rest is room for filter bytes.*/
-  if(numpixels > 268435455) CERROR_RETURN(state->error, 92);
+/*Size of the output window of the inflater for inflateWindow and inflateRows, for scanlines of linebytes
+bytes plus the filter type byte: the last 32K of output, room to inflate at least 32K more past it, and a
+scanline. The window never has to grow with that, so they never write past its end.*/
+static size_t inflateWindowSize(size_t linebytes)
+{
+  return 32768 * 3 + linebytes + 1 + INFLATE_FAST_MARGIN;
+}
 
-  ucvector_init(&idat);
-  chunk = &in[33]; // first byte of the first chunk after the header
+/*Decodes rows y0 up to y1 of a non-interlaced image one scanline at a time: inflates just enough data
+for the next scanline, unfilters it against the previous one, and converts it straight into out, which
+has the color mode mode_out. Only two scanlines and the window of the inflater are in use at any time,
+instead of full size buffers for the decompressed, the unfiltered and the converted image.
+Row y of out starts at byte y * stride. If stride is 0, the rows are packed without padding bits
+in between instead, as lodepng_decode outputs them.
+The inflater must be at scanline y0, *start is its position in the window, which must have room for the
+last 32K of output and a few scanlines. Row y0 is unfiltered without the row above it, which for y0 other
+than 0 is only possible with the filter types None and Sub.
+return value is error*/
+static unsigned decodeScanlineRows(unsigned char* out, size_t stride, unsigned w, unsigned h,
+                                   unsigned y0, unsigned y1,
+                                   const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
+                                   Inflator* inflator, size_t* start)
+{
+  unsigned error = 0;
+  unsigned bpp = lodepng_get_bpp(mode_in);
+  if(bpp == 0) return 31; // error: invalid colortype
 
-  /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
-  IDAT data is put at the start of the in buffer*/
-  while(!IEND && !state->error)
+  // bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise
+  size_t bytewidth = (bpp + 7) / 8;
+  size_t linebytes = ((size_t)w * bpp + 7) / 8;
+  size_t outlinebits = (size_t)w * lodepng_get_bpp(mode_out);
+  size_t outlinebytes = (outlinebits + 7) / 8;
+
+  ColorConvert convert;
+  ColorConvert_init(&convert, mode_out, mode_in);
+  /*Rows of out start at a byte if there's a stride, or if the rows have no padding bits. Scanlines
+  without conversion are then unfiltered straight into out, others go to a separate buffer first.
+  Converted scanlines that don't start at a byte also go to a buffer, and are then copied to their
+  bit position in out.*/
+  unsigned aligned = stride != 0 || outlinebits % 8 == 0;
+  if(stride == 0) stride = outlinebytes;
+  unsigned direct = convert.copy && aligned;
+  unsigned packed = !convert.copy && !aligned;
+  UnfilterKernels kernels;
+  getUnfilterKernels(&kernels, bytewidth);
+
+  // previous and current unfiltered scanline, and the converted scanline if packed
+  unsigned char* lines = (unsigned char*)malloc(linebytes * 2 + (packed ? outlinebytes : 0));
+  if(!lines) error = 83; // alloc fail
+
+  // the padding bits at the end of the image are left untouched by the bit copies below
+  if(!error && !aligned && y1 == h) out[(outlinebits * h + 7) / 8 - 1] = 0;
+
+  ucvector* window = inflator->out;
+  unsigned char* prevline = 0;
+  unsigned char* curline = lines;
+  for(unsigned y = y0; y < y1 && !error; ++y)
   {
-    unsigned chunkLength;
-    const unsigned char* data; // the data in the chunk
+    error = inflateWindow(inflator, start, linebytes + 1);
+    if(error) break;
+    if(inflator->pos < *start + linebytes + 1) ERROR_BREAK(91); // decompressed size doesn't match prediction
 
-    // error: size of the in buffer too small to contain next chunk
-    if((size_t)((chunk - in) + 12) > insize || chunk < in)
-    {
-      break; // other errors may still happen though
-    }
+    const unsigned char* scanline = window->data + *start;
+    // only for bands, see decodeBand, where this makes the band get decoded along with the others instead
+    if(y == y0 && y0 != 0 && scanline[0] > 1) ERROR_BREAK(91);
+    if(direct) curline = out + y * stride;
+    error = unfilterScanline(curline, scanline + 1, prevline, bytewidth, scanline[0], linebytes, &kernels);
+    if(error) break;
+    *start += linebytes + 1;
 
-    // length of the data of the chunk, excluding the length bytes, chunk type and CRC bytes
-    chunkLength = lodepng_chunk_length(chunk);
-    // error: chunk length larger than the max PNG chunk size
-    if(chunkLength > 2147483647)
+    if(convert.copy)
     {
-      break; // other errors may still happen though
+      if(!direct) copyBitsToReversedStream(out, y * outlinebits, curline, outlinebits);
     }
-
-    if((size_t)((chunk - in) + chunkLength + 12) > insize || (chunk + chunkLength + 12) < in)
+    else if(packed)
     {
-      CERROR_BREAK(state->error, 64); // error: size of the in buffer too small to contain next chunk
+      unsigned char* converted = lines + linebytes * 2;
+      error = ColorConvert_pixels(&convert, converted, curline, w);
+      if(!error) copyBitsToReversedStream(out, y * outlinebits, converted, outlinebits);
     }
+    else error = ColorConvert_pixels(&convert, out + y * stride, curline, w);
 
-    data = lodepng_chunk_data_const(chunk);
+    prevline = curline;
+    if(!direct) curline = (curline == lines) ? lines + linebytes : lines;
+  }
 
-    // IDAT chunk, containing compressed image data
-    if(lodepng_chunk_type_equals(chunk, "IDAT"))
-    {
-      size_t oldsize = idat.size;
-      if(!ucvector_resize(&idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
-      for(i = 0; i != chunkLength; ++i) idat.data[oldsize + i] = data[i];
-    }
-    // IEND chunk
-    else if(lodepng_chunk_type_equals(chunk, "IEND"))
-    {
-      IEND = 1;
-    }
-    // palette chunk (PLTE)
-    else if(lodepng_chunk_type_equals(chunk, "PLTE"))
-    {
-      state->error = readChunk_PLTE(&state->info_png.color, data, chunkLength);
+  free(lines);
+  ColorConvert_cleanup(&convert);
+  return error;
+}
+
+// Checks that the zlib data ends after the last scanline, at *start in the window. return value is error
+static unsigned checkScanlinesEnd(Inflator* inflator, size_t* start)
+{
+  // more decompressed data means the image is corrupt
+  CERROR_TRY_RETURN(inflateWindow(inflator, start, 1));
+  if(inflator->pos > *start) return 91; // decompressed size doesn't match prediction
+  return 0;
+}
+
+// Decodes a non-interlaced image with decodeScanlineRows. return value is error
+static unsigned decodeScanlines(unsigned char* out, size_t stride, unsigned w, unsigned h,
+                                const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
+                                const ByteSpan* spans, size_t numspans,
+                                const LodePNGDecompressSettings* zlibsettings)
+{
+  unsigned error = 0;
+  size_t linebytes = ((size_t)w * lodepng_get_bpp(mode_in) + 7) / 8;
+
+  ucvector window;
+  ucvector_init(&window);
+  if(!ucvector_reserve(&window, inflateWindowSize(linebytes))) error = 83; // alloc fail
+
+  Inflator inflator;
+  Inflator_init(&inflator, spans, numspans, &window, 1);
+  inflator.check_adler32 = zlibsettings->check_adler32;
+  if(!error) error = readZlibHeader(&inflator.reader);
+
+  size_t start = 0; // position of the current scanline, with its filter byte, in the window
+  if(!error) error = decodeScanlineRows(out, stride, w, h, 0, h, mode_out, mode_in, &inflator, &start);
+  if(!error) error = checkScanlinesEnd(&inflator, &start);
+  if(!error && zlibsettings->check_adler32) error = checkZlibAdler32(&inflator);
+
+  Inflator_cleanup(&inflator);
+  ucvector_cleanup(&window);
+  return error;
+}
+
+#ifdef LODEPNG_COMPILE_THREADS
+
+/*Starts a thread that runs function(arg), returns 1 if success. Detects the CPU features first, on the calling
+thread, since the static that remembers them isn't thread-safe to initialize in C++98.*/
+static unsigned startThread(pthread_t* thread, void* (*function)(void*), void* arg)
+{
+#ifdef LODEPNG_COMPILE_SIMD
+  getCpuFeatures();
+#endif // LODEPNG_COMPILE_SIMD
+  return pthread_create(thread, 0, function, arg) == 0;
+}
+
+/*A band of rows of an image without interlacing that an encoder with band_height compressed on its own,
+and its part of the zlib data, from the lpBD chunk.*/
+typedef struct ScanlineBand
+{
+  unsigned y0, y1; // the rows of the band
+  spanvector spans; // the zlib data of the band
+  unsigned adler; // adler32 of the decompressed data of the band
+  unsigned char trailer[4]; // the adler32 of the whole zlib data, after the last band
+  unsigned error;
+} ScanlineBand;
+
+// The bands, and the threads decoding them, which each take the next band until all are taken.
+typedef struct BandDecoder
+{
+  unsigned char* out;
+  size_t stride;
+  unsigned w, h;
+  const LodePNGColorMode* mode_out;
+  const LodePNGColorMode* mode_in;
+  unsigned check_adler32;
+  ScanlineBand* bands;
+  size_t numbands;
+  size_t next; // the next band that no thread took yet
+  pthread_mutex_t mutex;
+} BandDecoder;
+
+/*Decodes the rows of a band, from its own part of the zlib data. The band must decompress to exactly its
+rows, and, except for the last one, end with a block that ends at the end of its data without BFINAL,
+as deflateBlocks makes them: then decoding the zlib data in one go gives the same. return value is error*/
+static unsigned decodeBand(const BandDecoder* decoder, ScanlineBand* band)
+{
+  size_t linebytes = ((size_t)decoder->w * lodepng_get_bpp(decoder->mode_in) + 7) / 8;
+  unsigned error = 0;
+  ucvector window;
+  ucvector_init(&window);
+  if(!ucvector_reserve(&window, inflateWindowSize(linebytes))) error = 83; // alloc fail
+
+  Inflator inflator;
+  Inflator_init(&inflator, band->spans.data, band->spans.size, &window, 1);
+  inflator.check_adler32 = decoder->check_adler32;
+  size_t start = 0; // position of the current scanline, with its filter byte, in the window
+  if(!error && band->y0 == 0) error = readZlibHeader(&inflator.reader);
+  if(!error)
+  {
+    error = decodeScanlineRows(decoder->out, decoder->stride, decoder->w, decoder->h, band->y0, band->y1,
+                               decoder->mode_out, decoder->mode_in, &inflator, &start);
+  }
+  if(!error && band->y1 == decoder->h)
+  {
+    error = checkScanlinesEnd(&inflator, &start);
+    if(!error && decoder->check_adler32)
+    {
+      BitReader_alignToByte(&inflator.reader);
+      if(!BitReader_readBytes(&inflator.reader, band->trailer, 4)) error = 53; // error, size of zlib data too small
+    }
+  }
+  else if(!error)
+  {
+    size_t insize = spanvector_bytes(&band->spans);
+    inflator.stopatblock = 1;
+    while(!error && !inflator.done && BitReader_position(&inflator.reader, insize) < insize * 8)
+    {
+      error = checkScanlinesEnd(&inflator, &start);
+    }
+    if(!error && (inflator.inblock || inflator.done || BitReader_position(&inflator.reader, insize) != insize * 8))
+    {
+      error = 91; // the band doesn't end where the next one starts
+    }
+  }
+  band->adler = inflator.adler;
+
+  Inflator_cleanup(&inflator);
+  ucvector_cleanup(&window);
+  return error;
+}
+
+static void* decodeBandsThread(void* arg)
+{
+  BandDecoder* decoder = (BandDecoder*)arg;
+  for(;;)
+  {
+    pthread_mutex_lock(&decoder->mutex);
+    size_t i = decoder->next++;
+    pthread_mutex_unlock(&decoder->mutex);
+    if(i >= decoder->numbands) break;
+    decoder->bands[i].error = decodeBand(decoder, &decoder->bands[i]);
+  }
+  return 0;
+}
+
+/*Decodes the bands of an image without interlacing, which the lpBD chunk with data lpbd tells, on the
+given amount of threads. Returns 0 if that decoded the image. Otherwise, when the bands are invalid or
+decoding any of them fails, decodeScanlines has to decode it instead, to give the pixels or error that
+decoding the zlib data in one go gives.*/
+static unsigned decodeBands(unsigned char* out, size_t stride, unsigned w, unsigned h,
+                            const LodePNGState* state, const spanvector* idat, const ByteSpan* lpbd,
+                            unsigned numthreads)
+{
+  // rows of less than 8 bits that share a byte with the next row can't be written by different threads
+  if(stride == 0 && ((size_t)w * lodepng_get_bpp(&state->info_raw)) % 8 != 0) return 1;
+  if(lpbd->size < 4) return 1;
+  unsigned bandheight = lodepng_read32bitInt(lpbd->data);
+  if(bandheight == 0 || bandheight >= h) return 1;
+  size_t numbands = (h - 1) / bandheight + 1;
+  if(lpbd->size != 4 + (numbands - 1) * 8) return 1;
+
+  BandDecoder decoder;
+  decoder.out = out;
+  decoder.stride = stride;
+  decoder.w = w;
+  decoder.h = h;
+  decoder.mode_out = &state->info_raw;
+  decoder.mode_in = &state->info_png.color;
+  decoder.check_adler32 = state->decoder.zlibsettings.check_adler32;
+  decoder.numbands = numbands;
+  decoder.next = 0;
+  decoder.bands = (ScanlineBand*)malloc(numbands * sizeof(ScanlineBand));
+  if(!decoder.bands) return 1;
+
+  unsigned error = 0;
+  size_t idatsize = spanvector_bytes(idat);
+  uint64_t begin = 0; // of the zlib data of the current band
+  for(size_t i = 0; i != numbands; ++i)
+  {
+    ScanlineBand* band = &decoder.bands[i];
+    band->y0 = (unsigned)(i * bandheight);
+    band->y1 = i + 1 == numbands ? h : (unsigned)((i + 1) * bandheight);
+    band->error = 0;
+    spanvector_init(&band->spans);
+    const unsigned char* offset = lpbd->data + 4 + i * 8; // as 32-bit high and low half
+    uint64_t end = i + 1 == numbands ? idatsize
+                 : ((uint64_t)lodepng_read32bitInt(offset) << 32) | lodepng_read32bitInt(offset + 4);
+    if(end <= begin || end > idatsize) error = 1; // the bands must be in order, each with some data
+    else if(!spanvector_slice(&band->spans, idat, (size_t)begin, (size_t)end)) error = 1;
+    begin = end;
+  }
+
+  if(!error)
+  {
+    pthread_t threads[64];
+    size_t numstarted = 0;
+    if(numthreads > numbands) numthreads = (unsigned)numbands;
+    if(numthreads > 64) numthreads = 64;
+    pthread_mutex_init(&decoder.mutex, 0);
+    while(numstarted + 1 < numthreads && startThread(&threads[numstarted], decodeBandsThread, &decoder))
+    {
+      ++numstarted;
+    }
+    decodeBandsThread(&decoder);
+    for(size_t i = 0; i != numstarted; ++i) pthread_join(threads[i], 0);
+    pthread_mutex_destroy(&decoder.mutex);
+  }
+
+  size_t linebytes = ((size_t)w * lodepng_get_bpp(&state->info_png.color) + 7) / 8;
+  unsigned adler = 1;
+  for(size_t i = 0; i != numbands; ++i)
+  {
+    ScanlineBand* band = &decoder.bands[i];
+    if(band->error) error = 1;
+    adler = i == 0 ? band->adler : adler32Combine(adler, band->adler, (band->y1 - band->y0) * (linebytes + 1));
+    spanvector_cleanup(&band->spans);
+  }
+  if(!error && decoder.check_adler32 && lodepng_read32bitInt(decoder.bands[numbands - 1].trailer) != adler)
+  {
+    error = 1; // decodeScanlines gives the error
+  }
+  free(decoder.bands);
+  return error;
+}
+
+// Rows of the ring of a PipelineDecoder, in which the threads hand the rows on to each other.
+#define PIPELINE_ROWS 64
+
+/*Decodes an image without interlacing in stages on separate threads: the calling thread inflates the
+scanlines into a ring of rows, one thread unfilters them in order, and the others convert the unfiltered
+rows to the output, each taking the next row that is ready. The slot of row y in the ring is y % numslots,
+it's reused for row y + numslots once row y is converted.*/
+typedef struct PipelineDecoder
+{
+  unsigned char* out;
+  size_t stride;
+  size_t outlinebits;
+  unsigned w, h;
+  const LodePNGColorMode* mode_out;
+  const LodePNGColorMode* mode_in;
+  size_t linebytes;
+  size_t bytewidth;
+  unsigned direct; // the unfiltered rows are the output, as in decodeScanlineRows
+  unsigned packed; // rows of out don't start at a byte, the unfilter thread converts them
+  unsigned fanout; // the converter threads convert the rows, otherwise the unfilter thread does
+  size_t numslots;
+  unsigned char* filtered; // the ring of scanlines with filter byte
+  unsigned char* unfiltered; // the ring of unfiltered scanlines
+  unsigned char* done; // the row in each slot of the ring is converted
+  unsigned inflated; // amount of rows inflated into the ring
+  unsigned unfiltered_rows; // amount of rows unfiltered
+  unsigned nextconvert; // next row for a converter thread
+  unsigned freed; // the rows before this are converted, their slots can be reused
+  unsigned limit; // row at which a stage gave error, rows from there on aren't decoded
+  unsigned error;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond; // signaled whenever any of the above changes
+} PipelineDecoder;
+
+/*Gives the error that decoding row y gave. Like decoding on a single thread, the error of the first
+row that fails wins, the rows before it are still decoded.*/
+static void PipelineDecoder_fail(PipelineDecoder* decoder, unsigned y, unsigned error)
+{
+  pthread_mutex_lock(&decoder->mutex);
+  if(y < decoder->limit)
+  {
+    decoder->limit = y;
+    decoder->error = error;
+  }
+  pthread_cond_broadcast(&decoder->cond);
+  pthread_mutex_unlock(&decoder->mutex);
+}
+
+// Marks row y as converted, so that the inflater can reuse the slots of the rows up to the first unconverted one.
+static void PipelineDecoder_done(PipelineDecoder* decoder, unsigned y)
+{
+  pthread_mutex_lock(&decoder->mutex);
+  decoder->done[y % decoder->numslots] = 1;
+  while(decoder->freed < decoder->h && decoder->done[decoder->freed % decoder->numslots])
+  {
+    decoder->done[decoder->freed % decoder->numslots] = 0;
+    ++decoder->freed;
+  }
+  pthread_cond_broadcast(&decoder->cond);
+  pthread_mutex_unlock(&decoder->mutex);
+}
+
+static void* pipelineUnfilterThread(void* arg)
+{
+  PipelineDecoder* decoder = (PipelineDecoder*)arg;
+  ColorConvert convert;
+  ColorConvert_init(&convert, decoder->mode_out, decoder->mode_in);
+  UnfilterKernels kernels;
+  getUnfilterKernels(&kernels, decoder->bytewidth);
+  size_t outlinebytes = (decoder->outlinebits + 7) / 8;
+  unsigned char* converted = decoder->packed ? (unsigned char*)malloc(outlinebytes) : 0;
+
+  if(decoder->packed && !converted) PipelineDecoder_fail(decoder, 0, 83); // alloc fail
+  const unsigned char* prevline = 0;
+  for(unsigned y = 0; y < decoder->h; ++y)
+  {
+    pthread_mutex_lock(&decoder->mutex);
+    while(y >= decoder->inflated && y < decoder->limit) pthread_cond_wait(&decoder->cond, &decoder->mutex);
+    unsigned stop = y >= decoder->limit;
+    pthread_mutex_unlock(&decoder->mutex);
+    if(stop) break;
+
+    size_t slot = y % decoder->numslots;
+    const unsigned char* scanline = decoder->filtered + slot * (decoder->linebytes + 1);
+    unsigned char* curline = decoder->direct ? decoder->out + y * decoder->stride
+                                             : decoder->unfiltered + slot * decoder->linebytes;
+    unsigned error = unfilterScanline(curline, scanline + 1, prevline, decoder->bytewidth, scanline[0],
+                                      decoder->linebytes, &kernels);
+    if(error)
+    {
+      PipelineDecoder_fail(decoder, y, error);
+      break;
+    }
+    prevline = curline;
+
+    if(decoder->fanout)
+    {
+      pthread_mutex_lock(&decoder->mutex);
+      decoder->unfiltered_rows = y + 1;
+      pthread_cond_broadcast(&decoder->cond);
+      pthread_mutex_unlock(&decoder->mutex);
+      continue;
+    }
+    if(decoder->direct) {}
+    else if(convert.copy) copyBitsToReversedStream(decoder->out, y * decoder->outlinebits, curline, decoder->outlinebits);
+    else if(decoder->packed)
+    {
+      error = ColorConvert_pixels(&convert, converted, curline, decoder->w);
+      if(!error) copyBitsToReversedStream(decoder->out, y * decoder->outlinebits, converted, decoder->outlinebits);
+    }
+    else error = ColorConvert_pixels(&convert, decoder->out + y * decoder->stride, curline, decoder->w);
+    if(error)
+    {
+      PipelineDecoder_fail(decoder, y, error);
+      break;
+    }
+    PipelineDecoder_done(decoder, y);
+  }
+
+  free(converted);
+  ColorConvert_cleanup(&convert);
+  return 0;
+}
+
+static void* pipelineConvertThread(void* arg)
+{
+  PipelineDecoder* decoder = (PipelineDecoder*)arg;
+  ColorConvert convert;
+  ColorConvert_init(&convert, decoder->mode_out, decoder->mode_in);
+  for(;;)
+  {
+    pthread_mutex_lock(&decoder->mutex);
+    while(decoder->nextconvert >= decoder->unfiltered_rows && decoder->nextconvert < decoder->limit
+          && decoder->nextconvert < decoder->h)
+    {
+      pthread_cond_wait(&decoder->cond, &decoder->mutex);
+    }
+    unsigned y = decoder->nextconvert;
+    unsigned stop = y >= decoder->limit || y >= decoder->h;
+    if(!stop) ++decoder->nextconvert;
+    pthread_mutex_unlock(&decoder->mutex);
+    if(stop) break;
+
+    const unsigned char* in = decoder->unfiltered + (y % decoder->numslots) * decoder->linebytes;
+    unsigned error = ColorConvert_pixels(&convert, decoder->out + y * decoder->stride, in, decoder->w);
+    if(error) PipelineDecoder_fail(decoder, y, error);
+    else PipelineDecoder_done(decoder, y);
+  }
+  ColorConvert_cleanup(&convert);
+  return 0;
+}
+
+/*Decodes an image without interlacing with a PipelineDecoder on the given amount of threads, at least 2,
+giving the same pixels and errors as decodeScanlines. Returns 0 and sets *error if the threads decoded
+it, 1 if no thread could be started, then decodeScanlines has to decode it instead.*/
+static unsigned decodePipelined(unsigned* error, unsigned char* out, size_t stride, unsigned w, unsigned h,
+                                const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
+                                const spanvector* idat, const LodePNGDecompressSettings* zlibsettings,
+                                unsigned numthreads)
+{
+  unsigned bpp = lodepng_get_bpp(mode_in);
+  if(bpp == 0)
+  {
+    *error = 31; // error: invalid colortype
+    return 0;
+  }
+
+  PipelineDecoder decoder;
+  decoder.w = w;
+  decoder.h = h;
+  decoder.mode_out = mode_out;
+  decoder.mode_in = mode_in;
+  decoder.bytewidth = (bpp + 7) / 8;
+  decoder.linebytes = ((size_t)w * bpp + 7) / 8;
+  decoder.outlinebits = (size_t)w * lodepng_get_bpp(mode_out);
+  unsigned copy = lodepng_color_mode_equal(mode_out, mode_in);
+  unsigned aligned = stride != 0 || decoder.outlinebits % 8 == 0;
+  decoder.out = out;
+  decoder.stride = stride ? stride : (decoder.outlinebits + 7) / 8;
+  decoder.direct = copy && aligned;
+  decoder.packed = !copy && !aligned;
+  decoder.fanout = 0;
+  decoder.numslots = h < PIPELINE_ROWS ? h : PIPELINE_ROWS;
+  decoder.inflated = decoder.unfiltered_rows = decoder.nextconvert = decoder.freed = 0;
+  decoder.limit = (unsigned)-1;
+  decoder.error = 0;
+  decoder.filtered = (unsigned char*)malloc(decoder.numslots * (decoder.linebytes + 1));
+  decoder.unfiltered = (unsigned char*)malloc(decoder.direct ? 1 : decoder.numslots * decoder.linebytes);
+  decoder.done = (unsigned char*)calloc(decoder.numslots, 1);
+
+  ucvector window;
+  ucvector_init(&window);
+  *error = 0;
+  if(!decoder.filtered || !decoder.unfiltered || !decoder.done
+     || !ucvector_reserve(&window, inflateWindowSize(decoder.linebytes))) *error = 83; // alloc fail
+  // the padding bits at the end of the image are left untouched by the bit copies
+  if(!*error && !aligned) out[(decoder.outlinebits * h + 7) / 8 - 1] = 0;
+
+  pthread_t threads[64];
+  size_t numstarted = 0;
+  if(!*error)
+  {
+    pthread_mutex_init(&decoder.mutex, 0);
+    pthread_cond_init(&decoder.cond, 0);
+    // the unfilter thread waits for the mutex, until fanout is known
+    pthread_mutex_lock(&decoder.mutex);
+    if(startThread(&threads[0], pipelineUnfilterThread, &decoder)) ++numstarted;
+    // converting rows that don't start at a byte on several threads would write the same bytes
+    if(numstarted != 0 && !copy && !decoder.packed)
+    {
+      if(numthreads > 64) numthreads = 64;
+      while(numstarted + 1 < numthreads
+            && startThread(&threads[numstarted], pipelineConvertThread, &decoder)) ++numstarted;
+      decoder.fanout = numstarted > 1;
+    }
+    pthread_mutex_unlock(&decoder.mutex);
+  }
+
+  Inflator inflator;
+  Inflator_init(&inflator, idat->data, idat->size, &window, 1);
+  inflator.check_adler32 = zlibsettings->check_adler32;
+  if(!*error && numstarted != 0)
+  {
+    unsigned rowerror = readZlibHeader(&inflator.reader);
+    size_t start = 0; // position of the current scanline, with its filter byte, in the window
+    unsigned y;
+    for(y = 0; y < h && !rowerror; ++y)
+    {
+      rowerror = inflateWindow(&inflator, &start, decoder.linebytes + 1);
+      if(rowerror) break;
+      if(inflator.pos < start + decoder.linebytes + 1)
+      {
+        rowerror = 91; // decompressed size doesn't match prediction
+        break;
+      }
+
+      pthread_mutex_lock(&decoder.mutex);
+      while(y >= decoder.freed + decoder.numslots && y < decoder.limit) pthread_cond_wait(&decoder.cond, &decoder.mutex);
+      unsigned stop = y >= decoder.limit;
+      pthread_mutex_unlock(&decoder.mutex);
+      if(stop) break;
+
+      memcpy(decoder.filtered + (y % decoder.numslots) * (decoder.linebytes + 1), window.data + start,
+             decoder.linebytes + 1);
+      start += decoder.linebytes + 1;
+      pthread_mutex_lock(&decoder.mutex);
+      decoder.inflated = y + 1;
+      pthread_cond_broadcast(&decoder.cond);
+      pthread_mutex_unlock(&decoder.mutex);
+    }
+    // after the last row, errors in the rest of the zlib data come after those of all rows
+    if(!rowerror && y == h) rowerror = checkScanlinesEnd(&inflator, &start);
+    if(!rowerror && y == h && zlibsettings->check_adler32) rowerror = checkZlibAdler32(&inflator);
+    if(rowerror) PipelineDecoder_fail(&decoder, y, rowerror);
+  }
+  for(size_t i = 0; i != numstarted; ++i) pthread_join(threads[i], 0);
+  if(!*error)
+  {
+    if(numstarted != 0) *error = decoder.error;
+    pthread_mutex_destroy(&decoder.mutex);
+    pthread_cond_destroy(&decoder.cond);
+  }
+
+  Inflator_cleanup(&inflator);
+  ucvector_cleanup(&window);
+  free(decoder.filtered);
+  free(decoder.unfiltered);
+  free(decoder.done);
+  return !*error && numstarted == 0;
+}
+
+// The rows of an Adam7 image that deinterlaceThreaded puts together on one thread.
+typedef struct DeinterlacePart
+{
+  unsigned char* out;
+  size_t stride;
+  unsigned w, h;
+  const unsigned char* in;
+  unsigned y0, y1;
+  const LodePNGColorMode* mode_out;
+  const LodePNGColorMode* mode_in;
+  unsigned error;
+} DeinterlacePart;
+
+static void* deinterlacePartThread(void* arg)
+{
+  DeinterlacePart* part = (DeinterlacePart*)arg;
+  part->error = Adam7_deinterlace(part->out, part->stride, part->w, part->h, part->in, part->y0, part->y1,
+                                  part->mode_out, part->mode_in);
+  return 0;
+}
+
+/*Same as Adam7_deinterlace for all rows, but on the given amount of threads, each taking a part of
+the rows that is a multiple of 8 rows, so that the parts start at a byte in out. return value is error*/
+static unsigned deinterlaceThreaded(unsigned char* out, size_t stride, unsigned w, unsigned h,
+                                    const unsigned char* in,
+                                    const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
+                                    unsigned numthreads)
+{
+  DeinterlacePart parts[64];
+  pthread_t threads[64];
+  unsigned started[64];
+  if(numthreads > 64) numthreads = 64;
+  unsigned partrows = ((h / numthreads) + 7) & ~7u;
+  if(partrows < 64) partrows = 64;
+  unsigned numparts = (h + partrows - 1) / partrows;
+
+  for(unsigned i = 0; i != numparts; ++i)
+  {
+    parts[i].out = out;
+    parts[i].stride = stride;
+    parts[i].w = w;
+    parts[i].h = h;
+    parts[i].in = in;
+    parts[i].y0 = i * partrows;
+    parts[i].y1 = h - parts[i].y0 < partrows ? h : parts[i].y0 + partrows;
+    parts[i].mode_out = mode_out;
+    parts[i].mode_in = mode_in;
+    parts[i].error = 0;
+    // the first part is done on this thread, as are the ones no thread could be started for
+    started[i] = i != 0 && startThread(&threads[i], deinterlacePartThread, &parts[i]);
+  }
+  if(numparts != 0) deinterlacePartThread(&parts[0]);
+  unsigned error = 0;
+  for(unsigned i = 0; i != numparts; ++i)
+  {
+    if(i != 0 && started[i]) pthread_join(threads[i], 0);
+    else if(i != 0) deinterlacePartThread(&parts[i]);
+    // the error of the first row that fails, as on a single thread
+    if(!error) error = parts[i].error;
+  }
+  return error;
+}
+
+#endif // LODEPNG_COMPILE_THREADS
+
+/*Unfilters and converts the scanlines of an image one at a time, in the order they're decompressed: all
+rows of an image without interlacing, or of each of the reduced images of an Adam7 image in turn, which
+are given to a callback. Used when the decompressed data arrives piece by piece. Only the pixels in a
+region of the image are converted and given to the callback, the scanlines after the last one that has
+pixels in it are not decoded at all.*/
+typedef struct RowDecoder
+{
+  unsigned w, h;
+  unsigned bpp;
+  size_t bytewidth;
+  unsigned numpasses; // 7 for Adam7, the reduced images, otherwise 1
+  unsigned passw[7], passh[7];
+  unsigned pass; // the current pass, numpasses when all rows are done
+  unsigned y; // the next row of the current pass
+  size_t maxlinebytes; // the longest scanline of all passes, without filter byte
+  unsigned char* lines; // previous and current unfiltered scanline, then the converted row
+  unsigned char* prevline; // the previous scanline of the current pass, 0 at its start
+  // per pass, the columns and rows of the reduced image that have pixels in the region
+  unsigned regionx0[7], regionx1[7], regiony0[7], regiony1[7];
+  size_t rowsleft; // scanlines to decode, up to the last one with pixels in the region
+  unsigned stopearly; // the region ends before the last scanline, the rest of the data is not needed
+  UnfilterKernels kernels;
+  ColorConvert convert;
+} RowDecoder;
+
+// Moves on to the next pass that has pixels, if the current one is done.
+static void RowDecoder_skipEmpty(RowDecoder* rows)
+{
+  while(rows->pass != rows->numpasses && rows->y == rows->passh[rows->pass])
+  {
+    ++rows->pass;
+    rows->y = 0;
+    rows->prevline = 0;
+  }
+}
+
+/*Sets the region of w * h pixels at x, y of the image, which must be inside the image. Only done before
+the first scanline is decoded.*/
+static void RowDecoder_setRegion(RowDecoder* rows, unsigned x, unsigned y, unsigned w, unsigned h)
+{
+  size_t numrows = 0; // scanlines of the passes before the current one
+  rows->rowsleft = 0;
+  for(unsigned p = 0; p != rows->numpasses; ++p)
+  {
+    unsigned ix = 0, iy = 0, dx = 1, dy = 1;
+    if(rows->numpasses == 7)
+    {
+      ix = ADAM7_IX[p];
+      iy = ADAM7_IY[p];
+      dx = ADAM7_DX[p];
+      dy = ADAM7_DY[p];
+    }
+    // the first pixel at or after the start of the region, and the first one at or after its end
+    unsigned x0 = x > ix ? (x - ix + dx - 1) / dx : 0;
+    unsigned x1 = x + w > ix ? (x + w - ix + dx - 1) / dx : 0;
+    unsigned y0 = y > iy ? (y - iy + dy - 1) / dy : 0;
+    unsigned y1 = y + h > iy ? (y + h - iy + dy - 1) / dy : 0;
+    if(x1 > rows->passw[p]) x1 = rows->passw[p];
+    if(y1 > rows->passh[p]) y1 = rows->passh[p];
+    if(x0 >= x1 || y0 >= y1) x0 = x1 = y0 = y1 = 0; // no pixels of this pass are in the region
+    // pixels smaller than a byte are converted from the start of a byte
+    if(rows->bpp < 8) x0 -= x0 % (8 / rows->bpp);
+    rows->regionx0[p] = x0;
+    rows->regionx1[p] = x1;
+    rows->regiony0[p] = y0;
+    rows->regiony1[p] = y1;
+    if(y0 < y1) rows->rowsleft = numrows + y1;
+    numrows += rows->passh[p];
+  }
+  rows->stopearly = rows->rowsleft != numrows;
+}
+
+// return value is error
+static unsigned RowDecoder_init(RowDecoder* rows, unsigned w, unsigned h, unsigned interlace,
+                                const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in)
+{
+  rows->w = w;
+  rows->h = h;
+  rows->bpp = lodepng_get_bpp(mode_in);
+  rows->bytewidth = (rows->bpp + 7) / 8;
+  if(interlace)
+  {
+    size_t filter_passstart[8], padded_passstart[8], passstart[8];
+    Adam7_getpassvalues(rows->passw, rows->passh, filter_passstart, padded_passstart, passstart, w, h, rows->bpp);
+    rows->numpasses = 7;
+  }
+  else
+  {
+    rows->passw[0] = w;
+    rows->passh[0] = h;
+    rows->numpasses = 1;
+  }
+  rows->pass = rows->y = 0;
+  rows->prevline = 0;
+  RowDecoder_skipEmpty(rows);
+  getUnfilterKernels(&rows->kernels, rows->bytewidth);
+  ColorConvert_init(&rows->convert, mode_out, mode_in);
+  rows->lines = 0;
+  if(rows->bpp == 0) return 31; // error: invalid colortype
+  RowDecoder_setRegion(rows, 0, 0, w, h);
+
+  // no reduced image is wider than the image
+  rows->maxlinebytes = ((size_t)w * rows->bpp + 7) / 8;
+  size_t outlinebytes = ((size_t)w * lodepng_get_bpp(mode_out) + 7) / 8;
+  rows->lines = (unsigned char*)malloc(rows->maxlinebytes * 2 + (rows->convert.copy ? 0 : outlinebytes));
+  return rows->lines ? 0 : 83; // alloc fail
+}
+
+static void RowDecoder_cleanup(RowDecoder* rows)
+{
+  ColorConvert_cleanup(&rows->convert);
+  free(rows->lines);
+}
+
+// Size of the next scanline in the decompressed data, with its filter byte. 0 when all rows are done.
+static size_t RowDecoder_linesize(const RowDecoder* rows)
+{
+  if(rows->pass == rows->numpasses || rows->rowsleft == 0) return 0;
+  return ((size_t)rows->passw[rows->pass] * rows->bpp + 7) / 8 + 1;
+}
+
+/*Unfilters the next scanline, which is given with its filter byte, and converts its pixels in the
+region and gives them to callback. Without callback, the scanline is only unfiltered. return value is error*/
+static unsigned RowDecoder_decode(RowDecoder* rows, const unsigned char* scanline,
+                                  LodePNGRowCallback callback, void* user)
+{
+  unsigned pass = rows->pass;
+  size_t linebytes = RowDecoder_linesize(rows) - 1;
+  unsigned char* curline = rows->prevline == rows->lines ? rows->lines + rows->maxlinebytes : rows->lines;
+  CERROR_TRY_RETURN(unfilterScanline(curline, scanline + 1, rows->prevline, rows->bytewidth, scanline[0],
+                                     linebytes, &rows->kernels));
+
+  unsigned y = rows->y;
+  rows->prevline = curline;
+  ++rows->y;
+  --rows->rowsleft;
+  RowDecoder_skipEmpty(rows);
+  // the scanline is only needed as previous scanline if it has no pixels in the region
+  if(!callback || y < rows->regiony0[pass] || y >= rows->regiony1[pass]) return 0;
+
+  LodePNGRow row;
+  unsigned x0 = rows->regionx0[pass];
+  row.data = curline + (size_t)x0 * rows->bpp / 8;
+  row.width = rows->regionx1[pass] - x0;
+  if(!rows->convert.copy)
+  {
+    unsigned char* converted = rows->lines + rows->maxlinebytes * 2;
+    CERROR_TRY_RETURN(ColorConvert_pixels(&rows->convert, converted, row.data, row.width));
+    row.data = converted;
+  }
+  if(rows->numpasses == 7)
+  {
+    row.y = ADAM7_IY[pass] + y * ADAM7_DY[pass];
+    row.x0 = ADAM7_IX[pass] + x0 * ADAM7_DX[pass];
+    row.dx = ADAM7_DX[pass];
+  }
+  else
+  {
+    row.y = y;
+    row.x0 = x0;
+    row.dx = 1;
+  }
+  row.pass = rows->numpasses == 7 ? pass : 0;
+
+  if(callback(user, &row)) return 97; // the callback stops decoding
+  return 0;
+}
+
+/*Continues at scanline y of an image without interlacing, instead of at the first one. prevline is
+the unfiltered scanline before it, if y isn't 0. The region must not start above scanline y.*/
+static void RowDecoder_resume(RowDecoder* rows, unsigned y, const unsigned char* prevline)
+{
+  rows->y = y;
+  rows->rowsleft -= y;
+  rows->prevline = 0;
+  if(y == 0) return;
+  memcpy(rows->lines, prevline, ((size_t)rows->w * rows->bpp + 7) / 8);
+  rows->prevline = rows->lines;
+}
+
+// Size of the output window of the inflater for inflateRows, for the longest scanline of the image.
+static size_t RowDecoder_windowsize(const RowDecoder* rows)
+{
+  return inflateWindowSize(rows->maxlinebytes);
+}
+
+/*Inflates as far as the input of the inflater goes, into its output window of RowDecoder_windowsize
+bytes, and decodes each scanline that is complete. *start is the position of the next scanline in
+the window, the data before it is dropped once it's no longer needed as window of the inflater.
+return value is error*/
+static unsigned inflateRows(Inflator* inflator, RowDecoder* rows, size_t* start,
+                            LodePNGRowCallback callback, void* user)
+{
+  ucvector* window = inflator->out;
+  unsigned needinput = 0;
+  for(;;)
+  {
+    size_t linesize;
+    while((linesize = RowDecoder_linesize(rows)) != 0 && inflator->pos >= *start + linesize)
+    {
+      CERROR_TRY_RETURN(RowDecoder_decode(rows, window->data + *start, callback, user));
+      *start += linesize;
+    }
+    if(linesize == 0 && rows->stopearly) return 0; // the scanlines after the region aren't needed
+    // the zlib stream must end after the last scanline, more decompressed data means the image is corrupt
+    if(linesize == 0 && inflator->pos > *start) return 91;
+    if(inflator->done || needinput) return 0;
+
+    size_t target = window->allocsize - INFLATE_FAST_MARGIN;
+    if(inflator->pos + 32768 > target)
+    {
+      size_t amount = inflator->pos > 32768 ? inflator->pos - 32768 : 0;
+      if(amount > *start) amount = *start;
+      Inflator_discard(inflator, amount);
+      *start -= amount;
+    }
+    CERROR_TRY_RETURN(Inflator_run(inflator, target));
+    // with keepinput, the inflater can stop early to wait for more input
+    needinput = !inflator->done && inflator->pos < target;
+  }
+}
+
+/*Checks that the image data ended after the last scanline, once inflateRows went through all of the
+input. return value is error*/
+static unsigned inflateRowsEnd(Inflator* inflator, const RowDecoder* rows, size_t start)
+{
+  if(rows->stopearly) return 0; // the data after the region wasn't inflated, so can't be checked
+  // decompressed size doesn't match prediction
+  if(RowDecoder_linesize(rows) != 0 || inflator->pos > start) return 91;
+  if(inflator->check_adler32) return checkZlibAdler32(inflator);
+  return 0;
+}
+
+/*A point in the image data of a PNG without interlacing where decoding can start, instead of at the
+start of the zlib data: the start of a deflate block, at which the inflater has no other state than
+the output before it.*/
+typedef struct IndexCheckpoint
+{
+  size_t bitpos; // position of the block in the zlib data, in bits
+  unsigned y; // scanline that the output of the block starts in
+  size_t linepos; // bytes of scanline y, with its filter byte, that come before the block
+  const unsigned char* window; // the output before the block, at least the last 32K of it and linepos bytes
+  size_t windowsize;
+  const unsigned char* prevline; // unfiltered scanline y - 1, if y isn't 0
+} IndexCheckpoint;
+
+/*Decodes the image data of the PNG, found by decodeChunks, a row at a time, giving the pixels of the
+rows in the region of rw * rh pixels at x, y to callback instead of storing them. If checkpoint isn't 0,
+starts decoding there. return value is error*/
+static unsigned decodeRows(unsigned w, unsigned h, unsigned x, unsigned y, unsigned rw, unsigned rh,
+                           const LodePNGState* state, const spanvector* idat,
+                           const IndexCheckpoint* checkpoint, LodePNGRowCallback callback, void* user)
+{
+  RowDecoder rows;
+  ucvector window;
+  ucvector_init(&window);
+  unsigned error = RowDecoder_init(&rows, w, h, state->info_png.interlace_method,
+                                   &state->info_raw, &state->info_png.color);
+  if(!error) RowDecoder_setRegion(&rows, x, y, rw, rh);
+  if(!error && !ucvector_reserve(&window, RowDecoder_windowsize(&rows))) error = 83; // alloc fail
+
+  Inflator inflator;
+  Inflator_init(&inflator, idat->data, idat->size, &window, 1);
+  inflator.check_adler32 = state->decoder.zlibsettings.check_adler32;
+  size_t start = 0; // position of the next scanline in the window
+  if(!error && checkpoint)
+  {
+    BitReader_skip(&inflator.reader, checkpoint->bitpos);
+    memcpy(window.data, checkpoint->window, checkpoint->windowsize);
+    inflator.pos = inflator.adlerpos = window.size = checkpoint->windowsize;
+    inflator.check_adler32 = 0; // the data before the checkpoint isn't read
+    start = checkpoint->windowsize - checkpoint->linepos;
+    RowDecoder_resume(&rows, checkpoint->y, checkpoint->prevline);
+  }
+  else if(!error) error = readZlibHeader(&inflator.reader);
+  if(!error) error = inflateRows(&inflator, &rows, &start, callback, user);
+  if(!error) error = inflateRowsEnd(&inflator, &rows, start);
+
+  Inflator_cleanup(&inflator);
+  ucvector_cleanup(&window);
+  RowDecoder_cleanup(&rows);
+  return error;
+}
+
+/*Layout of the index that lodepng_index_build creates, all numbers are 32-bit big endian: "LPIX", the
+width and height of the image, the high and low half of the size of its zlib data, the amount of
+checkpoints, and the CRC32 of all other bytes of the index. Then for each checkpoint: the high and low
+half of bitpos, y, linepos, windowsize, the window, and the previous scanline if y isn't 0.*/
+#define INDEX_HEADER_SIZE 28
+#define INDEX_CHECKPOINT_SIZE 20 // without the window and previous scanline
+
+// returns 1 if success, 0 if failure
+static unsigned addIndexBytes(ucvector* index, const unsigned char* data, size_t size)
+{
+  size_t pos = index->size;
+  if(!ucvector_resize(index, pos + size)) return 0;
+  memcpy(index->data + pos, data, size);
+  return 1;
+}
+
+static unsigned addIndex32(ucvector* index, unsigned value)
+{
+  unsigned char buffer[4];
+  lodepng_set32bitInt(buffer, value);
+  return addIndexBytes(index, buffer, 4);
+}
+
+// adds a size as two 32-bit numbers, to read the same on 32 and 64-bit systems
+static unsigned addIndexSize(ucvector* index, size_t value)
+{
+  return addIndex32(index, (unsigned)((uint64_t)value >> 32)) && addIndex32(index, (unsigned)value);
+}
+
+static uint64_t readIndexSize(const unsigned char* buffer)
+{
+  return lodepng_read64bitInt(buffer);
+}
+
+// the CRC32 of the index without the 4 bytes of the CRC itself, at the end of the header
+static unsigned indexCRC(const unsigned char* index, size_t indexsize)
+{
+  unsigned crc = crc32Update(0xffffffffu, index, INDEX_HEADER_SIZE - 4);
+  return ~crc32Update(crc, index + INDEX_HEADER_SIZE, indexsize - INDEX_HEADER_SIZE);
+}
+
+/*Decodes the image data of the PNG like decodeRows, but only unfilters it, and adds a checkpoint to
+index at the start of each deflate block that begins at least spacing bytes of decompressed data after
+the previous checkpoint. Images with Adam7 get none. return value is error*/
+static unsigned buildIndex(ucvector* index, unsigned w, unsigned h, const LodePNGState* state,
+                           const spanvector* idat, size_t spacing)
+{
+  RowDecoder rows;
+  ucvector window;
+  ucvector_init(&window);
+  unsigned error = RowDecoder_init(&rows, w, h, state->info_png.interlace_method,
+                                   &state->info_raw, &state->info_png.color);
+  if(!error && !ucvector_reserve(&window, RowDecoder_windowsize(&rows))) error = 83; // alloc fail
+
+  size_t idatsize = spanvector_bytes(idat);
+  if(!error && !(addIndexBytes(index, (const unsigned char*)"LPIX", 4) && addIndex32(index, w)
+                 && addIndex32(index, h) && addIndexSize(index, idatsize) && addIndex32(index, 0)
+                 && addIndex32(index, 0)))
+  {
+    error = 83; // alloc fail
+  }
+
+  Inflator inflator;
+  Inflator_init(&inflator, idat->data, idat->size, &window, 1);
+  inflator.check_adler32 = state->decoder.zlibsettings.check_adler32;
+  inflator.stopatblock = 1;
+  size_t start = 0; // position of the next scanline in the window
+  size_t linebytes = ((size_t)w * rows.bpp + 7) / 8;
+  size_t lastpos = 0; // position of the last checkpoint in the decompressed data
+  unsigned numcheckpoints = 0;
+  if(!error) error = readZlibHeader(&inflator.reader);
+  while(!error)
+  {
+    // returns at the end of each block, after the scanlines that are complete
+    error = inflateRows(&inflator, &rows, &start, 0, 0);
+    if(error || inflator.done) break;
+    if(rows.numpasses != 1 || RowDecoder_linesize(&rows) == 0) continue;
+
+    size_t linepos = inflator.pos - start;
+    size_t pos = (size_t)rows.y * (linebytes + 1) + linepos;
+    if(numcheckpoints != 0 && pos - lastpos < spacing) continue;
+    // the window: the last 32K of output, and the start of scanline y
+    size_t windowstart = inflator.pos > 32768 ? inflator.pos - 32768 : 0;
+    if(windowstart > start) windowstart = start;
+    size_t windowsize = inflator.pos - windowstart;
+    if(!(addIndexSize(index, BitReader_position(&inflator.reader, idatsize)) && addIndex32(index, rows.y)
+         && addIndex32(index, (unsigned)linepos) && addIndex32(index, (unsigned)windowsize)
+         && addIndexBytes(index, window.data + windowstart, windowsize)
+         && (rows.y == 0 || addIndexBytes(index, rows.prevline, linebytes))))
+    {
+      error = 83; // alloc fail
+    }
+    lastpos = pos;
+    ++numcheckpoints;
+  }
+  if(!error) error = inflateRowsEnd(&inflator, &rows, start);
+  if(!error)
+  {
+    lodepng_set32bitInt(index->data + INDEX_HEADER_SIZE - 8, numcheckpoints);
+    lodepng_set32bitInt(index->data + INDEX_HEADER_SIZE - 4, indexCRC(index->data, index->size));
+  }
+
+  Inflator_cleanup(&inflator);
+  ucvector_cleanup(&window);
+  RowDecoder_cleanup(&rows);
+  return error;
+}
+
+/*Finds the last checkpoint in index that isn't after scanline y. checkpoint->window is 0 if there is
+none. return value is error*/
+static unsigned findCheckpoint(IndexCheckpoint* checkpoint, const unsigned char* index, size_t indexsize,
+                               unsigned w, unsigned h, const LodePNGState* state, const spanvector* idat,
+                               unsigned y)
+{
+  checkpoint->window = 0;
+  size_t idatsize = spanvector_bytes(idat);
+  size_t linebytes = ((size_t)w * lodepng_get_bpp(&state->info_png.color) + 7) / 8;
+  if(indexsize < INDEX_HEADER_SIZE || memcmp(index, "LPIX", 4) != 0) return 99; // error: not an index
+  if(lodepng_read32bitInt(index + 4) != w || lodepng_read32bitInt(index + 8) != h
+     || readIndexSize(index + 12) != idatsize) return 99; // error: index of another PNG
+  if(lodepng_read32bitInt(index + 24) != indexCRC(index, indexsize)) return 99; // error: corrupted index
+  unsigned numcheckpoints = lodepng_read32bitInt(index + 20);
+  if(numcheckpoints != 0 && state->info_png.interlace_method != 0) return 99;
+
+  size_t pos = INDEX_HEADER_SIZE;
+  for(unsigned i = 0; i != numcheckpoints; ++i)
+  {
+    if(indexsize - pos < INDEX_CHECKPOINT_SIZE) return 99; // error: index too small
+    IndexCheckpoint current;
+    uint64_t bitpos = readIndexSize(index + pos);
+    current.y = lodepng_read32bitInt(index + pos + 8);
+    current.linepos = lodepng_read32bitInt(index + pos + 12);
+    current.windowsize = lodepng_read32bitInt(index + pos + 16);
+    pos += INDEX_CHECKPOINT_SIZE;
+    size_t prevsize = current.y ? linebytes : 0;
+    if(current.windowsize > indexsize - pos || prevsize > indexsize - pos - current.windowsize) return 99;
+    // the checkpoint must be inside the image data, and the window must fit in the one of decodeRows
+    if(bitpos > (uint64_t)idatsize * 8 || current.y >= h || current.linepos > linebytes
+       || current.linepos > current.windowsize || current.windowsize > 32768 + linebytes + 1) return 99;
+    current.bitpos = (size_t)bitpos;
+    current.window = index + pos;
+    current.prevline = index + pos + current.windowsize;
+    pos += current.windowsize + prevsize;
+    if(current.y > y) break; // the checkpoints are in order
+    *checkpoint = current;
+  }
+  return 0;
+}
+
+/*Checks that the PNG, of which state->info_png has the header, can be decoded to the color mode
+state->info_raw. return value is error: 56 for an unsupported conversion, 101 for a sample format other
+than big endian without 16-bit output*/
+static unsigned checkRawColorMode(const LodePNGState* state)
+{
+  if(state->info_raw.sampleformat != LSF_BIG_ENDIAN && state->info_raw.bitdepth != 16)
+  {
+    return 101; // native endian and float samples are only for 16 bits per sample
+  }
+  if(!lodepng_color_mode_equal_pixels(&state->info_raw, &state->info_png.color))
+  {
+    /*TODO: check if this works according to the statement in the documentation: "The converter can convert
+    from greyscale input color type, to 8-bit greyscale or greyscale with alpha"*/
+    // palette output without colors keeps the indices of a palette PNG, at any bitdepth
+    unsigned indices = state->info_raw.colortype == LCT_PALETTE && state->info_raw.palettesize == 0
+                    && state->info_png.color.colortype == LCT_PALETTE;
+    if(!(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+       && !(state->info_raw.bitdepth == 8) && !indices)
+    {
+      return 56; // unsupported color mode conversion
+    }
+  }
+  return 0;
+}
+
+/*Reads the header and the chunks of the PNG, and checks that it can be decoded to the color mode
+state->info_raw. idat receives where the compressed image data is in the input. If bands isn't 0, it
+receives the data of the lpBD chunk, or 0 if there is none before the image data.
+return value is error*/
+static unsigned decodeChunks(unsigned* w, unsigned* h, spanvector* idat, ByteSpan* bands,
+                             LodePNGState* state, const unsigned char* in, size_t insize)
+{
+  unsigned char IEND = 0;
+  const unsigned char* chunk;
+  size_t numpixels;
+
+  // for unknown chunk order
+  unsigned unknown = 0;
+
+  if(bands)
+  {
+    bands->data = 0;
+    bands->size = 0;
+  }
+  state->error = lodepng_inspect(w, h, state, in, insize); // reads header and resets other parameters in state->info_png
+  if(state->error) return state->error;
+
+  numpixels = *w * *h;
+
+  // multiplication overflow
+  if(*h != 0 && numpixels / *h != *w) CERROR_RETURN_ERROR(state->error, 92);
+  /*multiplication overflow possible further below. Allows up to 2^31-1 pixel
+  bytes with 16-bit RGBA, the rest is room for filter bytes.*/
+  if(numpixels > 268435455) CERROR_RETURN_ERROR(state->error, 92);
+
+  chunk = &in[33]; // first byte of the first chunk after the header
+
+  /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
+  IDAT data is put at the start of the in buffer*/
+  while(!IEND && !state->error)
+  {
+    unsigned chunkLength;
+    const unsigned char* data; // the data in the chunk
+
+    // error: size of the in buffer too small to contain next chunk
+    if((size_t)((chunk - in) + 12) > insize || chunk < in)
+    {
+      break; // other errors may still happen though
+    }
+
+    // length of the data of the chunk, excluding the length bytes, chunk type and CRC bytes
+    chunkLength = lodepng_chunk_length(chunk);
+    // error: chunk length larger than the max PNG chunk size
+    if(chunkLength > 2147483647)
+    {
+      break; // other errors may still happen though
+    }
+
+    if((size_t)((chunk - in) + chunkLength + 12) > insize || (chunk + chunkLength + 12) < in)
+    {
+      CERROR_BREAK(state->error, 64); // error: size of the in buffer too small to contain next chunk
+    }
+
+    if(state->decoder.check_crc && lodepng_chunk_check_crc(chunk))
+    {
+      CERROR_BREAK(state->error, 57); // error: wrong CRC
+    }
+
+    data = lodepng_chunk_data_const(chunk);
+
+    // IDAT chunk, containing compressed image data
+    if(lodepng_chunk_type_equals(chunk, "IDAT"))
+    {
+      // the data is decompressed in place later, only remember where it is
+      if(!spanvector_push_back(idat, data, chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+    }
+    // IEND chunk
+    else if(lodepng_chunk_type_equals(chunk, "IEND"))
+    {
+      IEND = 1;
+    }
+    // palette chunk (PLTE)
+    else if(lodepng_chunk_type_equals(chunk, "PLTE"))
+    {
+      state->error = readChunk_PLTE(&state->info_png.color, data, chunkLength);
       if(state->error) break;
     }
     // palette transparency chunk (tRNS)
     else if(lodepng_chunk_type_equals(chunk, "tRNS"))
     {
-      state->error = readChunk_tRNS(&state->info_png.color, data, chunkLength);
-      if(state->error) break;
+      state->error = readChunk_tRNS(&state->info_png.color, data, chunkLength);
+      if(state->error) break;
+    }
+    // where the bands of the image data start, for decoding them in parallel
+    else if(lodepng_chunk_type_equals(chunk, "lpBD"))
+    {
+      if(bands && idat->size == 0)
+      {
+        bands->data = data;
+        bands->size = chunkLength;
+      }
+    }
+    else // it's not an implemented chunk type, so ignore it: skip over the data
+    {
+      // error: unknown critical chunk (5th bit of first byte of chunk type is 0)
+      unknown = 1;
+    }
+
+    if(!IEND) chunk = lodepng_chunk_next_const(chunk);
+  }
+
+  if(!state->error) state->error = checkRawColorMode(state);
+  return state->error;
+}
+
+/*Decodes the image data of the PNG, found by decodeChunks, into out in the color mode
+state->info_raw. stride is as in decodeScanlines. Images without interlacing are inflated, unfiltered
+and converted a scanline at a time. Adam7 images are inflated in full and unfiltered pass by pass, then
+each row of the passes is converted and scattered into out. return value is error*/
+static unsigned decodePixels(unsigned char* out, size_t stride, unsigned w, unsigned h,
+                             LodePNGState* state, const spanvector* idat, const ByteSpan* bands)
+{
+  const LodePNGColorMode* color = &state->info_png.color;
+  if(state->info_png.interlace_method == 0)
+  {
+#ifdef LODEPNG_COMPILE_THREADS
+    unsigned numthreads = state->decoder.num_threads;
+    if(bands->data && numthreads > 1 && decodeBands(out, stride, w, h, state, idat, bands, numthreads) == 0) return 0;
+    unsigned error;
+    if(state->decoder.pipeline && numthreads > 1
+       && decodePipelined(&error, out, stride, w, h, &state->info_raw, color, idat,
+                          &state->decoder.zlibsettings, numthreads) == 0) return error;
+#else // LODEPNG_COMPILE_THREADS
+    (void)bands;
+#endif // LODEPNG_COMPILE_THREADS
+    return decodeScanlines(out, stride, w, h, &state->info_raw, color, idat->data, idat->size,
+                           &state->decoder.zlibsettings);
+  }
+
+  // Adam-7 interlaced: the decompressed size is the sum of the 7 sub-images sizes
+  unsigned error = 0;
+  size_t predict = 0;
+  predict += lodepng_get_raw_size_idat((w + 7) >> 3, (h + 7) >> 3, color) + ((h + 7) >> 3);
+  if(w > 4) predict += lodepng_get_raw_size_idat((w + 3) >> 3, (h + 7) >> 3, color) + ((h + 7) >> 3);
+  predict += lodepng_get_raw_size_idat((w + 3) >> 2, (h + 3) >> 3, color) + ((h + 3) >> 3);
+  if(w > 2) predict += lodepng_get_raw_size_idat((w + 1) >> 2, (h + 3) >> 2, color) + ((h + 3) >> 2);
+  predict += lodepng_get_raw_size_idat((w + 1) >> 1, (h + 1) >> 2, color) + ((h + 1) >> 2);
+  if(w > 1) predict += lodepng_get_raw_size_idat((w + 0) >> 1, (h + 1) >> 1, color) + ((h + 1) >> 1);
+  predict += lodepng_get_raw_size_idat((w + 0), (h + 0) >> 1, color) + ((h + 0) >> 1);
+
+  ucvector scanlines;
+  ucvector_init(&scanlines);
+  if(!ucvector_reserve(&scanlines, predict)) error = 83; // alloc fail
+  if(!error)
+  {
+    // the reserved size is exact, so the inflater can write into it without growing it
+    error = lodepng_zlib_decompressv(&scanlines, idat->data, idat->size, 1, &state->decoder.zlibsettings);
+    if(!error && scanlines.size != predict) error = 91; // decompressed size doesn't match prediction
+  }
+  if(!error)
+  {
+#ifdef LODEPNG_COMPILE_THREADS
+    if(state->decoder.pipeline && state->decoder.num_threads > 1)
+    {
+      error = Adam7_unfilter(scanlines.data, w, h, lodepng_get_bpp(color));
+      if(!error)
+      {
+        error = deinterlaceThreaded(out, stride, w, h, scanlines.data, &state->info_raw, color,
+                                    state->decoder.num_threads);
+      }
+    }
+    else
+#endif // LODEPNG_COMPILE_THREADS
+    error = postProcessScanlines(out, stride, scanlines.data, w, h, &state->info_png, &state->info_raw);
+  }
+  ucvector_cleanup(&scanlines);
+  return error;
+}
+
+// read a PNG, the result will be in the color mode state->info_raw
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+                          LodePNGState* state,
+                          const unsigned char* in, size_t insize)
+{
+  spanvector idat; // where the data of the idat chunks is in the input
+  spanvector_init(&idat);
+
+  ByteSpan bands; // the lpBD chunk
+  // provide some proper output values if error will happen
+  *out = 0;
+
+  decodeChunks(w, h, &idat, &bands, state, in, insize);
+  if(!state->error)
+  {
+    *out = (unsigned char*)malloc(lodepng_get_raw_size(*w, *h, &state->info_raw));
+    if(!*out) state->error = 83; // alloc fail
+  }
+  if(!state->error) state->error = decodePixels(*out, 0, *w, *h, state, &idat, &bands);
+  spanvector_cleanup(&idat);
+
+  if(state->error)
+  {
+    free(*out);
+    *out = 0;
+  }
+}
+
+// The region that decodeRegion stores, and where.
+typedef struct RegionOutput
+{
+  unsigned char* out;
+  unsigned x, y, w;
+  unsigned bpp; // of the color mode of out
+} RegionOutput;
+
+// LodePNGRowCallback that stores the pixels of the rows that are in the region.
+static unsigned storeRegionRow(void* user, const LodePNGRow* row)
+{
+  RegionOutput* region = (RegionOutput*)user;
+  unsigned bpp = region->bpp;
+  // the row can start a few pixels before the region, when the pixels in the PNG are smaller than a byte
+  unsigned i = row->x0 < region->x ? (region->x - row->x0 + row->dx - 1) / row->dx : 0;
+  size_t outline = (size_t)(row->y - region->y) * region->w;
+  if(bpp >= 8 && row->dx == 1)
+  {
+    size_t bytewidth = bpp / 8;
+    memcpy(region->out + (outline + row->x0 + i - region->x) * bytewidth, row->data + (size_t)i * bytewidth,
+           (size_t)(row->width - i) * bytewidth);
+    return 0;
+  }
+  if(bpp < 8 && row->dx == 1)
+  {
+    // pixels one at a time until the row data is at a byte, then all others together
+    size_t ibp = (size_t)i * bpp, obp = (outline + row->x0 + (size_t)i - region->x) * bpp; // bit pointers
+    for(; i < row->width && (ibp & 7u) != 0; ++i)
+    {
+      for(unsigned b = 0; b < bpp; ++b)
+      {
+        setBitOfReversedStream(&obp, region->out, readBitFromReversedStream(&ibp, row->data));
+      }
     }
-    else // it's not an implemented chunk type, so ignore it: skip over the data
+    if(i < row->width) copyBitsToReversedStream(region->out, obp, row->data + ibp / 8, (size_t)(row->width - i) * bpp);
+    return 0;
+  }
+  for(; i < row->width; ++i)
+  {
+    size_t ibp = (size_t)i * bpp; // bit pointers
+    size_t obp = (outline + row->x0 + (size_t)i * row->dx - region->x) * bpp;
+    if(bpp >= 8) memcpy(region->out + obp / 8, row->data + ibp / 8, bpp / 8);
+    else
     {
-      // error: unknown critical chunk (5th bit of first byte of chunk type is 0)
-      unknown = 1;
+      for(unsigned b = 0; b < bpp; ++b)
+      {
+        setBitOfReversedStream(&obp, region->out, readBitFromReversedStream(&ibp, row->data));
+      }
     }
-
-    if(!IEND) chunk = lodepng_chunk_next_const(chunk);
   }
+  return 0;
+}
 
-  ucvector_init(&scanlines);
-  /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
-  If the decompressed size does not match the prediction, the image must be corrupt.*/
-  if(state->info_png.interlace_method == 0)
+// Decodes the region of rw * rh pixels at x, y. With an index, starts at its last checkpoint before the region.
+static void decodeRegion(unsigned char** out, unsigned* w, unsigned* h,
+                         LodePNGState* state,
+                         const unsigned char* in, size_t insize,
+                         const unsigned char* index, size_t indexsize,
+                         unsigned x, unsigned y, unsigned rw, unsigned rh)
+{
+  spanvector idat; // where the data of the idat chunks is in the input
+  spanvector_init(&idat);
+  *out = 0;
+
+  decodeChunks(w, h, &idat, 0, state, in, insize);
+  if(!state->error && (rw == 0 || rh == 0 || x >= *w || rw > *w - x || y >= *h || rh > *h - y))
   {
-    // The extra *h is added because this are the filter bytes every scanline starts with
-    predict = lodepng_get_raw_size_idat(*w, *h, &state->info_png.color) + *h;
+    state->error = 98; // error: region outside of the image
   }
-  else
-  {
-    // Adam-7 interlaced: predicted size is the sum of the 7 sub-images sizes
-    const LodePNGColorMode* color = &state->info_png.color;
-    predict = 0;
-    predict += lodepng_get_raw_size_idat((*w + 7) >> 3, (*h + 7) >> 3, color) + ((*h + 7) >> 3);
-    if(*w > 4) predict += lodepng_get_raw_size_idat((*w + 3) >> 3, (*h + 7) >> 3, color) + ((*h + 7) >> 3);
-    predict += lodepng_get_raw_size_idat((*w + 3) >> 2, (*h + 3) >> 3, color) + ((*h + 3) >> 3);
-    if(*w > 2) predict += lodepng_get_raw_size_idat((*w + 1) >> 2, (*h + 3) >> 2, color) + ((*h + 3) >> 2);
-    predict += lodepng_get_raw_size_idat((*w + 1) >> 1, (*h + 1) >> 2, color) + ((*h + 1) >> 2);
-    if(*w > 1) predict += lodepng_get_raw_size_idat((*w + 0) >> 1, (*h + 1) >> 1, color) + ((*h + 1) >> 1);
-    predict += lodepng_get_raw_size_idat((*w + 0), (*h + 0) >> 1, color) + ((*h + 0) >> 1);
-  }
-  if(!state->error && !ucvector_reserve(&scanlines, predict)) state->error = 83; // alloc fail
-  if(!state->error)
+  IndexCheckpoint checkpoint;
+  checkpoint.window = 0;
+  if(!state->error && index)
   {
-    state->error = lodepng_zlib_decompress(&scanlines.data, &scanlines.size, idat.data, idat.size);
-    if(!state->error && scanlines.size != predict) state->error = 91; // decompressed size doesn't match prediction
+    state->error = findCheckpoint(&checkpoint, index, indexsize, *w, *h, state, &idat, y);
   }
-  ucvector_cleanup(&idat);
-
   if(!state->error)
   {
-    outsize = lodepng_get_raw_size(*w, *h, &state->info_png.color);
-    *out = (unsigned char*)malloc(outsize);
+    size_t size = lodepng_get_raw_size(rw, rh, &state->info_raw);
+    *out = (unsigned char*)malloc(size);
     if(!*out) state->error = 83; // alloc fail
+    else memset(*out, 0, size); // the padding bits at the end of the image
   }
   if(!state->error)
   {
-    for(i = 0; i < outsize; i++) (*out)[i] = 0;
-    state->error = postProcessScanlines(*out, scanlines.data, *w, *h, &state->info_png);
+    RegionOutput region;
+    region.out = *out;
+    region.x = x;
+    region.y = y;
+    region.w = rw;
+    region.bpp = lodepng_get_bpp(&state->info_raw);
+    state->error = decodeRows(*w, *h, x, y, rw, rh, state, &idat, checkpoint.window ? &checkpoint : 0,
+                              storeRegionRow, &region);
   }
-  ucvector_cleanup(&scanlines);
+  spanvector_cleanup(&idat);
+
+  if(state->error)
+  {
+    free(*out);
+    *out = 0;
+  }
+}
+
+unsigned lodepng_decode_region(unsigned char** out, unsigned* w, unsigned* h,
+                               LodePNGState* state,
+                               const unsigned char* in, size_t insize,
+                               unsigned x, unsigned y, unsigned rw, unsigned rh)
+{
+  decodeRegion(out, w, h, state, in, insize, 0, 0, x, y, rw, rh);
+  return state->error;
+}
+
+unsigned lodepng_index_build(unsigned char** index, size_t* indexsize, LodePNGState* state,
+                             const unsigned char* in, size_t insize, size_t spacing)
+{
+  spanvector idat; // where the data of the idat chunks is in the input
+  spanvector_init(&idat);
+  ucvector v;
+  ucvector_init(&v);
+  unsigned w, h;
+  decodeChunks(&w, &h, &idat, 0, state, in, insize);
+  if(!state->error) state->error = buildIndex(&v, w, h, state, &idat, spacing);
+  spanvector_cleanup(&idat);
+  if(state->error) ucvector_cleanup(&v);
+  *index = v.data;
+  *indexsize = v.size;
+  return state->error;
+}
+
+unsigned lodepng_decode_region_indexed(unsigned char** out, unsigned* w, unsigned* h,
+                                       LodePNGState* state,
+                                       const unsigned char* in, size_t insize,
+                                       const unsigned char* index, size_t indexsize,
+                                       unsigned x, unsigned y, unsigned rw, unsigned rh)
+{
+  decodeRegion(out, w, h, state, in, insize, index, indexsize, x, y, rw, rh);
+  return state->error;
 }
 
 unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
@@ -3899,34 +8104,253 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
 {
   *out = 0;
   decodeGeneric(out, w, h, state, in, insize);
-  if(state->error) return state->error;
-  if(lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
+  return state->error;
+}
+
+/*Gives the size of the buffer for an image with the given row stride in the color mode, the end of
+its last row. stride 0 means packed rows. return value is error*/
+static unsigned getStrideImageSize(size_t* size, unsigned w, unsigned h, size_t stride, const LodePNGColorMode* mode)
+{
+  if(stride == 0)
   {
-    // same color type, no copying or converting of data needed
+    *size = lodepng_get_raw_size(w, h, mode);
+    return 0;
   }
-  else
+  size_t linebytes = ((size_t)w * lodepng_get_bpp(mode) + 7) / 8;
+  if(stride < linebytes) return 95; // error: stride smaller than a row
+  if((size_t)(h - 1) > ((size_t)(-1) - linebytes) / stride) return 92; // error: size overflow
+  *size = (size_t)(h - 1) * stride + linebytes;
+  return 0;
+}
+
+unsigned lodepng_decode_into_size(size_t* size, unsigned* w, unsigned* h, size_t stride,
+                                  LodePNGState* state, const unsigned char* in, size_t insize)
+{
+  *size = 0;
+  state->error = lodepng_inspect(w, h, state, in, insize);
+  if(!state->error) state->error = checkRawColorMode(state);
+  if(!state->error) state->error = getStrideImageSize(size, *w, *h, stride, &state->info_raw);
+  return state->error;
+}
+
+unsigned lodepng_decode_into(unsigned char* out, size_t outsize, size_t stride, unsigned* w, unsigned* h,
+                             LodePNGState* state, const unsigned char* in, size_t insize)
+{
+  spanvector idat; // where the data of the idat chunks is in the input
+  spanvector_init(&idat);
+  ByteSpan bands; // the lpBD chunk
+  size_t size = 0;
+
+  decodeChunks(w, h, &idat, &bands, state, in, insize);
+  if(!state->error) state->error = getStrideImageSize(&size, *w, *h, stride, &state->info_raw);
+  if(!state->error && outsize < size) state->error = 96; // error: out too small
+  if(!state->error) state->error = decodePixels(out, stride, *w, *h, state, &idat, &bands);
+  spanvector_cleanup(&idat);
+  return state->error;
+}
+
+unsigned lodepng_decode_indexed(unsigned char** out, unsigned* w, unsigned* h, LodePNGState* state,
+                                const unsigned char* in, size_t insize, unsigned packed)
+{
+  *out = 0;
+  state->error = lodepng_inspect(w, h, state, in, insize);
+  if(!state->error && state->info_png.color.colortype != LCT_PALETTE) state->error = 100; // error: no palette
+  if(state->error) return state->error;
+  // an output palette without colors keeps the indices, see ColorConvert_init
+  lodepng_palette_clear(&state->info_raw);
+  state->info_raw.colortype = LCT_PALETTE;
+  state->info_raw.bitdepth = packed ? state->info_png.color.bitdepth : 8;
+  decodeGeneric(out, w, h, state, in, insize);
+  return state->error;
+}
+
+unsigned lodepng_decode_rows(unsigned* w, unsigned* h, LodePNGState* state,
+                             const unsigned char* in, size_t insize,
+                             LodePNGRowCallback callback, void* user)
+{
+  spanvector idat; // where the data of the idat chunks is in the input
+  spanvector_init(&idat);
+  decodeChunks(w, h, &idat, 0, state, in, insize);
+  if(!state->error) state->error = decodeRows(*w, *h, 0, 0, *w, *h, state, &idat, 0, callback, user);
+  spanvector_cleanup(&idat);
+  return state->error;
+}
+
+void lodepng_planar_settings_init(LodePNGPlanarSettings* settings)
+{
+  settings->numchannels = 3;
+  settings->type = LPT_UINT8;
+  for(unsigned c = 0; c != 4; ++c)
   {
-    // color conversion needed; sort of copy of the data
-    unsigned char* data = *out;
-    size_t outsize;
+    settings->channels[c] = c;
+    settings->scale[c] = 1.0f;
+    settings->offset[c] = 0.0f;
+  }
+}
 
-    /*TODO: check if this works according to the statement in the documentation: "The converter can convert
-    from greyscale input color type, to 8-bit greyscale or greyscale with alpha"*/
-    if(!(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
-       && !(state->info_raw.bitdepth == 8))
+// The planes that lodepng_decode_planar stores, with the scale and offset for the samples of the rows.
+typedef struct PlanarOutput
+{
+  unsigned char* out;
+  size_t planesize; // in bytes
+  unsigned w;
+  unsigned numchannels;
+  unsigned channels[4];
+  LodePNGPlanarType type;
+  unsigned sixteen; // the rows are RGBA of 16 bits instead of 8
+  unsigned identity; // bytes that are stored as they are
+  float mul[4], add[4]; // per plane, value = sample of the row * mul + add, already times 255 for bytes
+} PlanarOutput;
+
+#ifdef LODEPNG_COMPILE_SIMD
+// Stores 8 samples as they are in the row, from 0 to 255 or 65535, as floats or bytes at out.
+static LODEPNG_TARGET("sse2") void storePlanar8_sse2(unsigned char* out, __m128i samples, unsigned isfloat,
+                                                     __m128 mul, __m128 add)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128 lo = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(samples, zero)), mul), add);
+  __m128 hi = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(samples, zero)), mul), add);
+  if(isfloat)
+  {
+    _mm_storeu_ps((float*)out, lo);
+    _mm_storeu_ps((float*)out + 4, hi);
+    return;
+  }
+  // the same clamping and rounding as storePlanarRow
+  const __m128 max = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+  lo = _mm_add_ps(_mm_min_ps(_mm_max_ps(lo, _mm_setzero_ps()), max), half);
+  hi = _mm_add_ps(_mm_min_ps(_mm_max_ps(hi, _mm_setzero_ps()), max), half);
+  __m128i bytes = _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi));
+  _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(bytes, zero));
+}
+
+/*Stores numpixels pixels of an RGBA row to the planes from element start on, 16 pixels of 8 bits or 8
+of 16 bits at a time. Returns amount of pixels done*/
+static LODEPNG_TARGET("ssse3") size_t storePlanar_ssse3(const PlanarOutput* planar, size_t start,
+                                                        const unsigned char* in, size_t numpixels)
+{
+  // per 16 bytes, each channel to its own 4 bytes: of 4 pixels of 8 bits, or of 2 of 16 bits in native endian
+  const __m128i shuffle = planar->sixteen ? _mm_setr_epi8(1, 0, 9, 8, 3, 2, 11, 10, 5, 4, 13, 12, 7, 6, 15, 14)
+                                          : _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+  const size_t step = planar->sixteen ? 8 : 16; // pixels in 64 bytes
+  const unsigned isfloat = planar->type == LPT_FLOAT32;
+  const size_t elemsize = isfloat ? 4 : 1;
+  const __m128i zero = _mm_setzero_si128();
+  __m128 mul[4], add[4];
+  for(unsigned c = 0; c != planar->numchannels; ++c)
+  {
+    mul[c] = _mm_set1_ps(planar->mul[c]);
+    add[c] = _mm_set1_ps(planar->add[c]);
+  }
+  size_t i = 0;
+  for(; i + step <= numpixels; i += step)
+  {
+    const unsigned char* p = in + i * (64 / step);
+    __m128i p0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), shuffle);
+    __m128i p1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 16)), shuffle);
+    __m128i p2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 32)), shuffle);
+    __m128i p3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 48)), shuffle);
+    __m128i rg01 = _mm_unpacklo_epi32(p0, p1), rg23 = _mm_unpacklo_epi32(p2, p3);
+    __m128i ba01 = _mm_unpackhi_epi32(p0, p1), ba23 = _mm_unpackhi_epi32(p2, p3);
+    __m128i channel[4];
+    channel[0] = _mm_unpacklo_epi64(rg01, rg23);
+    channel[1] = _mm_unpackhi_epi64(rg01, rg23);
+    channel[2] = _mm_unpacklo_epi64(ba01, ba23);
+    channel[3] = _mm_unpackhi_epi64(ba01, ba23);
+    for(unsigned c = 0; c != planar->numchannels; ++c)
     {
-      return 56; // unsupported color mode conversion
+      __m128i v = channel[planar->channels[c]];
+      unsigned char* out = planar->out + c * planar->planesize + (start + i) * elemsize;
+      if(planar->identity) _mm_storeu_si128((__m128i*)out, v);
+      else if(planar->sixteen) storePlanar8_sse2(out, v, isfloat, mul[c], add[c]);
+      else
+      {
+        storePlanar8_sse2(out, _mm_unpacklo_epi8(v, zero), isfloat, mul[c], add[c]);
+        storePlanar8_sse2(out + 8 * elemsize, _mm_unpackhi_epi8(v, zero), isfloat, mul[c], add[c]);
+      }
     }
+  }
+  return i;
+}
+#endif // LODEPNG_COMPILE_SIMD
 
-    outsize = lodepng_get_raw_size(*w, *h, &state->info_raw);
-    *out = (unsigned char*)malloc(outsize);
-    if(!(*out))
+// LodePNGRowCallback that stores the channels of the pixels of the rows in the planes.
+static unsigned storePlanarRow(void* user, const LodePNGRow* row)
+{
+  const PlanarOutput* planar = (const PlanarOutput*)user;
+  size_t start = (size_t)row->y * planar->w + row->x0; // element of the first pixel in each plane
+  size_t i = 0;
+#ifdef LODEPNG_COMPILE_SIMD
+  if(row->dx == 1 && (getCpuFeatures() & LODEPNG_CPU_SSSE3)) i = storePlanar_ssse3(planar, start, row->data, row->width);
+#endif // LODEPNG_COMPILE_SIMD
+  size_t bytewidth = planar->sixteen ? 8 : 4;
+  for(unsigned c = 0; c != planar->numchannels; ++c)
+  {
+    unsigned char* plane = planar->out + c * planar->planesize;
+    const unsigned char* in = row->data + planar->channels[c] * (bytewidth / 4);
+    float mul = planar->mul[c], add = planar->add[c];
+    for(size_t j = i; j < row->width; ++j)
     {
-      state->error = 83; // alloc fail
+      size_t pos = start + j * row->dx;
+      const unsigned char* sample = in + j * bytewidth;
+      if(planar->identity)
+      {
+        plane[pos] = sample[0];
+        continue;
+      }
+      float value = (float)(planar->sixteen ? (sample[0] << 8) | sample[1] : sample[0]) * mul + add;
+      if(planar->type == LPT_FLOAT32) memcpy(plane + pos * 4, &value, 4);
+      else plane[pos] = (unsigned char)((!(value > 0.0f) ? 0.0f : value > 255.0f ? 255.0f : value) + 0.5f);
     }
-    else state->error = lodepng_convert(*out, data, &state->info_raw,
-                                        &state->info_png.color, *w, *h);
-    free(data);
+  }
+  return 0;
+}
+
+unsigned lodepng_decode_planar(unsigned char** out, unsigned* w, unsigned* h, LodePNGState* state,
+                               const unsigned char* in, size_t insize, const LodePNGPlanarSettings* settings)
+{
+  *out = 0;
+  PlanarOutput planar;
+  planar.numchannels = settings->numchannels;
+  planar.type = settings->type;
+  unsigned valid = planar.numchannels >= 1 && planar.numchannels <= 4 &&
+                   (planar.type == LPT_UINT8 || planar.type == LPT_FLOAT32);
+  for(unsigned c = 0; valid && c != planar.numchannels; ++c) valid = settings->channels[c] < 4;
+  if(!valid) CERROR_RETURN_ERROR(state->error, 102); // error: invalid planar settings
+
+  state->error = lodepng_inspect(w, h, state, in, insize);
+  if(state->error) return state->error;
+  unsigned isfloat = planar.type == LPT_FLOAT32;
+  planar.sixteen = isfloat && state->info_png.color.bitdepth == 16;
+  state->info_raw.colortype = LCT_RGBA;
+  state->info_raw.bitdepth = planar.sixteen ? 16 : 8;
+  state->info_raw.sampleformat = LSF_BIG_ENDIAN;
+
+  float max = planar.sixteen ? 65535.0f : 255.0f;
+  planar.identity = !isfloat;
+  for(unsigned c = 0; c != planar.numchannels; ++c)
+  {
+    planar.channels[c] = settings->channels[c];
+    planar.mul[c] = isfloat ? settings->scale[c] / max : settings->scale[c];
+    planar.add[c] = isfloat ? settings->offset[c] : settings->offset[c] * 255.0f;
+    if(settings->scale[c] != 1.0f || settings->offset[c] != 0.0f) planar.identity = 0;
+  }
+
+  size_t elemsize = isfloat ? 4 : 1;
+  if((size_t)*w * *h / *h != *w || (size_t)*w * *h > (size_t)(-1) / (elemsize * planar.numchannels))
+  {
+    CERROR_RETURN_ERROR(state->error, 92); // error: size overflow
+  }
+  planar.w = *w;
+  planar.planesize = (size_t)*w * *h * elemsize;
+  planar.out = *out = (unsigned char*)malloc(planar.planesize * planar.numchannels);
+  if(!*out) CERROR_RETURN_ERROR(state->error, 83); // alloc fail
+
+  lodepng_decode_rows(w, h, state, in, insize, storePlanarRow, &planar);
+  if(state->error)
+  {
+    free(*out);
+    *out = 0;
   }
   return state->error;
 }
@@ -3964,11 +8388,10 @@ unsigned lodepng_decode32(unsigned char** out, unsigned* w, unsigned* h, const u
 unsigned lodepng_decode_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename,
                              LodePNGColorType colortype, unsigned bitdepth)
 {
-  unsigned char* buffer = 0;
-  size_t buffersize;
-  unsigned error = lodepng_load_file(&buffer, &buffersize, filename);
-  if(!error) error = lodepng_decode_memory(out, w, h, buffer, buffersize, colortype, bitdepth);
-  free(buffer);
+  FileBuffer buffer;
+  unsigned error = FileBuffer_load(&buffer, filename);
+  if(!error) error = lodepng_decode_memory(out, w, h, buffer.data, buffer.size, colortype, bitdepth);
+  FileBuffer_cleanup(&buffer);
   return error;
 }
 
@@ -3982,9 +8405,97 @@ unsigned lodepng_decode24_file(unsigned char** out, unsigned* w, unsigned* h, co
   return lodepng_decode_file(out, w, h, filename, LCT_RGB, 8);
 }
 
+/*lodepng_inspect for a file, reading only the header and, if idatsize isn't 0, the chunk headers and
+the data of the PLTE and tRNS chunks. return value is error*/
+static unsigned inspectFileSource(unsigned* w, unsigned* h, size_t* idatsize, LodePNGState* state,
+                                  const FileSource* source)
+{
+  unsigned char chunk[12 + 768]; // room for the largest valid PLTE chunk
+  size_t size = FileSource_read(source, 0, chunk, 33);
+  state->error = lodepng_inspect(w, h, state, chunk, size);
+  if(state->error || !idatsize) return state->error;
+
+  *idatsize = 0;
+  size_t pos = 33; // position of the next chunk in the file
+  // stops at IEND or the end of the file, like decodeChunks the decoding only fails later then
+  while(!state->error)
+  {
+    if(pos + 12 > source->size || FileSource_read(source, pos, chunk, 8) != 8) break;
+    unsigned chunkLength = lodepng_chunk_length(chunk);
+    if(chunkLength > 2147483647) break;
+    if(pos + chunkLength + 12 > source->size)
+    {
+      CERROR_RETURN_ERROR(state->error, 64); // error: the file is too small to contain the chunk
+    }
+
+    if(lodepng_chunk_type_equals(chunk, "IEND")) break;
+    else if(lodepng_chunk_type_equals(chunk, "IDAT")) *idatsize += chunkLength;
+    else if(lodepng_chunk_type_equals(chunk, "PLTE") || lodepng_chunk_type_equals(chunk, "tRNS"))
+    {
+      unsigned isPLTE = lodepng_chunk_type_equals(chunk, "PLTE");
+      // readChunk_PLTE and readChunk_tRNS give an error for longer chunks before reading the data
+      if(chunkLength > 768)
+      {
+        if(isPLTE) CERROR_RETURN_ERROR(state->error, 38); // error: palette too big
+        state->error = readChunk_tRNS(&state->info_png.color, chunk + 8, chunkLength);
+        break;
+      }
+      if(FileSource_read(source, pos + 8, chunk + 8, chunkLength + 4) != chunkLength + 4)
+      {
+        CERROR_RETURN_ERROR(state->error, 78); // error: reading the file failed
+      }
+      if(state->decoder.check_crc && lodepng_chunk_check_crc(chunk))
+      {
+        CERROR_RETURN_ERROR(state->error, 57); // error: wrong CRC
+      }
+      if(isPLTE) state->error = readChunk_PLTE(&state->info_png.color, chunk + 8, chunkLength);
+      else state->error = readChunk_tRNS(&state->info_png.color, chunk + 8, chunkLength);
+    }
+    pos += (size_t)chunkLength + 12;
+  }
+  return state->error;
+}
+
+unsigned lodepng_inspect_file(unsigned* w, unsigned* h, size_t* idatsize, LodePNGState* state,
+                              const char* filename)
+{
+  FileSource source;
+  source.file = fopen(filename, "rb");
+  source.fd = -1;
+  if(!source.file) CERROR_RETURN_ERROR(state->error, 78);
+  long size = idatsize ? lodepng_filesize_open(source.file) : 0; // only needed to walk the chunks
+  source.size = (size_t)size;
+  if(size < 0) state->error = 78;
+  else inspectFileSource(w, h, idatsize, state, &source);
+  fclose(source.file);
+  return state->error;
+}
+
+#ifdef LODEPNG_COMPILE_POSIX
+unsigned lodepng_inspect_fd(unsigned* w, unsigned* h, size_t* idatsize, LodePNGState* state, int fd)
+{
+  struct stat st;
+  if(fstat(fd, &st) != 0) CERROR_RETURN_ERROR(state->error, 78);
+  FileSource source;
+  source.file = 0;
+  source.fd = fd;
+  source.size = (size_t)st.st_size;
+  return inspectFileSource(w, h, idatsize, state, &source);
+}
+#endif // LODEPNG_COMPILE_POSIX
+
+
+void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings)
+{
+  lodepng_decompress_settings_init(&settings->zlibsettings);
+  settings->check_crc = 0;
+  settings->num_threads = 1;
+  settings->pipeline = 0;
+}
 
 void lodepng_state_init(LodePNGState* state)
 {
+  lodepng_decoder_settings_init(&state->decoder);
   lodepng_encoder_settings_init(&state->encoder);
   lodepng_color_mode_init(&state->info_raw);
   lodepng_info_init(&state->info_png);
@@ -3992,6 +8503,308 @@ void lodepng_state_init(LodePNGState* state)
 }
 
 
+//////////////////////////////////////////////////////////////////////////// 
+/// PNG Stream Decoder                                                     / 
+//////////////////////////////////////////////////////////////////////////// 
+
+// what the next bytes of the input of a LodePNGStreamDecoder are
+typedef enum StreamPhase
+{
+  STREAM_SIGNATURE, // the signature and the IHDR chunk
+  STREAM_CHUNK_HEADER, // the length and type of a chunk
+  STREAM_CHUNK_DATA,
+  STREAM_CHUNK_CRC,
+  STREAM_END // after IEND, or after the input ended
+} StreamPhase;
+
+struct LodePNGStreamDecoder
+{
+  LodePNGState* state;
+  LodePNGRowCallback callback;
+  void* user;
+  StreamPhase phase;
+  unsigned char buffer[33]; // the part that arrived so far of the signature, a chunk header or a CRC
+  size_t buffered;
+  unsigned w, h; // known after the signature phase
+  unsigned char chunk[8]; // header of the current chunk
+  size_t chunkleft; // bytes of the data of the current chunk that are still to come
+  unsigned crc; // CRC register of the current chunk
+  ucvector chunkdata; // data of a PLTE or tRNS chunk
+  unsigned idat; // 0 before the first IDAT chunk, 1 after it, 2 once the image data ended
+  // the image data, set up at the first IDAT chunk
+  RowDecoder rows;
+  Inflator inflator;
+  ucvector window; // output of the inflater
+  size_t start; // position of the next scanline in window
+  unsigned zlibheader; // the zlib header was read
+  ucvector input; // input the inflater didn't read yet, it's read before the next pushed data
+  ByteSpan spans[2];
+};
+
+LodePNGStreamDecoder* lodepng_stream_new(LodePNGState* state, LodePNGRowCallback callback, void* user)
+{
+  LodePNGStreamDecoder* stream = (LodePNGStreamDecoder*)malloc(sizeof(LodePNGStreamDecoder));
+  if(!stream) return 0;
+  stream->state = state;
+  stream->callback = callback;
+  stream->user = user;
+  stream->phase = STREAM_SIGNATURE;
+  stream->buffered = 0;
+  stream->w = stream->h = 0;
+  stream->idat = 0;
+  ucvector_init(&stream->chunkdata);
+  ucvector_init(&stream->window);
+  ucvector_init(&stream->input);
+  state->error = 0;
+  return stream;
+}
+
+void lodepng_stream_delete(LodePNGStreamDecoder* stream)
+{
+  if(stream->idat)
+  {
+    RowDecoder_cleanup(&stream->rows);
+    Inflator_cleanup(&stream->inflator);
+  }
+  ucvector_cleanup(&stream->chunkdata);
+  ucvector_cleanup(&stream->window);
+  ucvector_cleanup(&stream->input);
+  free(stream);
+}
+
+unsigned lodepng_stream_size(const LodePNGStreamDecoder* stream, unsigned* w, unsigned* h)
+{
+  if(stream->phase == STREAM_SIGNATURE) return 0;
+  *w = stream->w;
+  *h = stream->h;
+  return 1;
+}
+
+// Prepares decoding the image data, at the first IDAT chunk. return value is error
+static unsigned streamStartImage(LodePNGStreamDecoder* stream)
+{
+  LodePNGState* state = stream->state;
+  CERROR_TRY_RETURN(checkRawColorMode(state));
+  unsigned error = RowDecoder_init(&stream->rows, stream->w, stream->h, state->info_png.interlace_method,
+                                   &state->info_raw, &state->info_png.color);
+  Inflator_init(&stream->inflator, 0, 0, &stream->window, 1);
+  stream->inflator.check_adler32 = state->decoder.zlibsettings.check_adler32;
+  stream->inflator.keepinput = INFLATE_STREAM_MARGIN;
+  stream->idat = 1;
+  stream->start = 0;
+  stream->zlibheader = 0;
+  if(!error && !ucvector_reserve(&stream->window, RowDecoder_windowsize(&stream->rows))) error = 83; // alloc fail
+  return error;
+}
+
+/*Reads the zlib header once enough input arrived, then inflates as much as the input that the reader
+was given allows, decoding the scanlines that are complete. return value is error*/
+static unsigned streamRows(LodePNGStreamDecoder* stream)
+{
+  Inflator* inflator = &stream->inflator;
+  if(!stream->zlibheader)
+  {
+    // as for any step of the inflater, wait for enough input that the reader never runs out
+    if(inflator->keepinput && BitReader_available(&inflator->reader) < inflator->keepinput) return 0;
+    stream->zlibheader = 1;
+    CERROR_TRY_RETURN(readZlibHeader(&inflator->reader));
+  }
+  return inflateRows(inflator, &stream->rows, &stream->start, stream->callback, stream->user);
+}
+
+/*Continues inflating with the next size bytes of IDAT data, after the input that was left unread the
+last time. Unless the input ended, the inflater leaves some input unread, which is kept for the next
+time. return value is error*/
+static unsigned streamInflate(LodePNGStreamDecoder* stream, const unsigned char* data, size_t size)
+{
+  BitReader* reader = &stream->inflator.reader;
+  ucvector* input = &stream->input;
+  stream->spans[0].data = input->data;
+  stream->spans[0].size = input->size;
+  stream->spans[1].data = data;
+  stream->spans[1].size = size;
+  BitReader_setInput(reader, stream->spans, 2);
+  unsigned error = streamRows(stream);
+  if(error || !stream->inflator.keepinput) return error;
+
+  // what's left of the first span, which is input itself, and of the second span
+  size_t kept = 0;
+  const unsigned char* rest = data;
+  size_t restsize = size;
+  if(reader->span == stream->spans) kept = input->size; // nothing was read
+  else if(reader->span == stream->spans + 1)
+  {
+    kept = (size_t)(reader->end - reader->next);
+    memmove(input->data, reader->next, kept);
+  }
+  else
+  {
+    rest = reader->next;
+    restsize = (size_t)(reader->end - reader->next);
+  }
+  // once the deflate data ended, only the adler32 checksum after it is still read
+  if(stream->inflator.done)
+  {
+    if(kept > 4) kept = 4;
+    if(restsize > 4 - kept) restsize = 4 - kept;
+  }
+  if(!ucvector_resize(input, kept + restsize)) return 83; // alloc fail
+  if(restsize) memcpy(input->data + kept, rest, restsize);
+  return 0;
+}
+
+// Decodes the rest of the image data, after the last IDAT chunk. return value is error
+static unsigned streamEndImage(LodePNGStreamDecoder* stream)
+{
+  Inflator* inflator = &stream->inflator;
+  stream->idat = 2;
+  inflator->keepinput = 0;
+  CERROR_TRY_RETURN(streamInflate(stream, 0, 0));
+  return inflateRowsEnd(inflator, &stream->rows, stream->start);
+}
+
+// Handles the next size bytes of the data of the current chunk. return value is error
+static unsigned streamChunkData(LodePNGStreamDecoder* stream, const unsigned char* data, size_t size)
+{
+  if(stream->state->decoder.check_crc) stream->crc = crc32Update(stream->crc, data, size);
+  if(lodepng_chunk_type_equals(stream->chunk, "IDAT"))
+  {
+    if(stream->idat == 1) return streamInflate(stream, data, size);
+  }
+  else if(stream->idat == 0 && (lodepng_chunk_type_equals(stream->chunk, "PLTE")
+                                || lodepng_chunk_type_equals(stream->chunk, "tRNS")))
+  {
+    size_t oldsize = stream->chunkdata.size;
+    if(!ucvector_resize(&stream->chunkdata, oldsize + size)) return 83; // alloc fail
+    memcpy(stream->chunkdata.data + oldsize, data, size);
+  }
+  return 0;
+}
+
+// Handles the chunk header in buffer. return value is error
+static unsigned streamChunkHeader(LodePNGStreamDecoder* stream)
+{
+  LodePNGState* state = stream->state;
+  unsigned char* chunk = stream->chunk;
+  memcpy(chunk, stream->buffer, 8);
+  unsigned chunkLength = lodepng_chunk_length(chunk);
+  unsigned isIDAT = lodepng_chunk_type_equals(chunk, "IDAT");
+  if(chunkLength > 2147483647)
+  {
+    // like decodeChunks, stop at a chunk length larger than the max PNG chunk size
+    stream->phase = STREAM_END;
+    return stream->idat == 1 ? streamEndImage(stream) : 0;
+  }
+
+  // like decodeChunks, all IDAT chunks up to IEND are part of the image data, even with other chunks in between
+  unsigned error = 0;
+  if(isIDAT && stream->idat == 0) error = streamStartImage(stream);
+  else if(stream->idat == 1 && lodepng_chunk_type_equals(chunk, "IEND")) error = streamEndImage(stream);
+  if(error) return error;
+
+  /*PLTE and tRNS come before the image data. After it they're ignored, the decoded rows don't change anymore.
+  readChunk_PLTE and readChunk_tRNS give an error for longer chunks before reading the data.*/
+  if(stream->idat == 0 && chunkLength > 768)
+  {
+    if(lodepng_chunk_type_equals(chunk, "PLTE")) return 38; // error: palette too big
+    if(lodepng_chunk_type_equals(chunk, "tRNS")) return readChunk_tRNS(&state->info_png.color, 0, chunkLength);
+  }
+  stream->chunkdata.size = 0;
+  stream->crc = crc32Update(0xffffffffu, chunk + 4, 4);
+  stream->chunkleft = chunkLength;
+  stream->phase = chunkLength ? STREAM_CHUNK_DATA : STREAM_CHUNK_CRC;
+  return 0;
+}
+
+// Handles the CRC in buffer, at the end of the current chunk. return value is error
+static unsigned streamChunkEnd(LodePNGStreamDecoder* stream)
+{
+  LodePNGState* state = stream->state;
+  const unsigned char* chunk = stream->chunk;
+  if(state->decoder.check_crc && lodepng_read32bitInt(stream->buffer) != ~stream->crc)
+  {
+    return 57; // error: wrong CRC
+  }
+  stream->phase = STREAM_CHUNK_HEADER;
+  if(lodepng_chunk_type_equals(chunk, "IEND")) stream->phase = STREAM_END;
+  else if(stream->idat == 0 && lodepng_chunk_type_equals(chunk, "PLTE"))
+  {
+    return readChunk_PLTE(&state->info_png.color, stream->chunkdata.data, stream->chunkdata.size);
+  }
+  else if(stream->idat == 0 && lodepng_chunk_type_equals(chunk, "tRNS"))
+  {
+    return readChunk_tRNS(&state->info_png.color, stream->chunkdata.data, stream->chunkdata.size);
+  }
+  return 0;
+}
+
+// Handles the signature and header in buffer. return value is error
+static unsigned streamHeader(LodePNGStreamDecoder* stream)
+{
+  CERROR_TRY_RETURN(lodepng_inspect(&stream->w, &stream->h, stream->state, stream->buffer, 33));
+  // multiplication overflow, the same limit as decodeChunks
+  size_t numpixels = (size_t)stream->w * stream->h;
+  if(numpixels / stream->h != stream->w || numpixels > 268435455) return 92;
+  stream->phase = STREAM_CHUNK_HEADER;
+  return 0;
+}
+
+unsigned lodepng_stream_push(LodePNGStreamDecoder* stream, const unsigned char* data, size_t size)
+{
+  LodePNGState* state = stream->state;
+  while(size != 0 && !state->error && stream->phase != STREAM_END)
+  {
+    size_t amount;
+    if(stream->phase == STREAM_CHUNK_DATA)
+    {
+      amount = size < stream->chunkleft ? size : stream->chunkleft;
+      state->error = streamChunkData(stream, data, amount);
+      stream->chunkleft -= amount;
+      if(stream->chunkleft == 0) stream->phase = STREAM_CHUNK_CRC;
+    }
+    else
+    {
+      // the other parts have a fixed size, they're collected in buffer until complete
+      size_t needed = stream->phase == STREAM_SIGNATURE ? 33 : stream->phase == STREAM_CHUNK_HEADER ? 8 : 4;
+      amount = needed - stream->buffered;
+      if(amount > size) amount = size;
+      memcpy(stream->buffer + stream->buffered, data, amount);
+      stream->buffered += amount;
+      if(stream->buffered == needed)
+      {
+        stream->buffered = 0;
+        if(stream->phase == STREAM_SIGNATURE) state->error = streamHeader(stream);
+        else if(stream->phase == STREAM_CHUNK_HEADER) state->error = streamChunkHeader(stream);
+        else state->error = streamChunkEnd(stream);
+      }
+    }
+    data += amount;
+    size -= amount;
+  }
+  return state->error;
+}
+
+unsigned lodepng_stream_finish(LodePNGStreamDecoder* stream)
+{
+  LodePNGState* state = stream->state;
+  if(state->error || stream->phase == STREAM_END) return state->error;
+  if(stream->phase == STREAM_SIGNATURE)
+  {
+    // the same error as lodepng_inspect gives for the input that arrived, 48 or 27
+    unsigned w, h;
+    return lodepng_inspect(&w, &h, state, stream->buffer, stream->buffered);
+  }
+  /*a chunk that's cut off gives error 64, as in decodeChunks, which ignores the end of the input if it's
+  shorter than a chunk without data*/
+  size_t chunkbytes = 8 + lodepng_chunk_length(stream->chunk) - stream->chunkleft + stream->buffered;
+  unsigned cutoff = (stream->phase == STREAM_CHUNK_DATA || stream->phase == STREAM_CHUNK_CRC) && chunkbytes >= 12;
+  stream->phase = STREAM_END;
+  if(cutoff) CERROR_RETURN_ERROR(state->error, 64);
+  if(stream->idat == 0) state->error = streamStartImage(stream);
+  if(!state->error && stream->idat == 1) state->error = streamEndImage(stream);
+  return state->error;
+}
+
 //////////////////////////////////////////////////////////////////////////// 
 /// PNG Encoder                                                            / 
 //////////////////////////////////////////////////////////////////////////// 
@@ -4100,17 +8913,26 @@ static unsigned addChunk_tRNS(ucvector* out, const LodePNGColorMode* info)
   return error;
 }
 
-static unsigned addChunk_IDAT(ucvector* out, const unsigned char* data, size_t datasize,
-                              LodePNGCompressSettings* zlibsettings)
+/*adler is the adler32 of data. If bandheight isn't 0, compresses data, scanlines of linebytes bytes
+plus filter byte, in bands of bandheight rows, and adds an lpBD chunk before the IDAT chunk. lpBD has
+the band height, then the position in the zlib data of each band after the first, as 32-bit high and
+low half, all big endian.*/
+static unsigned addChunk_IDAT(ucvector* out, const unsigned char* data, size_t datasize, unsigned adler,
+                              unsigned bandheight, size_t linebytes, LodePNGCompressSettings* zlibsettings)
 {
   ucvector zlibdata;
+  ucvector bands;
   unsigned error = 0;
 
   // compress with the Zlib compressor
   ucvector_init(&zlibdata);
-  error = lodepng_zlib_compress(&zlibdata.data, &zlibdata.size, data, datasize, zlibsettings);
+  ucvector_init(&bands);
+  if(bandheight) lodepng_add32bitInt(&bands, bandheight);
+  error = zlibCompress(&zlibdata, data, datasize, adler, (size_t)bandheight * (linebytes + 1), &bands, zlibsettings);
+  if(!error && bandheight) error = addChunk(out, "lpBD", bands.data, bands.size);
   if(!error) error = addChunk(out, "IDAT", zlibdata.data, zlibdata.size);
   ucvector_cleanup(&zlibdata);
+  ucvector_cleanup(&bands);
 
   return error;
 }
@@ -4188,12 +9010,16 @@ static float flog2(float f)
 }
 
 static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h,
-                       const LodePNGColorMode* info, const LodePNGEncoderSettings* settings)
+                       const LodePNGColorMode* info, const LodePNGEncoderSettings* settings,
+                       unsigned bandheight, unsigned* adler)
 {
   /*
   For PNG filter method 0
   out must be a buffer with as size: h + (w * h * bpp + 7) / 8, because there are
   the scanlines with 1 extra byte per scanline
+  adler is updated with each scanline of out as soon as it's written, for the zlib trailer
+  if bandheight isn't 0, the first row of each band of that many rows only uses the filters
+  None and Sub, which don't refer to the row above it
   */
 
   unsigned bpp = lodepng_get_bpp(info);
@@ -4232,6 +9058,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
       size_t inindex = linebytes * y;
       out[outindex] = 0; // filter type byte
       filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, 0);
+      *adler = adler32Update(*adler, &out[outindex], linebytes + 1);
       prevline = &in[inindex];
     }
   }
@@ -4253,8 +9080,9 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
     {
       for(y = 0; y != h; ++y)
       {
+        unsigned char numtypes = (bandheight && y != 0 && y % bandheight == 0) ? 2 : 5;
         // try the 5 filter types
-        for(type = 0; type != 5; ++type)
+        for(type = 0; type != numtypes; ++type)
         {
           filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
 
@@ -4289,6 +9117,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
         // now fill the out values
         out[y * (linebytes + 1)] = bestType; // the first byte of a scanline will be the filter type
         for(x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
+        *adler = adler32Update(*adler, &out[y * (linebytes + 1)], linebytes + 1);
       }
     }
 
@@ -4310,8 +9139,9 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
 
     for(y = 0; y != h; ++y)
     {
+      unsigned numtypes = (bandheight && y != 0 && y % bandheight == 0) ? 2 : 5;
       // try the 5 filter types
-      for(type = 0; type != 5; ++type)
+      for(type = 0; type != numtypes; ++type)
       {
         filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
         for(x = 0; x != 256; ++x) count[x] = 0;
@@ -4336,6 +9166,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
       // now fill the out values
       out[y * (linebytes + 1)] = bestType; // the first byte of a scanline will be the filter type
       for(x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
+      *adler = adler32Update(*adler, &out[y * (linebytes + 1)], linebytes + 1);
     }
 
     for(type = 0; type != 5; ++type) free(attempt[type]);
@@ -4348,22 +9179,15 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
 static void addPaddingBits(unsigned char* out, const unsigned char* in,
                            size_t olinebits, size_t ilinebits, unsigned h)
 {
-  /*The opposite of the removePaddingBits function
-  olinebits must be >= ilinebits*/
-  unsigned y;
-  size_t diff = olinebits - ilinebits;
-  size_t obp = 0, ibp = 0; // bit pointers
-  for(y = 0; y != h; ++y)
+  /*Adds padding bits to the end of each scanline, so that each starts at a byte.
+  olinebits must be >= ilinebits and a multiple of 8. The padding bits are 0, to avoid
+  "Use of uninitialised value of size ###" warning from valgrind*/
+  size_t olinebytes = olinebits / 8, ilinebytes = (ilinebits + 7) / 8;
+  for(unsigned y = 0; y != h; ++y)
   {
-    size_t x;
-    for(x = 0; x < ilinebits; ++x)
-    {
-      unsigned char bit = readBitFromReversedStream(&ibp, in);
-      setBitOfReversedStream(&obp, out, bit);
-    }
-    /*obp += diff; --> no, fill in some value in the padding bits too, to avoid
-    "Use of uninitialised value of size ###" warning from valgrind*/
-    for(x = 0; x != diff; ++x) setBitOfReversedStream(&obp, out, 0);
+    unsigned char* line = out + y * olinebytes;
+    copyBitsFromReversedStream(line, in, y * ilinebits, ilinebits);
+    if(olinebytes > ilinebytes) memset(line + ilinebytes, 0, olinebytes - ilinebytes);
   }
 }
 
@@ -4431,15 +9255,18 @@ static void Adam7_interlace(unsigned char* out, const unsigned char* in, unsigne
 return value is error**/
 static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const unsigned char* in,
                                     unsigned w, unsigned h,
-                                    const LodePNGInfo* info_png, const LodePNGEncoderSettings* settings)
+                                    const LodePNGInfo* info_png, const LodePNGEncoderSettings* settings,
+                                    unsigned* adler)
 {
   /*
   This function converts the pure 2D image with the PNG's colortype, into filtered-padded-interlaced data. Steps:
   *) if no Adam7: 1) add padding bits (= possible extra bits per scanline if bpp < 8) 2) filter
   *) if adam7: 1) Adam7_interlace 2) 7x add padding bits 3) 7x filter
+  adler receives the adler32 of the output data.
   */
   unsigned bpp = lodepng_get_bpp(&info_png->color);
   unsigned error = 0;
+  *adler = 1;
 
   if(info_png->interlace_method == 0)
   {
@@ -4457,14 +9284,14 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
         if(!error)
         {
           addPaddingBits(padded, in, ((w * bpp + 7) / 8) * 8, w * bpp, h);
-          error = filter(*out, padded, w, h, &info_png->color, settings);
+          error = filter(*out, padded, w, h, &info_png->color, settings, settings->band_height, adler);
         }
         free(padded);
       }
       else
       {
         // we can immediately filter into the out buffer, no other steps needed
-        error = filter(*out, in, w, h, &info_png->color, settings);
+        error = filter(*out, in, w, h, &info_png->color, settings, settings->band_height, adler);
       }
     }
   }
@@ -4497,13 +9324,13 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
           addPaddingBits(padded, &adam7[passstart[i]],
                          ((passw[i] * bpp + 7) / 8) * 8, passw[i] * bpp, passh[i]);
           error = filter(&(*out)[filter_passstart[i]], padded,
-                         passw[i], passh[i], &info_png->color, settings);
+                         passw[i], passh[i], &info_png->color, settings, 0, adler);
           free(padded);
         }
         else
         {
           error = filter(&(*out)[filter_passstart[i]], &adam7[padded_passstart[i]],
-                         passw[i], passh[i], &info_png->color, settings);
+                         passw[i], passh[i], &info_png->color, settings, 0, adler);
         }
 
         if(error) break;
@@ -4551,6 +9378,7 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
   ucvector outv;
   unsigned char* data = 0; // uncompressed version of the IDAT chunk data
   size_t datasize = 0;
+  unsigned adler = 1; // adler32 of data
 
   // provide some proper output values if error will happen
   *out = 0;
@@ -4571,6 +9399,10 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
   if(state->error) return state->error; // error: unexisting color type given
   state->error = checkColorValidity(state->info_raw.colortype, state->info_raw.bitdepth);
   if(state->error) return state->error; // error: unexisting color type given
+  if(state->info_raw.sampleformat != LSF_BIG_ENDIAN || state->info_png.color.sampleformat != LSF_BIG_ENDIAN)
+  {
+    CERROR_RETURN_ERROR(state->error, 101); // error: only decoding gives samples in another format
+  }
 
   //  color convert and compute scanline filter types 
   lodepng_info_init(&info);
@@ -4592,10 +9424,10 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
       {
         state->error = lodepng_convert(converted, image, &info.color, &state->info_raw, w, h);
       }
-      if(!state->error) preProcessScanlines(&data, &datasize, converted, w, h, &info, &state->encoder);
+      if(!state->error) preProcessScanlines(&data, &datasize, converted, w, h, &info, &state->encoder, &adler);
       free(converted);
     }
-    else preProcessScanlines(&data, &datasize, image, w, h, &info, &state->encoder);
+    else preProcessScanlines(&data, &datasize, image, w, h, &info, &state->encoder, &adler);
   }
 
   //  output all PNG chunks 
@@ -4625,7 +9457,9 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
       addChunk_tRNS(&outv, &info.color);
     }
     // IDAT (multiple IDAT chunks must be consecutive)
-    state->error = addChunk_IDAT(&outv, data, datasize, &state->encoder.zlibsettings);
+    unsigned bandheight = info.interlace_method == 0 && state->encoder.band_height < h ? state->encoder.band_height : 0;
+    size_t linebytes = ((size_t)w * lodepng_get_bpp(&info.color) + 7) / 8;
+    state->error = addChunk_IDAT(&outv, data, datasize, adler, bandheight, linebytes, &state->encoder.zlibsettings);
     if(state->error) break;
     addChunk_IEND(&outv);
 
@@ -4710,6 +9544,7 @@ void lodepng_encoder_settings_init(LodePNGEncoderSettings* settings)
   settings->filter_strategy = LFS_MINSUM;
   settings->auto_convert = 1;
   settings->force_palette = 0;
+  settings->band_height = 0;
 }
 
 #ifdef LODEPNG_COMPILE_ERROR_TEXT
@@ -4764,6 +9599,8 @@ const char* lodepng_error_text(unsigned code)
     given lenghts. They call this an oversubscribed dynamic bit lengths tree in zlib.*/
     case 55: return "jumped past tree while generating huffman tree";
     case 56: return "given output image colortype or bitdepth not supported for color conversion";
+    case 57: return "invalid CRC encountered (checking CRC can be disabled)";
+    case 58: return "invalid ADLER32 encountered (checking ADLER32 can be disabled)";
     case 60: return "invalid window size given in the settings of the encoder (must be 0-32768)";
     // LodePNG leaves the choice of RGB to greyscale conversion formula to the user.
     // this would result in the inability of a deflated block to ever contain an end code. It must be at least 1.
@@ -4787,6 +9624,14 @@ const char* lodepng_error_text(unsigned code)
     case 92: return "too many pixels, not supported";
     case 93: return "zero width or height is invalid";
     case 94: return "header chunk must have a size of 13 bytes";
+    case 95: return "row stride is smaller than a row of the image";
+    case 96: return "output buffer too small for the image";
+    case 97: return "decoding stopped by the row callback";
+    case 98: return "region is empty or not inside the image";
+    case 99: return "index is invalid or doesn't belong to this PNG";
+    case 100: return "palette indices requested of a PNG without a palette";
+    case 101: return "native endian or float samples are only supported as decoder output of 16 bits per sample";
+    case 102: return "invalid planar settings: 1 to 4 planes of channels 0 to 3, of bytes or floats";
   }
   return "unknown error code";
 }
@@ -23,6 +23,10 @@
 
 #pragma once
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Same as lodepng_decode_file, but always decodes to 32-bit RGBA raw image.
 unsigned lodepng_decode32_file(unsigned char** out, unsigned* w, unsigned* h,
     const char* filename);
@@ -30,3 +34,10 @@ unsigned lodepng_decode32_file(unsigned char** out, unsigned* w, unsigned* h,
 // Same as lodepng_encode_file, but always encodes from 32-bit RGBA raw image.
 unsigned lodepng_encode32_file(const char* filename,
     const unsigned char* image, unsigned w, unsigned h);
+
+// Returns an English description of the numerical error code.
+const char* lodepng_error_text(unsigned code);
+
+#ifdef __cplusplus
+}
+#endif
@@ -33,11 +33,13 @@ Testing instructions:
 *) Compile with g++ with all warnings and run the unit test
 g++ lodepng.cpp lodepng_util.cpp lodepng_unittest.cpp -Wall -Wextra -Wshadow -pedantic -ansi -O3 && ./a.out
 
-*) Compile with pure ISO C90 and all warnings:
-mv lodepng.cpp lodepng.c ; gcc -I ./ lodepng.c examples/example_decode.c -ansi -pedantic -Wall -Wextra -O3 ; mv lodepng.c lodepng.cpp
-
-*) Compile with C with -pedantic but not -ansi flag so it warns about // style comments in C++-only ifdefs
-mv lodepng.cpp lodepng.c ; gcc -I ./ lodepng.c examples/example_decode.c -pedantic -Wall -Wextra -O3 ; mv lodepng.c lodepng.cpp
+*) lodepng.cpp doesn't compile as C, its kernels are templates. -ansi above checks that it still compiles as C++98.
+Check that a C program links against it compiled as C++, which needs the C linkage of the functions in lodepng.h:
+g++ -I ./ lodepng.cpp -W -Wall -ansi -pedantic -O3 -c
+echo '#include "lodepng.h"' > clink.c
+echo 'int main(void) { unsigned char* out; unsigned w, h; return !lodepng_error_text(lodepng_decode32_file(&out, &w, &h, "x.png")); }' >> clink.c
+gcc -I ./ clink.c lodepng.o -W -Wall -std=c99 -pedantic -lstdc++ -lpthread && ./a.out
+rm clink.c lodepng.o
 
 *) try lodepng_benchmark.cpp
 g++ lodepng.cpp lodepng_benchmark.cpp -Wall -Wextra -pedantic -ansi -lSDL -O3 && ./a.out
@@ -45,7 +47,6 @@ g++ lodepng.cpp lodepng_benchmark.cpp -Wall -Wextra -pedantic -ansi -lSDL -O3 &&
 
 *) Check if all examples compile without warnings:
 g++ -I ./ lodepng.cpp examples/''*.cpp -W -Wall -ansi -pedantic -O3 -c
-mv lodepng.cpp lodepng.c ; gcc -I ./ lodepng.c examples/''*.c -W -Wall -ansi -pedantic -O3 -c ; mv lodepng.c lodepng.cpp
 
 *) Check pngdetail.cpp:
 g++ lodepng.cpp lodepng_util.cpp pngdetail.cpp -W -Wall -ansi -pedantic -O3 -o pngdetail
@@ -60,6 +61,7 @@ g++ lodepng.cpp -W -Wall -ansi -pedantic -O3 -c -DLODEPNG_NO_COMPILE_DISK
 g++ lodepng.cpp -W -Wall -ansi -pedantic -O3 -c -DLODEPNG_NO_COMPILE_ANCILLARY_CHUNKS
 g++ lodepng.cpp -W -Wall -ansi -pedantic -O3 -c -DLODEPNG_NO_COMPILE_ERROR_TEXT
 g++ lodepng.cpp -W -Wall -ansi -pedantic -O3 -c -DLODEPNG_NO_COMPILE_CPP
+g++ lodepng.cpp -W -Wall -ansi -pedantic -O3 -c -DLODEPNG_NO_COMPILE_THREADS
 g++ lodepng.cpp -W -Wall -ansi -pedantic -O3 -c -DLODEPNG_NO_COMPILE_ZLIB -DLODEPNG_NO_COMPILE_DECODER
 g++ lodepng.cpp -W -Wall -ansi -pedantic -O3 -c -DLODEPNG_NO_COMPILE_ZLIB -DLODEPNG_NO_COMPILE_ENCODER
 g++ lodepng.cpp -W -Wall -ansi -pedantic -O3 -c -DLODEPNG_NO_COMPILE_PNG -DLODEPNG_NO_COMPILE_DECODER
@@ -2037,6 +2039,712 @@ void testPaletteToPaletteDecode2() {
   free(image2);
 }
 
+//Encodes a test image of the given color type as a PNG, with or without Adam7 interlacing, and in bands of
+//band_height rows if it's not 0. The tests below decode it in other ways and check that they give the same
+//as lodepng::decode.
+void createTestPNG(std::vector<unsigned char>& png, unsigned w, unsigned h,
+                   LodePNGColorType colorType, unsigned bitDepth, unsigned interlace, unsigned band_height = 0)
+{
+  Image image;
+  generateTestImage(image, w, h, colorType, bitDepth);
+  lodepng::State state;
+  state.info_raw.colortype = colorType;
+  state.info_raw.bitdepth = bitDepth;
+  state.info_png.interlace_method = interlace;
+  state.encoder.band_height = band_height;
+  png.clear();
+  assertNoPNGError(lodepng::encode(png, image.data, w, h, state));
+}
+
+//Image of 4 bytes per pixel that storeRow puts the rows of a LodePNGRowCallback in
+struct RowImage
+{
+  std::vector<unsigned char> pixels;
+  unsigned width;
+  unsigned numrows; //amount of rows received
+  unsigned stopafter; //storeRow stops decoding after this amount of rows
+
+  RowImage(unsigned w, unsigned h) : pixels((size_t)w * h * 4, 0), width(w), numrows(0), stopafter((unsigned)-1) {}
+};
+
+unsigned storeRow(void* user, const LodePNGRow* row)
+{
+  RowImage* image = (RowImage*)user;
+  for(unsigned i = 0; i < row->width; i++)
+  {
+    size_t x = row->x0 + (size_t)i * row->dx;
+    for(size_t c = 0; c < 4; c++) image->pixels[(row->y * (size_t)image->width + x) * 4 + c] = row->data[i * 4 + c];
+  }
+  return ++image->numrows >= image->stopafter;
+}
+
+//Pushes the PNG to a stream decoder in pieces of piecesize bytes, returns the error of the decoder
+unsigned streamDecode(RowImage& image, unsigned& w, unsigned& h, const std::vector<unsigned char>& png, size_t piecesize)
+{
+  lodepng::State state;
+  LodePNGStreamDecoder* stream = lodepng_stream_new(&state, storeRow, &image);
+  assertTrue(stream != 0, "stream decoder allocation");
+  unsigned error = 0;
+  for(size_t pos = 0; pos < png.size() && !error; pos += piecesize)
+  {
+    //each piece in its own buffer, so that the decoder can't read past it
+    size_t end = pos + piecesize < png.size() ? pos + piecesize : png.size();
+    std::vector<unsigned char> piece(png.begin() + pos, png.begin() + end);
+    error = lodepng_stream_push(stream, &piece[0], piece.size());
+  }
+  if(!error) error = lodepng_stream_finish(stream);
+  if(!error) assertTrue(lodepng_stream_size(stream, &w, &h) != 0, "stream size");
+  lodepng_stream_delete(stream);
+  return error;
+}
+
+//Test the stream decoder with the PNG split in pieces of various sizes, and cut off
+void testStreamDecoder()
+{
+  std::cout << "testStreamDecoder" << std::endl;
+  const size_t piecesizes[] = {1, 3, 13, 100, 5000, 1000000};
+  for(unsigned interlace = 0; interlace < 2; interlace++)
+  {
+    const LodePNGColorType colorTypes[] = {LCT_RGBA, LCT_GREY, LCT_RGB};
+    const unsigned bitDepths[] = {8, 1, 16};
+    for(size_t i = 0; i < 3; i++)
+    {
+      std::vector<unsigned char> png;
+      createTestPNG(png, 37, 23, colorTypes[i], bitDepths[i], interlace);
+      std::vector<unsigned char> expected;
+      unsigned w, h;
+      lodepng::State state;
+      assertNoPNGError(lodepng::decode(expected, w, h, state, png));
+
+      for(size_t j = 0; j < sizeof(piecesizes) / sizeof(*piecesizes); j++)
+      {
+        RowImage image(w, h);
+        unsigned w2 = 0, h2 = 0;
+        assertNoPNGError(streamDecode(image, w2, h2, png, piecesizes[j]), "stream decoder");
+        ASSERT_EQUALS(w, w2);
+        ASSERT_EQUALS(h, h2);
+        assertTrue(image.pixels == expected, "stream decoder pixels, pieces of " + valtostr(piecesizes[j]));
+      }
+
+      //a cut off PNG gives the same error as decoding it at once
+      for(size_t size = 0; size < png.size(); size += 1 + size / 4)
+      {
+        std::vector<unsigned char> cut(png.begin(), png.begin() + size);
+        std::vector<unsigned char> image;
+        unsigned w2, h2;
+        lodepng::State state2;
+        unsigned error = lodepng::decode(image, w2, h2, state2, cut);
+        RowImage rows(w, h);
+        assertEquals(error, streamDecode(rows, w2, h2, cut, 7), "cut off at " + valtostr(size));
+      }
+    }
+  }
+}
+
+//Test lodepng_decode_rows, and stopping it from the callback
+void testDecodeRows()
+{
+  std::cout << "testDecodeRows" << std::endl;
+  for(unsigned interlace = 0; interlace < 2; interlace++)
+  {
+    std::vector<unsigned char> png;
+    createTestPNG(png, 29, 17, LCT_RGB, 8, interlace);
+    std::vector<unsigned char> expected;
+    unsigned w, h;
+    lodepng::State state;
+    assertNoPNGError(lodepng::decode(expected, w, h, state, png));
+
+    RowImage image(w, h);
+    lodepng::State state2;
+    assertNoPNGError(lodepng_decode_rows(&w, &h, &state2, &png[0], png.size(), storeRow, &image));
+    assertTrue(image.pixels == expected, "rows");
+    //without interlacing every row once, with Adam7 the 3+3+2+5+4+9+8 rows of the 7 reduced images
+    unsigned numrows = image.numrows;
+    ASSERT_EQUALS(interlace ? 34u : 17u, numrows);
+
+    //returning nonzero from the callback stops at that row with error 97
+    for(unsigned stop = 1; stop < numrows; stop += 6)
+    {
+      RowImage stopped(w, h);
+      stopped.stopafter = stop;
+      lodepng::State state3;
+      ASSERT_EQUALS(97, lodepng_decode_rows(&w, &h, &state3, &png[0], png.size(), storeRow, &stopped));
+      ASSERT_EQUALS(stop, stopped.numrows);
+    }
+  }
+}
+
+//Copies the region of rw * rh pixels at x, y of an image of 4 bytes per pixel
+std::vector<unsigned char> cropImage(const std::vector<unsigned char>& image, unsigned w,
+                                     unsigned x, unsigned y, unsigned rw, unsigned rh)
+{
+  std::vector<unsigned char> result;
+  for(unsigned j = y; j < y + rh; j++)
+  {
+    result.insert(result.end(), image.begin() + (j * (size_t)w + x) * 4, image.begin() + (j * (size_t)w + x + rw) * 4);
+  }
+  return result;
+}
+
+//Decodes a region with lodepng_decode_region, or lodepng_decode_region_indexed if index isn't empty
+unsigned decodeRegion(std::vector<unsigned char>& out, const std::vector<unsigned char>& png,
+                      const std::vector<unsigned char>& index, unsigned x, unsigned y, unsigned rw, unsigned rh)
+{
+  unsigned char* buffer = 0;
+  unsigned w, h;
+  lodepng::State state;
+  unsigned error = index.empty()
+      ? lodepng_decode_region(&buffer, &w, &h, &state, &png[0], png.size(), x, y, rw, rh)
+      : lodepng_decode_region_indexed(&buffer, &w, &h, &state, &png[0], png.size(),
+                                      &index[0], index.size(), x, y, rw, rh);
+  out.clear();
+  if(!error) out.insert(out.end(), buffer, buffer + (size_t)rw * rh * 4);
+  free(buffer);
+  return error;
+}
+
+//Test that regions of the image decode to the same pixels as that part of the whole image
+void testDecodeRegion()
+{
+  std::cout << "testDecodeRegion" << std::endl;
+  const unsigned regions[][4] = {{0, 0, 45, 31}, {0, 0, 1, 1}, {44, 30, 1, 1}, {3, 5, 17, 9}, {0, 12, 45, 1}, {20, 0, 1, 31}};
+  const std::vector<unsigned char> noindex;
+  for(unsigned interlace = 0; interlace < 2; interlace++)
+  {
+    std::vector<unsigned char> png;
+    createTestPNG(png, 45, 31, LCT_GREY_ALPHA, 8, interlace);
+    std::vector<unsigned char> expected;
+    unsigned w, h;
+    lodepng::State state;
+    assertNoPNGError(lodepng::decode(expected, w, h, state, png));
+
+    for(size_t i = 0; i < sizeof(regions) / sizeof(*regions); i++)
+    {
+      const unsigned* r = regions[i];
+      std::vector<unsigned char> region;
+      assertNoPNGError(decodeRegion(region, png, noindex, r[0], r[1], r[2], r[3]), "region " + valtostr(i));
+      assertTrue(region == cropImage(expected, w, r[0], r[1], r[2], r[3]), "region pixels " + valtostr(i));
+    }
+
+    //empty regions and regions that aren't inside the image
+    std::vector<unsigned char> region;
+    ASSERT_EQUALS(98, decodeRegion(region, png, noindex, 0, 0, 0, 1));
+    ASSERT_EQUALS(98, decodeRegion(region, png, noindex, 45, 0, 1, 1));
+    ASSERT_EQUALS(98, decodeRegion(region, png, noindex, 40, 3, 6, 1));
+    ASSERT_EQUALS(98, decodeRegion(region, png, noindex, 0, 30, 1, 2));
+  }
+}
+
+unsigned buildIndex(std::vector<unsigned char>& index, const std::vector<unsigned char>& png, size_t spacing)
+{
+  unsigned char* buffer = 0;
+  size_t size = 0;
+  lodepng::State state;
+  unsigned error = lodepng_index_build(&buffer, &size, &state, &png[0], png.size(), spacing);
+  index.clear();
+  if(!error) index.insert(index.end(), buffer, buffer + size);
+  free(buffer);
+  return error;
+}
+
+//Test decoding regions with an index, and that an index that is corrupted or of another PNG gives error 99
+void testDecodeRegionIndexed()
+{
+  std::cout << "testDecodeRegionIndexed" << std::endl;
+  const unsigned regions[][4] = {{0, 0, 600, 400}, {0, 0, 1, 1}, {599, 399, 1, 1}, {10, 120, 200, 60}, {0, 300, 600, 100}};
+  for(unsigned interlace = 0; interlace < 2; interlace++)
+  {
+    std::vector<unsigned char> png;
+    createTestPNG(png, 600, 400, LCT_RGBA, 8, interlace);
+    std::vector<unsigned char> expected;
+    unsigned w, h;
+    lodepng::State state;
+    assertNoPNGError(lodepng::decode(expected, w, h, state, png));
+
+    std::vector<unsigned char> index;
+    assertNoPNGError(buildIndex(index, png, 4096), "index");
+    //a checkpoint has a 32K window, Adam7 images get none
+    if(!interlace) assertTrue(index.size() > 3 * 32768, "index has checkpoints");
+
+    for(size_t i = 0; i < sizeof(regions) / sizeof(*regions); i++)
+    {
+      const unsigned* r = regions[i];
+      std::vector<unsigned char> region;
+      assertNoPNGError(decodeRegion(region, png, index, r[0], r[1], r[2], r[3]), "indexed region " + valtostr(i));
+      assertTrue(region == cropImage(expected, w, r[0], r[1], r[2], r[3]), "indexed region pixels " + valtostr(i));
+    }
+
+    //any changed byte of the index is found
+    for(size_t i = 0; i < index.size(); i += 1 + i / 8)
+    {
+      std::vector<unsigned char> broken = index;
+      broken[i] ^= 16;
+      std::vector<unsigned char> region;
+      ASSERT_EQUALS(99, decodeRegion(region, png, broken, 0, 399, 600, 1));
+    }
+    std::vector<unsigned char> region;
+    std::vector<unsigned char> cut(index.begin(), index.end() - 1);
+    ASSERT_EQUALS(99, decodeRegion(region, png, cut, 0, 399, 600, 1));
+
+    //the index of another PNG
+    std::vector<unsigned char> png2, index2;
+    createTestPNG(png2, 600, 400, LCT_RGB, 8, interlace);
+    assertNoPNGError(buildIndex(index2, png2, 4096), "index");
+    ASSERT_EQUALS(99, decodeRegion(region, png, index2, 0, 399, 600, 1));
+  }
+}
+
+//Test lodepng_decode_into with and without a row stride, and that it leaves the bytes between rows alone
+void testDecodeInto()
+{
+  std::cout << "testDecodeInto" << std::endl;
+  for(unsigned interlace = 0; interlace < 2; interlace++)
+  {
+    std::vector<unsigned char> png;
+    createTestPNG(png, 23, 11, LCT_RGBA, 16, interlace);
+    std::vector<unsigned char> expected;
+    unsigned w, h;
+    lodepng::State state;
+    state.info_raw.colortype = LCT_RGB;
+    assertNoPNGError(lodepng::decode(expected, w, h, state, png));
+
+    const size_t strides[] = {0, 23 * 3, 23 * 3 + 1, 100};
+    for(size_t i = 0; i < sizeof(strides) / sizeof(*strides); i++)
+    {
+      size_t stride = strides[i];
+      size_t rowbytes = stride ? stride : 23 * 3;
+      size_t size;
+      lodepng::State state2;
+      state2.info_raw.colortype = LCT_RGB;
+      assertNoPNGError(lodepng_decode_into_size(&size, &w, &h, stride, &state2, &png[0], png.size()));
+      ASSERT_EQUALS(10 * rowbytes + 23 * 3, size);
+
+      std::vector<unsigned char> image(size, 77);
+      assertNoPNGError(lodepng_decode_into(&image[0], size, stride, &w, &h, &state2, &png[0], png.size()));
+      for(size_t y = 0; y < h; y++)
+      {
+        for(size_t x = 0; x < rowbytes; x++)
+        {
+          if(x < 23 * 3) assertEquals((int)expected[y * 23 * 3 + x], (int)image[y * rowbytes + x], "pixels");
+          else if(y + 1 < h) assertEquals(77, (int)image[y * rowbytes + x], "bytes after the row");
+        }
+      }
+
+      //a buffer of a byte less is too small
+      ASSERT_EQUALS(96, lodepng_decode_into(&image[0], size - 1, stride, &w, &h, &state2, &png[0], png.size()));
+    }
+    //a stride smaller than a row, of 23 * 4 bytes in the default RGBA
+    lodepng::State state3;
+    size_t size;
+    ASSERT_EQUALS(95, lodepng_decode_into_size(&size, &w, &h, 23 * 4 - 1, &state3, &png[0], png.size()));
+  }
+}
+
+//Test lodepng_decode_indexed: the palette indices, looked up in the palette, give the colors that lodepng::decode gives
+void testDecodeIndexed()
+{
+  std::cout << "testDecodeIndexed" << std::endl;
+  for(unsigned bitDepth = 1; bitDepth <= 8; bitDepth *= 2)
+  {
+    for(unsigned interlace = 0; interlace < 2; interlace++)
+    {
+      Image image;
+      generateTestImage(image, 19, 13, LCT_PALETTE, bitDepth);
+      lodepng::State state;
+      state.encoder.auto_convert = 0;
+      state.info_raw.colortype = LCT_PALETTE;
+      state.info_raw.bitdepth = bitDepth;
+      state.info_png.color.colortype = LCT_PALETTE;
+      state.info_png.color.bitdepth = bitDepth;
+      state.info_png.interlace_method = interlace;
+      for(unsigned i = 0; i < (1u << bitDepth); i++)
+      {
+        lodepng_palette_add(&state.info_raw, i * 3, 255 - i, i * 7, i % 3 == 0 ? 255 : i);
+        lodepng_palette_add(&state.info_png.color, i * 3, 255 - i, i * 7, i % 3 == 0 ? 255 : i);
+      }
+      std::vector<unsigned char> png;
+      assertNoPNGError(lodepng::encode(png, image.data, 19, 13, state));
+      std::vector<unsigned char> expected;
+      unsigned w, h;
+      lodepng::State state2;
+      assertNoPNGError(lodepng::decode(expected, w, h, state2, png));
+
+      unsigned char* indices = 0;
+      lodepng::State state3;
+      assertNoPNGError(lodepng_decode_indexed(&indices, &w, &h, &state3, &png[0], png.size(), 0));
+      ASSERT_EQUALS(8, state3.info_raw.bitdepth);
+      ASSERT_EQUALS(1u << bitDepth, state3.info_png.color.palettesize);
+      for(size_t i = 0; i < (size_t)w * h; i++)
+      {
+        for(size_t c = 0; c < 4; c++)
+        {
+          assertEquals((int)expected[i * 4 + c], (int)state3.info_png.color.palette[indices[i] * 4 + c], "indexed color");
+        }
+      }
+      free(indices);
+
+      //packed, the indices are the raw image data that was encoded
+      unsigned char* packed = 0;
+      lodepng::State state4;
+      assertNoPNGError(lodepng_decode_indexed(&packed, &w, &h, &state4, &png[0], png.size(), 1));
+      ASSERT_EQUALS(bitDepth, state4.info_raw.bitdepth);
+      assertPixels(image, packed, "packed indices");
+      free(packed);
+    }
+  }
+
+  //a PNG without palette
+  std::vector<unsigned char> png;
+  createTestPNG(png, 5, 5, LCT_RGB, 8, 0);
+  unsigned char* indices = 0;
+  unsigned w, h;
+  lodepng::State state;
+  ASSERT_EQUALS(100, lodepng_decode_indexed(&indices, &w, &h, &state, &png[0], png.size(), 0));
+  free(indices);
+}
+
+//Test the native endian and float sample formats against the big endian 16-bit samples
+void testSampleFormats()
+{
+  std::cout << "testSampleFormats" << std::endl;
+  const LodePNGColorType colorTypes[] = {LCT_RGBA, LCT_GREY, LCT_RGB};
+  const unsigned bitDepths[] = {16, 4, 8};
+  for(size_t i = 0; i < 3; i++)
+  {
+    std::vector<unsigned char> png;
+    createTestPNG(png, 21, 9, colorTypes[i], bitDepths[i], 0);
+    std::vector<unsigned char> expected;
+    unsigned w, h;
+    lodepng::State state;
+    state.info_raw.bitdepth = 16;
+    assertNoPNGError(lodepng::decode(expected, w, h, state, png));
+
+    std::vector<unsigned char> native;
+    lodepng::State state2;
+    state2.info_raw.bitdepth = 16;
+    state2.info_raw.sampleformat = LSF_NATIVE;
+    assertNoPNGError(lodepng::decode(native, w, h, state2, png));
+    ASSERT_EQUALS(expected.size(), native.size());
+
+    std::vector<unsigned char> floats;
+    lodepng::State state3;
+    state3.info_raw.bitdepth = 16;
+    state3.info_raw.sampleformat = LSF_FLOAT;
+    assertNoPNGError(lodepng::decode(floats, w, h, state3, png));
+    ASSERT_EQUALS(expected.size() * 2, floats.size());
+
+    for(size_t j = 0; j < expected.size() / 2; j++)
+    {
+      unsigned value = expected[j * 2] * 256u + expected[j * 2 + 1];
+      unsigned short sample = ((const unsigned short*)&native[0])[j];
+      assertEquals(value, (unsigned)sample, "native sample " + valtostr(j));
+      float f = ((const float*)&floats[0])[j];
+      assertTrue(std::fabs(f - value / 65535.0) < 1e-6, "float sample " + valtostr(j));
+    }
+
+    //only for 16 bits per sample
+    std::vector<unsigned char> image;
+    lodepng::State state4;
+    state4.info_raw.sampleformat = LSF_NATIVE;
+    ASSERT_EQUALS(101, lodepng::decode(image, w, h, state4, png));
+  }
+}
+
+//Test lodepng_decode_planar against the channels of the RGBA image that lodepng::decode gives
+void testDecodePlanar()
+{
+  std::cout << "testDecodePlanar" << std::endl;
+  for(unsigned interlace = 0; interlace < 2; interlace++)
+  {
+    std::vector<unsigned char> png;
+    createTestPNG(png, 31, 7, LCT_GREY_ALPHA, 8, interlace);
+    std::vector<unsigned char> expected;
+    unsigned w, h;
+    lodepng::State state;
+    assertNoPNGError(lodepng::decode(expected, w, h, state, png));
+    size_t numpixels = (size_t)w * h;
+
+    //the default: red, green and blue planes of bytes
+    LodePNGPlanarSettings settings;
+    lodepng_planar_settings_init(&settings);
+    unsigned char* planes = 0;
+    lodepng::State state2;
+    assertNoPNGError(lodepng_decode_planar(&planes, &w, &h, &state2, &png[0], png.size(), &settings));
+    for(size_t c = 0; c < 3; c++)
+    {
+      for(size_t i = 0; i < numpixels; i++)
+      {
+        assertEquals((int)expected[i * 4 + c], (int)planes[c * numpixels + i], "byte plane " + valtostr(c));
+      }
+    }
+    free(planes);
+
+    //bytes scaled past 255 are clamped
+    settings.numchannels = 1;
+    settings.channels[0] = 3;
+    settings.scale[0] = 2;
+    lodepng::State state3;
+    assertNoPNGError(lodepng_decode_planar(&planes, &w, &h, &state3, &png[0], png.size(), &settings));
+    for(size_t i = 0; i < numpixels; i++)
+    {
+      int value = expected[i * 4 + 3] * 2;
+      assertEquals(value > 255 ? 255 : value, (int)planes[i], "scaled byte plane");
+    }
+    free(planes);
+
+    //floats, in another order of the channels, with scale and offset
+    settings.numchannels = 4;
+    settings.type = LPT_FLOAT32;
+    for(unsigned c = 0; c < 4; c++)
+    {
+      settings.channels[c] = 3 - c;
+      settings.scale[c] = 0.5f + c;
+      settings.offset[c] = c * 0.25f - 0.5f;
+    }
+    lodepng::State state4;
+    assertNoPNGError(lodepng_decode_planar(&planes, &w, &h, &state4, &png[0], png.size(), &settings));
+    const float* floats = (const float*)planes;
+    for(size_t c = 0; c < 4; c++)
+    {
+      for(size_t i = 0; i < numpixels; i++)
+      {
+        double value = expected[i * 4 + 3 - c] / 255.0 * settings.scale[c] + settings.offset[c];
+        assertTrue(std::fabs(floats[c * numpixels + i] - value) < 1e-5, "float plane " + valtostr(c));
+      }
+    }
+    free(planes);
+  }
+
+  //invalid settings
+  std::vector<unsigned char> png;
+  createTestPNG(png, 3, 3, LCT_RGB, 8, 0);
+  unsigned w, h;
+  for(int i = 0; i < 3; i++)
+  {
+    LodePNGPlanarSettings settings;
+    lodepng_planar_settings_init(&settings);
+    if(i == 0) settings.numchannels = 0;
+    if(i == 1) settings.numchannels = 5;
+    if(i == 2) settings.channels[1] = 4;
+    unsigned char* planes = 0;
+    lodepng::State state;
+    ASSERT_EQUALS(102, lodepng_decode_planar(&planes, &w, &h, &state, &png[0], png.size(), &settings));
+    free(planes);
+  }
+}
+
+//CRC32 of the bytes of a chunk, one bit at a time, as in the PNG specification
+unsigned referenceCRC(const unsigned char* data, size_t size)
+{
+  unsigned crc = 0xffffffffu;
+  for(size_t i = 0; i < size; i++)
+  {
+    crc ^= data[i];
+    for(int j = 0; j < 8; j++) crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320u : 0u);
+  }
+  return ~crc;
+}
+
+//Test the CRC of chunks of all sizes up to a few blocks of the fast code, and check_crc of the decoder
+void testCheckCRC()
+{
+  std::cout << "testCheckCRC" << std::endl;
+  std::vector<unsigned char> data(300);
+  for(size_t i = 0; i < data.size(); i++) data[i] = (unsigned char)(i * 37 + (i >> 3));
+  for(unsigned length = 0; length <= data.size(); length++)
+  {
+    std::vector<unsigned char> chunk(length + 12);
+    chunk[3] = length & 255;
+    chunk[2] = length >> 8;
+    chunk[4] = 't'; chunk[5] = 'E'; chunk[6] = 'S'; chunk[7] = 't';
+    for(size_t i = 0; i < length; i++) chunk[8 + i] = data[i];
+    lodepng_chunk_generate_crc(&chunk[0]);
+    ASSERT_EQUALS(referenceCRC(&chunk[4], length + 4), lodepng_read32bitInt(&chunk[length + 8]));
+    ASSERT_EQUALS(0, lodepng_chunk_check_crc(&chunk[0]));
+  }
+
+  std::vector<unsigned char> png;
+  createTestPNG(png, 40, 30, LCT_RGB, 8, 0);
+  //the IHDR chunk starts at byte 8, the first IDAT chunk after it at byte 33
+  size_t idatcrc = 33 + 8 + lodepng_chunk_length(&png[33]);
+  const size_t broken[] = {29, 32, idatcrc, idatcrc + 3, png.size() - 1};
+  for(size_t i = 0; i < sizeof(broken) / sizeof(*broken); i++)
+  {
+    std::vector<unsigned char> png2 = png;
+    png2[broken[i]] ^= 1;
+    std::vector<unsigned char> image;
+    unsigned w, h;
+    lodepng::State state;
+    assertNoPNGError(lodepng::decode(image, w, h, state, png2), "CRCs not checked by default");
+    lodepng::State state2;
+    state2.decoder.check_crc = 1;
+    ASSERT_EQUALS(57, lodepng::decode(image, w, h, state2, png2));
+  }
+  std::vector<unsigned char> image;
+  unsigned w, h;
+  lodepng::State state;
+  state.decoder.check_crc = 1;
+  assertNoPNGError(lodepng::decode(image, w, h, state, png), "correct CRCs");
+}
+
+//Adler-32 one byte at a time, as in the zlib specification
+unsigned referenceAdler32(const unsigned char* data, size_t size)
+{
+  unsigned s1 = 1, s2 = 0;
+  for(size_t i = 0; i < size; i++)
+  {
+    s1 = (s1 + data[i]) % 65521;
+    s2 = (s2 + s1) % 65521;
+  }
+  return (s2 << 16) | s1;
+}
+
+//Test the Adler-32 of zlib data of various sizes, and check_adler32 of the decoder
+void testCheckAdler32()
+{
+  std::cout << "testCheckAdler32" << std::endl;
+  const size_t sizes[] = {0, 1, 15, 16, 33, 1000, 5552, 5553, 100000};
+  for(size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++)
+  {
+    std::vector<unsigned char> data(sizes[i]);
+    for(size_t j = 0; j < data.size(); j++) data[j] = (unsigned char)(255 - (j * 13 + (j >> 7)) % 256);
+    unsigned char* compressed = 0;
+    size_t compressedsize = 0;
+    LodePNGCompressSettings compress;
+    lodepng_compress_settings_init(&compress);
+    assertNoPNGError(lodepng_zlib_compress(&compressed, &compressedsize, data.empty() ? 0 : &data[0], data.size(), &compress));
+    ASSERT_EQUALS(referenceAdler32(data.empty() ? 0 : &data[0], data.size()),
+                  lodepng_read32bitInt(&compressed[compressedsize - 4]));
+
+    LodePNGDecompressSettings decompress;
+    lodepng_decompress_settings_init(&decompress);
+    decompress.check_adler32 = 1;
+    unsigned char* out = 0;
+    size_t outsize = 0;
+    assertNoPNGError(lodepng_zlib_decompress(&out, &outsize, compressed, compressedsize, &decompress));
+    free(out);
+    compressed[compressedsize - 1] ^= 1;
+    out = 0;
+    outsize = 0;
+    ASSERT_EQUALS(58, lodepng_zlib_decompress(&out, &outsize, compressed, compressedsize, &decompress));
+    free(out);
+    free(compressed);
+  }
+
+  //in a PNG, the Adler-32 is at the end of the last IDAT chunk, before its CRC and the IEND chunk
+  std::vector<unsigned char> png;
+  createTestPNG(png, 40, 30, LCT_RGBA, 8, 0);
+  png[png.size() - 17] ^= 1;
+  std::vector<unsigned char> image;
+  unsigned w, h;
+  lodepng::State state;
+  assertNoPNGError(lodepng::decode(image, w, h, state, png), "Adler-32 not checked by default");
+  lodepng::State state2;
+  state2.decoder.zlibsettings.check_adler32 = 1;
+  ASSERT_EQUALS(58, lodepng::decode(image, w, h, state2, png));
+}
+
+//Test that PNGs encoded in bands decode on several threads to the same image as without bands
+void testDecodeBands()
+{
+  std::cout << "testDecodeBands" << std::endl;
+  const LodePNGColorType colorTypes[] = {LCT_RGBA, LCT_GREY, LCT_RGB};
+  const unsigned bitDepths[] = {8, 2, 16};
+  const unsigned bandHeights[] = {1, 5, 64, 1000};
+  for(size_t i = 0; i < 3; i++)
+  {
+    std::vector<unsigned char> png;
+    createTestPNG(png, 57, 130, colorTypes[i], bitDepths[i], 0);
+    std::vector<unsigned char> expected;
+    unsigned w, h;
+    lodepng::State state;
+    assertNoPNGError(lodepng::decode(expected, w, h, state, png));
+
+    for(size_t j = 0; j < sizeof(bandHeights) / sizeof(*bandHeights); j++)
+    {
+      std::vector<unsigned char> banded;
+      createTestPNG(banded, 57, 130, colorTypes[i], bitDepths[i], 0, bandHeights[j]);
+      for(unsigned numThreads = 1; numThreads <= 4; numThreads += 3)
+      {
+        std::vector<unsigned char> image;
+        lodepng::State state2;
+        state2.decoder.num_threads = numThreads;
+        state2.decoder.zlibsettings.check_adler32 = 1;
+        assertNoPNGError(lodepng::decode(image, w, h, state2, banded));
+        assertTrue(image == expected, "bands of " + valtostr(bandHeights[j]) + " on threads: " + valtostr(numThreads));
+
+        //the Adler-32 of the whole image data is still checked
+        std::vector<unsigned char> broken = banded;
+        broken[broken.size() - 17] ^= 1;
+        lodepng::State state3;
+        state3.decoder.num_threads = numThreads;
+        state3.decoder.zlibsettings.check_adler32 = 1;
+        ASSERT_EQUALS(58, lodepng::decode(image, w, h, state3, broken));
+      }
+    }
+  }
+}
+
+//Test that decoding in a pipeline on several threads gives the same pixels and errors as on one thread
+void testDecodePipeline()
+{
+  std::cout << "testDecodePipeline" << std::endl;
+  const LodePNGColorType colorTypes[] = {LCT_RGBA, LCT_GREY, LCT_RGB, LCT_GREY_ALPHA};
+  const unsigned bitDepths[] = {8, 1, 16, 8};
+  for(unsigned interlace = 0; interlace < 2; interlace++)
+  {
+    for(size_t i = 0; i < 4; i++)
+    {
+      std::vector<unsigned char> png;
+      createTestPNG(png, 83, 61, colorTypes[i], bitDepths[i], interlace);
+      //to RGBA, and to the color type of the PNG itself
+      for(int raw = 0; raw < 2; raw++)
+      {
+        std::vector<unsigned char> expected;
+        unsigned w, h;
+        lodepng::State state;
+        if(raw)
+        {
+          state.info_raw.colortype = colorTypes[i];
+          state.info_raw.bitdepth = bitDepths[i];
+        }
+        assertNoPNGError(lodepng::decode(expected, w, h, state, png));
+
+        for(unsigned numThreads = 2; numThreads <= 5; numThreads += 3)
+        {
+          std::vector<unsigned char> image;
+          lodepng::State state2;
+          state2.decoder.num_threads = numThreads;
+          state2.decoder.pipeline = 1;
+          if(raw)
+          {
+            state2.info_raw.colortype = colorTypes[i];
+            state2.info_raw.bitdepth = bitDepths[i];
+          }
+          assertNoPNGError(lodepng::decode(image, w, h, state2, png));
+          assertTrue(image == expected, "pipeline on threads: " + valtostr(numThreads));
+        }
+      }
+
+      //damaged image data
+      for(size_t pos = 40; pos < png.size(); pos += 1 + png.size() / 16)
+      {
+        std::vector<unsigned char> broken = png;
+        broken[pos] ^= 8;
+        std::vector<unsigned char> expected, image;
+        unsigned w, h;
+        lodepng::State state;
+        unsigned error = lodepng::decode(expected, w, h, state, broken);
+        lodepng::State state2;
+        state2.decoder.num_threads = 3;
+        state2.decoder.pipeline = 1;
+        assertEquals(error, lodepng::decode(image, w, h, state2, broken), "error at " + valtostr(pos));
+        assertTrue(image == expected, "pixels of damaged image");
+      }
+    }
+  }
+}
+
 void doMain()
 {
   //PNG
@@ -2050,6 +2758,20 @@ void doMain()
   testPaletteToPaletteDecode();
   testPaletteToPaletteDecode2();
 
+  //Decoding in other ways
+  testStreamDecoder();
+  testDecodeRows();
+  testDecodeRegion();
+  testDecodeRegionIndexed();
+  testDecodeInto();
+  testDecodeIndexed();
+  testSampleFormats();
+  testDecodePlanar();
+  testCheckCRC();
+  testCheckAdler32();
+  testDecodeBands();
+  testDecodePipeline();
+
   //Colors
   testFewColors(); // this one is slow for valgrind
   testColorKeyConvert();